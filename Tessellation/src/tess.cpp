@@ -26,8 +26,32 @@
 #include <array>
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <string>
+#include <iterator>
+#include <fstream>
+#include <sstream>
 
 #include "tess_shape.h"
+#include "tess_sprite_atlas.h"
+#include "tess_periodic.h"
+#include "tess_wallpaper.h"
+#include "tess_uniform.h"
+#include "tess_substitution.h"
+#include "tess_spatial_index.h"
+#include "tess_region_fill.h"
+#include "tess_coverage.h"
+#include "tess_topology.h"
+#include "tess_scene_file.h"
+#include "tess_journal.h"
+#include "tess_chunk_store.h"
+#include "tess_svg_export.h"
+#include "tess_png_export.h"
+#include "tess_input_log.h"
+#include "tess_undo.h"
+#include "tess_slot_map.h"
+#include "tess_instances.h"
+#include "tess_coloring.h"
 
 #include "olcPGEX_TransformedView.h"
 
@@ -38,6 +62,24 @@ constexpr float SIDE_LENGTH = 40.0f;
 
 constexpr float ROTATION_INTERVAL = 0.1f;  // Seconds betwen rotations
 constexpr float ZOOM_INTERVAL = 0.2f;  // Seconds betwen rotations
+constexpr float SELECTION_TURN_DELAY = 0.5f;  // Seconds after the last turn of the selection before it is applied
+constexpr float ERASE_RADIUS_MAX = 10.0f * SIDE_LENGTH;  // Largest brush of the Eraser tool
+
+constexpr float SUBSTITUTION_RADIUS = 1.0e7f;  // World radius covered by a substitution tiling
+constexpr float MIN_TILE_PIXELS = 8.0f;        // Substitution tiles are never subdivided below this size on screen
+
+constexpr size_t REGION_FILL_MAX_TILES = 1000000;  // Upper bound on the tiles one region fill adds
+
+const char* const SCENE_FILE = "scene.tess";  // Saved with Ctrl+S, loaded with Ctrl+O and on startup, with edits journaled next to it
+constexpr float STATUS_SECONDS = 3.0f;        // How long a save or load message stays on screen
+
+const char* const SVG_FILE = "scene.svg";    // Exported with Ctrl+E
+const char* const PNG_FILE = "scene.png";    // Exported with Ctrl+P
+constexpr uint32_t PNG_EXPORT_WIDTH = 8192;  // Pixels across a PNG exported with Ctrl+P
+
+const char* const WORLD_FILE = "world.tessw";                 // Streamed world, opened with Ctrl+W
+constexpr float WORLD_CHUNK_SIZE = 32.0f * SIDE_LENGTH;       // World units per chunk side
+constexpr size_t WORLD_MEMORY_BUDGET = 512u * 1024u * 1024u;  // Bytes of world shapes kept in memory
 
 // A structure that holds two snap points
 // the bestCurrentPoint and the bestClosestPoint
@@ -49,6 +91,21 @@ struct SnapPair
 	float distance;
 };
 
+// A symmetry mode of the Place tool: the cyclic group Cn or the dihedral group Dn.
+// n divides 24 so every image is a whole number of 15 degree rotations.
+struct SymmetryMode
+{
+	int order;
+	bool dihedral;
+	const char* name;
+};
+
+const SymmetryMode SYMMETRY_MODES[] = {
+	{ 1, false, "" }, { 2, false, "C2" }, { 3, false, "C3" }, { 4, false, "C4" }, { 6, false, "C6" },
+	{ 8, false, "C8" }, { 12, false, "C12" }, { 1, true, "D1" }, { 2, true, "D2" }, { 3, true, "D3" },
+	{ 4, true, "D4" }, { 6, true, "D6" }, { 8, true, "D8" }, { 12, true, "D12" }
+};
+
 // An enum for all the supported shapes
 enum class ShapeType
 {
@@ -56,6 +113,21 @@ enum class ShapeType
 	Square,
 	Hexagon,
 	IsoQuad,
+	Octagon,
+	Dodecagon,
+};
+
+// Names of the shapes in a tile list, see Tess::BuildSceneHeadless()
+const char* const SHAPE_NAMES[] = { "triangle", "square", "hexagon", "isoquad", "octagon", "dodecagon" };
+
+// A tile for Tess::AddTiles(): a built in shape turned rotation degrees
+// about its centre, centred on position, and filled with color
+struct TileSpec
+{
+	ShapeType type;
+	float rotation;
+	olc::vf2d position;
+	olc::Pixel color = olc::BLANK;  // olc::BLANK leaves it unfilled
 };
 
 // An enum for all the various tools
@@ -63,7 +135,15 @@ enum class ToolType
 {
 	PlaceShape,
 	FillShape,
-	HideTool
+	RegionFill,
+	HideTool,
+	Periodic,
+	Wallpaper,
+	Uniform,
+	Substitution,
+	Coverage,
+	Select,
+	Erase
 };
 
 
@@ -76,10 +156,20 @@ public:
 	}
 
 private:
-	std::vector<std::unique_ptr<TessShape>> upShapes_;
+	// Placed shapes, packed in the order they were placed (as the journal and
+	// scene file index them), with stable handles
+	TessSlotMap<TessShape> upShapes_;
+	// Grid hash over the placed shapes, kept in step by InsertShapes() and TakeShapesFrom()
+	TessSpatialIndex shapeIndex_ = TessSpatialIndex(2.0f * SIDE_LENGTH);
+	// Half-edge mesh of the placed shapes, kept in step the same way, except
+	// after a load, which leaves it for UpdateTopology() to build
+	TessTopology topology_;
+	bool topologyStale_ = false;
 	std::unique_ptr<TessShape> upCurrentShape_;
-	// Pointer to the closest shape to the mouse
-	TessShape* pClosestShape_ = nullptr;
+	// Closest shape to the mouse, a placed shape, a world shape or a stamped
+	// shape. See ClosestShape().
+	TessSlotMap<TessShape>::Handle closestShape_;
+	TessShape* pClosestUnplacedShape_ = nullptr;
 	olc::vf2d closestDist_ = { 100000.0f, 100000.0f }; // Initialize with a large value
 	SnapPair snapPair_ = { {0.0f, 0.0f}, {0.0f, 0.0f}, 100000.0f };
 	ShapeType currentShapeType_ = ShapeType::Triangle;
@@ -90,6 +180,85 @@ private:
 	ToolType currentTool_ = ToolType::PlaceShape;
 	std::vector<olc::Pixel> colors_ = { olc::RED, olc::GREEN, olc::BLUE, olc::YELLOW, olc::CYAN, olc::MAGENTA, olc::WHITE, olc::BLACK };
 	int currentColorIndex_ = 0;
+	bool fillRegion_ = false;  // The Fill tool fills the connected region of one color, rather than one shape
+	std::string fillStatus_;   // Result of the last automatic coloring
+	// Cache of pre-rasterized sprites for drawing placed shapes
+	TessSpriteAtlas atlas_ = TessSpriteAtlas(this);
+	// Periodic tiling generated from a unit cell of placed shapes
+	TessPeriodicTiling periodic_;
+	std::vector<olc::vf2d> latticeVectors_; // Lattice vectors picked so far
+	std::string periodicStatus_;            // Result of the last detection
+	// Wallpaper group tiling generated from a fundamental domain of placed shapes
+	TessWallpaper wallpaper_;
+	WallpaperGroup wallpaperGroup_ = WallpaperGroup::P1;
+	float wallpaperCellSize_ = 4.0f * SIDE_LENGTH;
+	// Uniform tiling generator settings
+	int uniformPreset_ = 0;
+	size_t uniformMaxTiles_ = 1000;
+	// Aperiodic substitution tiling, expanded lazily over the visible part of the world
+	TessSubstitutionTiling substitution_;
+	SubstitutionRule substitutionRule_ = SubstitutionRule::PenroseP3;
+	olc::Pixel substitutionColors_[2] = { olc::Pixel(230, 170, 60), olc::Pixel(70, 110, 190) };
+	size_t substitutionTriangles_ = 0; // Triangles drawn last frame
+	int substitutionDepth_ = 0;        // Subdivision depth used last frame
+	std::vector<olc::vf2d> clipPoints_; // Reused buffer for clipping triangles to the screen
+	// Region fill boundary
+	std::vector<olc::vf2d> region_;
+	bool regionClosed_ = false;
+	std::string regionStatus_;
+	// Symmetry mode of the Place tool: each placed shape also places its images
+	int symmetryMode_ = 0;                                  // Index into SYMMETRY_MODES, 0 is off
+	olc::vf2d symmetryCentre_ = { 0.0f, 0.0f };
+	std::vector<TessTransform> symmetryOps_;                // Point group of the mode, identity first
+	std::vector<olc::vf2d> symmetryPoints_;                 // Reused buffer for drawing the preview images
+	// Overlap prevention of the Place tool
+	bool blockOverlaps_ = false;                            // Refuse to place a shape that overlaps others
+	std::vector<olc::vf2d> overlapPoints_;                  // Reused buffer for the overlap check
+	// Coverage analysis of a world rectangle, run in the background
+	TessCoverageAnalyzer coverage_;
+	float coverageResolution_ = SIDE_LENGTH / 8.0f;  // World size of a coverage sample
+	olc::vf2d coverageDragStart_ = { 0.0f, 0.0f };
+	bool coverageDragging_ = false;
+	// Selection of the Select tool, as sorted indices into upShapes_. A move
+	// or turn is only previewed while it is dragged, and applied to the
+	// shapes (and the spatial index and topology) in one go when it ends.
+	std::vector<size_t> selection_;
+	olc::vf2d selectionPivot_ = { 0.0f, 0.0f };   // Centre of the selection, that it turns about
+	olc::vf2d selectionOffset_ = { 0.0f, 0.0f };  // Move not yet applied
+	float selectionTurn_ = 0.0f;                  // Turn in degrees not yet applied
+	bool selectionMoving_ = false;                // Dragging the selection
+	bool selecting_ = false;                      // Dragging out a rectangle or lasso
+	bool selectLasso_ = false;                    // Select with a lasso rather than a rectangle
+	olc::vf2d selectDragStart_ = { 0.0f, 0.0f };
+	std::vector<olc::vf2d> lasso_;
+	std::vector<olc::vf2d> selectionPoints_;      // Reused buffer for drawing a turned or stamped shape
+	// Stamps of copied patches, and the patch copied last. A stamp only
+	// refers to its patch, so stamping a large patch many times costs little.
+	TessInstances stamps_;
+	std::shared_ptr<TessInstances::Patch> clipboard_;
+	bool pasting_ = false;                        // The Select tool stamps the clipboard
+	olc::vf2d pastePosition_ = { 0.0f, 0.0f };    // Centre of the next stamp, snapped
+	float pasteRotation_ = 0.0f;
+	size_t pasteBegin_ = 0;                       // First stamp of this paste, that right click can take back
+	size_t closestStamp_ = SIZE_MAX;              // Stamp and patch shape closest to the mouse, if a stamped shape is
+	size_t closestStampShape_ = 0;
+	std::unique_ptr<TessShape> upClosestStampShape_; // That shape, expanded to be snapped to
+	// Eraser brush radius, 0 to erase only the shape under the mouse
+	float eraseRadius_ = 0.0f;
+	bool eraseStroke_ = false;                    // This drag has erased shapes, that the next ones join
+	// World streamed from disk in chunks, and one shape per prototype of its tables
+	TessChunkStore world_;
+	std::vector<std::unique_ptr<TessShape>> upWorldPrototypes_;
+	// Edits to the placed shapes since SCENE_FILE was saved
+	TessJournal journal_;
+	// Undo and redo history of the edits to the placed shapes
+	TessUndoStack undo_;
+	// Input of each frame, recorded to inputLogPath_ or replayed from it
+	TessInputLog input_;
+	std::string inputLogPath_;
+	// Message from the last save or load, and how much longer to show it
+	std::string fileStatus_;
+	float fileStatusTime_ = 0.0f;
 
 
 
@@ -106,21 +275,23 @@ public:
 		tv_.SetWorldScale({ 1.0f, 1.0f }); // Set initial zoom level
 		tv_.SetWorldOffset({ 0.0f, 0.0f }); // Set initial position
 
-		// CreateNewTriangle(olc::vf2d(0.0f, 0.0f)); // Initial position will be updated immediately
-		switch (currentShapeType_)
-		{
-			case ShapeType::Triangle:
-				CreateNewTriangle(olc::vf2d(0.0f, 0.0f)); // Initial position will be updated immediately
-				break;
-			case ShapeType::Square:
-				CreateNewSquare(olc::vf2d(0.0f, 0.0f)); // Initial position will be updated immediately
-				break;
-			case ShapeType::Hexagon:
-				CreateNewHexagon(olc::vf2d(0.0f, 0.0f)); // Initial position will be updated immediately
-				break;
-			case ShapeType::IsoQuad:
-				CreateNewIsoQuad(olc::vf2d(0.0f, 0.0f)); // Initial position will be updated immediately
-				break;
+		upCurrentShape_ = CreateNewShape(currentShapeType_, olc::vf2d(0.0f, 0.0f)); // Initial position will be updated immediately
+
+		// A replay starts from the scene its session started from. Otherwise
+		// pick up where the last session left off, crashed or not.
+		if (input_.isReplaying()) {
+			LoadScene(TessInputLog::scenePath(inputLogPath_));
+			return true;
+		}
+		LoadScene(SCENE_FILE, true);
+
+		// A recorded session saves the scene it starts from next to the log
+		if (!inputLogPath_.empty()) {
+			std::string error;
+			if (!TessSceneFile::save(TessInputLog::scenePath(inputLogPath_), upShapes_.values(), error) ||
+				!input_.startRecording(inputLogPath_, { ScreenWidth(), ScreenHeight() }, error)) {
+				SetFileStatus(error);
+			}
 		}
 		return true;
 	}
@@ -149,24 +320,24 @@ public:
 			{
 				case ShapeType::Triangle:
 					currentShapeType_ = ShapeType::Square;
-					CreateNewSquare(upCurrentShape_->getCentroid());
 					break;
 				case ShapeType::Square:
 					currentShapeType_ = ShapeType::Hexagon;
-					CreateNewHexagon(upCurrentShape_->getCentroid());
 					break;
 				case ShapeType::Hexagon:
 					currentShapeType_ = ShapeType::IsoQuad;
-					CreateNewIsoQuad(upCurrentShape_->getCentroid());
 					break;
 				case ShapeType::IsoQuad:
-					currentShapeType_ = ShapeType::Triangle;
-					CreateNewTriangle(upCurrentShape_->getCentroid());
+					currentShapeType_ = ShapeType::Octagon;
+					break;
+				case ShapeType::Octagon:
+					currentShapeType_ = ShapeType::Dodecagon;
 					break;
 				default:
 					currentShapeType_ = ShapeType::Triangle;
 					break;
 			}
+			upCurrentShape_ = CreateNewShape(currentShapeType_, upCurrentShape_->getCentroid());
 
 		}
 
@@ -185,11 +356,36 @@ public:
 			upCurrentShape_->rotate(15.0f);
 		}
 
-		// Undo last action (remove the last place shape) on right mouse click
-		if (GetMouse(1).bPressed) { // Right mouse button is index 1
-			if (!upShapes_.empty()) {
-				upShapes_.pop_back();
+		// Toggle blocking overlapping placements with the 'B' key
+		if (GetKey(olc::Key::B).bPressed) {
+			blockOverlaps_ = !blockOverlaps_;
+		}
+
+		// Cycle the symmetry mode with the 'M' key, and move its centre to the mouse
+		// (snapped to the nearest vertex of the closest shape) with the 'C' key
+		if (GetKey(olc::Key::M).bPressed) {
+			symmetryMode_ = (symmetryMode_ + 1) % (int)std::size(SYMMETRY_MODES);
+			UpdateSymmetryOps();
+		}
+		if (GetKey(olc::Key::C).bPressed && !GetKey(olc::Key::CTRL).bHeld) {
+			symmetryCentre_ = vMouse;
+			if (TessShape* pClosestShape = ClosestShape()) {
+				float snapDist = SNAP_DIST_MAX;
+				for (const auto& point : pClosestShape->snapPoints()) {
+					float distance = (point - vMouse).mag();
+					if (distance < snapDist) {
+						snapDist = distance;
+						symmetryCentre_ = point;
+					}
+				}
 			}
+			UpdateSymmetryOps();
+		}
+
+		// Undo last action on right mouse click. A symmetric placement is
+		// one action.
+		if (GetMouse(1).bPressed) { // Right mouse button is index 1
+			Undo();
 		}
 
 		// Update current triangle position to follow mouse
@@ -208,9 +404,12 @@ public:
 		// Handle Mouse Input - Place shape
 		// ***************************
 
-		// Place shape on mouse click
+		// Check where the shape would be placed against the placed shapes
+		bool overlap = CurrentShapeOverlaps();
+
+		// Place shape on mouse click, unless overlapping shapes are blocked
 
-		if (GetMouse(0).bPressed) { // Left mouse button is index 0
+		if (GetMouse(0).bPressed && !(blockOverlaps_ && overlap)) { // Left mouse button is index 0
 			// Store the rotation of the current shape
 			float lastRotation_ = upCurrentShape_->getRotation();
 
@@ -222,24 +421,18 @@ public:
 				upCurrentShape_->moveTo(upCurrentShape_->getCentroid() + translation);
 			}
 
-			upShapes_.push_back(std::move(upCurrentShape_)); // Move current triangle to the list
+			if (symmetryOps_.size() > 1) {
+				// Place every image of the shape as one batch
+				std::vector<std::unique_ptr<TessShape>> upBatch = CreateSymmetryImages(*upCurrentShape_);
+				AddShapes(upBatch);
+				upCurrentShape_.reset();
+			}
+			else {
+				AddShape(std::move(upCurrentShape_)); // Move current triangle to the list
+			}
 
 			// Create a new shape at the mouse position
-			switch (currentShapeType_)
-			{
-				case ShapeType::Triangle:
-					CreateNewTriangle(vMouse); 
-					break;
-				case ShapeType::Square:
-					CreateNewSquare(vMouse); 
-					break;
-				case ShapeType::Hexagon:
-					CreateNewHexagon(vMouse); 
-					break;
-				case ShapeType::IsoQuad:
-					CreateNewIsoQuad(vMouse); 
-					break;
-			}
+			upCurrentShape_ = CreateNewShape(currentShapeType_, vMouse);
 
 			// Apply the last shape's rotation to the new shape
 			upCurrentShape_->rotate(lastRotation_);
@@ -250,19 +443,50 @@ public:
 		// ***************************
 	
 		// Draw the closest triangle in a different red
-		// XXX if (pClosestShape_ && closestDist_.mag() < SNAP_DIST_MAX) {
-		// XXX	pClosestShape_->draw(olc::RED);
+		// XXX if (pClosestShape && closestDist_.mag() < SNAP_DIST_MAX) {
+		// XXX	pClosestShape->draw(olc::RED);
 		// XXX}
 
-		// Draw the current triangle
+		// Draw the current triangle, in red if it would overlap another shape
 		if (upCurrentShape_) {
-			upCurrentShape_->draw(olc::BLUE); // Draw in different color to distinguish
+			upCurrentShape_->draw(overlap ? olc::RED : olc::BLUE); // Draw in different color to distinguish
+		}
+		if (blockOverlaps_) {
+			DrawString({ 4, ScreenHeight() - 12 }, "No overlaps", olc::RED);
+		}
+
+		// Draw its symmetry images, the centre and the mirrors
+		if (upCurrentShape_ && symmetryOps_.size() > 1) {
+			const std::vector<olc::vf2d>& points = upCurrentShape_->getDrawPoints();
+			for (size_t k = 1; k < symmetryOps_.size(); ++k) {
+				symmetryPoints_.clear();
+				for (const auto& point : points) {
+					symmetryPoints_.push_back(symmetryOps_[k].apply(point));
+				}
+				DrawPolygon(symmetryPoints_, { 0.0f, 0.0f }, olc::BLANK, olc::DARK_BLUE);
+			}
+
+			float reach = 2.0f * (ScreenWidth() + ScreenHeight()) / tv_.GetWorldScale().x;
+			for (const auto& op : symmetryOps_) {
+				if (op.isReflection()) {
+					// The mirror line is fixed by the reflection, along the eigenvector of +1
+					olc::vf2d axis = olc::vf2d(op.m00 + 1.0f, op.m10);
+					if (axis.mag() < 1e-3f) {
+						axis = { op.m01, op.m11 + 1.0f };
+					}
+					axis = axis.norm() * reach;
+					tv_.DrawLine(symmetryCentre_ - axis, symmetryCentre_ + axis, olc::DARK_MAGENTA);
+				}
+			}
+			tv_.FillCircle(symmetryCentre_, SIDE_LENGTH / 10.0f, olc::MAGENTA);
+			DrawString({ 4, 4 }, SYMMETRY_MODES[symmetryMode_].name, olc::MAGENTA);
 		}
 
 		// Draw the snap points of the closest triangle
-		if (upCurrentShape_ && pClosestShape_)
+		TessShape* pClosestShape = ClosestShape();
+		if (upCurrentShape_ && pClosestShape)
 		{
-			std::vector<SnapPair> snapPairs = FindClosestSnapPoints(upCurrentShape_.get(), pClosestShape_);
+			std::vector<SnapPair> snapPairs = FindClosestSnapPoints(upCurrentShape_.get(), pClosestShape);
 			float minDistance = 100000.0f;
 			for (const auto& sp : snapPairs)
 			{
@@ -289,6 +513,17 @@ public:
 		// Handle Keyboard Input
 		// ***************************
 		
+		// Toggle between filling one shape and a connected region with the 'B' key
+		if (GetKey(olc::Key::B).bPressed) {
+			fillRegion_ = !fillRegion_;
+		}
+
+		// Color the placed shapes so that no neighbours match with the 'C'
+		// key, in a repeating pattern if the 'Shift' key is held
+		if (GetKey(olc::Key::C).bPressed && !GetKey(olc::Key::CTRL).bHeld) {
+			AutoColor(GetKey(olc::Key::SHIFT).bHeld);
+		}
+
 		// Change fill color with the '<' and '>' keys
 		timeSinceLastRotation_ += fElapsedTime;
 		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
@@ -323,12 +558,14 @@ public:
 	{
 
 		// Check the closestShape to see if the vMouse is inside it
-		// If it is, highlight the shape
-		bool isInside = pClosestShape_ && pClosestShape_->isInside(vMouse);
+		// If it is, highlight the shape. A stamped shape is only a copy of
+		// its patch's, so it isn't filled.
+		TessShape* pClosestShape = ClosestShape();
+		bool isInside = pClosestShape && pClosestShape != upClosestStampShape_.get() && pClosestShape->isInside(vMouse);
 
 		if (isInside)
 		{
-			pClosestShape_->draw(colors_[currentColorIndex_]);
+			pClosestShape->draw(colors_[currentColorIndex_]);
 		}
 
 
@@ -338,9 +575,13 @@ public:
 		if (GetMouse(0).bPressed)
 		{ 
 			// Check the closestShape to see if the vMouse is inside it
-			if (isInside)
+			if (isInside && fillRegion_)
+			{
+				FillRegion(*pClosestShape, colors_[currentColorIndex_]);
+			}
+			else if (isInside)
 			{
-				pClosestShape_->setColor(colors_[currentColorIndex_]);
+				SetShapeColor(*pClosestShape, colors_[currentColorIndex_]);
 			}
 		}
 
@@ -350,7 +591,12 @@ public:
 		float sideLength = SIDE_LENGTH/4.0f;
 		float halfSide = sideLength / 2.0f;
 		tv_.FillRect(vMouse.x-halfSide, vMouse.y-halfSide, sideLength, sideLength, colors_[currentColorIndex_]);
-
+		if (fillRegion_) {
+			DrawString({ 4, 4 }, "Fill Region", olc::WHITE);
+		}
+		if (!fillStatus_.empty()) {
+			DrawString({ 4, 14 }, fillStatus_, olc::WHITE);
+		}
 
 
 
@@ -358,167 +604,2428 @@ public:
 
 	}
 
+	// Do pre-draw updates for the RegionFill tool
+	bool ToolRegionFillUpdatePre(float fElapsedTime, olc::vf2d vMouse)
+	{
+		// ***************************
+		// Handle Keyboard and Mouse Input - Rotate the fill shape
+		// ***************************
+		timeSinceLastRotation_ += fElapsedTime;
+		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			upCurrentShape_->rotate(-15.0f);
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		if (GetKey(olc::Key::PERIOD).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			upCurrentShape_->rotate(15.0f);
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		int nMouseWheelDelta = GetMouseWheel();
+		if (nMouseWheelDelta > 0) {
+			upCurrentShape_->rotate(-15.0f);
+		}
+		else if (nMouseWheelDelta < 0) {
+			upCurrentShape_->rotate(15.0f);
+		}
+
+		// The seed shape follows the mouse once the region is closed
+		upCurrentShape_->moveTo(vMouse);
 
-	bool OnUserUpdate(float fElapsedTime) override
+		return true;
+	}
+
+	// Do post tess draw updates for the RegionFill tool
+	// Clicks draw the outline of a region; clicking its first point closes it.
+	// Clicking inside the closed region places a seed tile of the current shape
+	// and rotation, and the region is filled by growing outward from it.
+	bool ToolRegionFillUpdatePost(float fElapsedTime, olc::vf2d vMouse)
 	{
-		bool ret = true;
+		// ***************************
+		// Mouse Input - Undo
+		// ***************************
 
-		Clear(olc::GREY);
+		// Right click reopens the region, removes its last point, or undoes
+		// the last edit (the last fill, as a whole)
+		if (GetMouse(1).bPressed) {
+			if (regionClosed_) {
+				regionClosed_ = false;
+			}
+			else if (!region_.empty()) {
+				region_.pop_back();
+			}
+			else {
+				Undo();
+				regionStatus_.clear();
+			}
+		}
 
-		// Switch tools with the 'T' key
-		//if (GetKey(olc::Key::T).bPressed) {
-		//	switch (currentTool_)
-		//	{
-		//		case ToolType::PlaceShape:
-		//			currentTool_ = ToolType::FillShape;
-		//			break;
-		//		case ToolType::FillShape:
-		//			currentTool_ = ToolType::PlaceShape;
-		//			break;
-		//	}
-		//}
+		// Clicking near the first point closes the region
+		float closeDist = SNAP_DIST_MAX * 2.0f / tv_.GetWorldScale().x;
+		bool nearFirst = region_.size() >= 3 && (region_.front() - vMouse).mag() < closeDist;
+
+		if (!regionClosed_) {
+			// ***************************
+			// Mouse Input - Draw the region
+			// ***************************
+			if (GetMouse(0).bPressed) {
+				if (nearFirst) {
+					regionClosed_ = true;
+				}
+				else {
+					region_.push_back(vMouse);
+				}
+			}
 
-		// Number Key 1 selects the PlaceShape tool
-		if (GetKey(olc::Key::K1).bPressed) {
-			currentTool_ = ToolType::PlaceShape;
+			for (size_t i = 0; i + 1 < region_.size(); ++i) {
+				tv_.DrawLine(region_[i], region_[i + 1], olc::CYAN);
+			}
+			if (!region_.empty() && !regionClosed_) {
+				tv_.DrawLine(region_.back(), nearFirst ? region_.front() : vMouse, olc::DARK_CYAN);
+				tv_.FillCircle(region_.front(), SIDE_LENGTH / 10.0f, nearFirst ? olc::YELLOW : olc::CYAN);
+			}
+			DrawString({ 4, 4 }, regionStatus_.empty() ? "Draw region" : regionStatus_, olc::CYAN);
+			return true;
 		}
 
-		// Number Key 2 selects the FillShape tool
-		if (GetKey(olc::Key::K2).bPressed) {
-			currentTool_ = ToolType::FillShape;
+		// ***************************
+		// Snap the seed tile to the closest placed shape, as the Place tool does
+		// ***************************
+		snapPair_.distance = 100000.0f;
+		if (TessShape* pClosestShape = ClosestShape()) {
+			for (const auto& sp : FindClosestSnapPoints(upCurrentShape_.get(), pClosestShape)) {
+				if (sp.distance < snapPair_.distance) {
+					snapPair_ = sp;
+				}
+			}
+		}
+		if (snapPair_.distance < SNAP_DIST_MAX) {
+			upCurrentShape_->moveTo(upCurrentShape_->getCentroid() + snapPair_.bestClosestPoint - snapPair_.bestCurrentPoint);
 		}
 
-		// Number key 3 hides the tool
-		if (GetKey(olc::Key::K3).bPressed) {
-			currentTool_ = ToolType::HideTool;
+		// ***************************
+		// Mouse Input - Fill the region
+		// ***************************
+		if (GetMouse(0).bPressed && TessPolygon::containsPoint(region_.data(), region_.size(), vMouse)) {
+			FillRegion();
 		}
 
-		// Zooming in and out
-		timeSinceLastZoom_ += fElapsedTime;
-		if (GetKey(olc::Key::Q).bHeld && timeSinceLastZoom_ >= ZOOM_INTERVAL) {
-			tv_.ZoomAtScreenPos(1.1f, { ScreenWidth() / 2, ScreenHeight() / 2 }); // Zoom in at screen center
-			//std::cout << "Q: Zoom Level: " << tv_.GetWorldScale().x << std::endl;
-			timeSinceLastZoom_ = 0.0f; // Reset the timer
+		// ***************************
+		// Draw the region and the seed tile
+		// ***************************
+		for (size_t i = 0; i < region_.size(); ++i) {
+			tv_.DrawLine(region_[i], region_[(i + 1) % region_.size()], olc::CYAN);
 		}
-		if (GetKey(olc::Key::A).bHeld && timeSinceLastZoom_ >= ZOOM_INTERVAL) {
-			tv_.ZoomAtScreenPos(0.9f, { ScreenWidth() / 2, ScreenHeight() / 2 }); // Zoom out at screen center
-			//std::cout << "A: Zoom Level: " << tv_.GetWorldScale().x << std::endl;
-			timeSinceLastZoom_ = 0.0f; // Reset the timer
+		if (regionClosed_) {
+			upCurrentShape_->draw(olc::BLUE);
 		}
+		DrawString({ 4, 4 }, regionStatus_.empty() ? "Click inside to fill" : regionStatus_, olc::CYAN);
 
-		// Panning
-		olc::vf2d panDelta = { 0.0f, 0.0f };
-		float panSpeed = 100.0f * fElapsedTime; // Adjust pan speed as necessary
-		if (GetKey(olc::Key::LEFT).bHeld) panDelta.x += panSpeed;
-		if (GetKey(olc::Key::RIGHT).bHeld) panDelta.x -= panSpeed;
-		if (GetKey(olc::Key::UP).bHeld) panDelta.y += panSpeed;
-		if (GetKey(olc::Key::DOWN).bHeld) panDelta.y -= panSpeed;
+		return true;
+	}
 
-		tv_.MoveWorldOffset(panDelta);
+	// Fill the closed region with the current shape, seeded by upCurrentShape_
+	void FillRegion()
+	{
+		auto start = std::chrono::steady_clock::now();
 
-		olc::vf2d vMouse = tv_.ScreenToWorld(GetMousePos());
+		olc::vf2d centroid = upCurrentShape_->getCentroid();
+		std::vector<olc::vf2d> offsets;
+		for (const auto& point : upCurrentShape_->getDrawPoints()) {
+			offsets.push_back(point - centroid);
+		}
 
-		// Handle tool-specific updates, before drawing the shapes
-		switch (currentTool_)
-		{
-		case ToolType::PlaceShape:
-				ret &= ToolPlaceShapeUpdatePre(fElapsedTime, vMouse);
-				break;
-		case ToolType::FillShape:
-				ret &= ToolFillUpdatePre(fElapsedTime, vMouse);
-				break;
+		// Worker threads read the placed shapes' draw points, so bring them up to date first
+		for (const auto& upShape : upShapes_) {
+			upShape->getDrawPoints();
+		}
+
+		std::vector<TessRegionFill::Tile> tiles = TessRegionFill::fill(region_, offsets, olc::vd2d(centroid), shapeIndex_, REGION_FILL_MAX_TILES);
+
+		// Added as one batch, so the fill is undone as one edit
+		std::vector<std::unique_ptr<TessShape>> upBatch;
+		upBatch.reserve(tiles.size());
+		float rotation = upCurrentShape_->getRotation();
+		for (const auto& tile : tiles) {
+			auto upShape = CreateNewShape(currentShapeType_, olc::vf2d(tile.centre));
+			upShape->rotate(tile.flipped ? rotation + 180.0f : rotation);
+			upBatch.push_back(std::move(upShape));
 		}
+		AddShapes(upBatch);
 
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		regionStatus_ = "Filled " + std::to_string(tiles.size()) + " tiles in " + std::to_string((int)ms) + " ms";
+		region_.clear();
+		regionClosed_ = false;
+	}
 
+	// Do post tess draw updates for the Periodic tool
+	// The placed shapes are the unit cell. Two clicks pick the lattice vectors,
+	// after which the unit cell is repeated over the whole visible canvas.
+	// Key D instead finds the unit cell and lattice of a placed periodic patch.
+	bool ToolPeriodicUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
 		// ***************************
-		// Draw the shapes
+		// Mouse Input - Undo
 		// ***************************
 
-		closestDist_ = { 100000.0f, 100000.0f }; // Initialize with a large value
-
-		// Draw all placed shapes. Also find the closest shape to the mouse
-		for (const auto& shape : upShapes_) {
-			shape->draw(olc::WHITE);
-			olc::vf2d dist = vMouse - shape->getCentroid();
-			if (dist.mag() < closestDist_.mag()) {
-				closestDist_ = dist;
-				pClosestShape_ = shape.get();
+		// Right click removes the last lattice vector, or turns the periodic
+		// tiling off again and returns the unit cell (or every copy of a
+		// detected patch) to the placed shapes
+		if (GetMouse(1).bPressed) {
+			if (!latticeVectors_.empty()) {
+				latticeVectors_.pop_back();
+			}
+			else if (periodic_.isBounded()) {
+				std::vector<std::unique_ptr<TessShape>> upBlock = periodic_.takeBlock();
+				InsertShapes(upBlock);
+				undo_.clear(); // Undo would take them back along with what was placed since
+				periodicStatus_.clear();
+			}
+			else if (periodic_.isActive()) {
+				std::vector<std::unique_ptr<TessShape>> upCell = periodic_.takeUnitCell();
+				InsertShapes(upCell);
+				undo_.clear();
 			}
 		}
 
-		// Handle tool-specific updates, after drawing the shapes
-		switch (currentTool_)
-		{
-		case ToolType::PlaceShape:
-				ret &= ToolPlaceShapeUpdatePost(fElapsedTime, vMouse);
-				break;
-		case ToolType::FillShape:
-				ret &= ToolFillUpdatePost(fElapsedTime, vMouse);
-				break;
+		if (!periodicStatus_.empty()) {
+			DrawString({ 4, 4 }, periodicStatus_, olc::CYAN);
 		}
 
+		if (periodic_.isActive() || upShapes_.empty()) {
+			return true;
+		}
 
+		// ***************************
+		// Keyboard Input - Detect
+		// ***************************
 
-		return ret;
-
-	}
-
-	void CreateNewTriangle(const olc::vf2d& position, float sideLength=SIDE_LENGTH) {
-		// Height of the equilateral triangle
-		float height = (std::sqrt(3.0f) / 2.0f) * sideLength;
+		if (GetKey(olc::Key::D).bPressed) {
+			DetectPeriodicity();
+			return true;
+		}
 
-		// Calculate vertices of the equilateral triangle
-		olc::vf2d p0 = position + olc::vf2d(0.0f, -2.0f / 3.0f * height); // Top vertex
-		olc::vf2d p1 = position + olc::vf2d(-sideLength / 2.0f, height / 3.0f); // Bottom left vertex
-		olc::vf2d p2 = position + olc::vf2d(sideLength / 2.0f, height / 3.0f); // Bottom right vertex
+		// ***************************
+		// Mouse Input - Pick lattice vectors
+		// ***************************
 
-		// Create a vector of points and initiaize the current shape
-		std::vector<olc::vf2d> points = { p0, p1, p2 };
-		upCurrentShape_ = std::make_unique<TessShape>(&tv_,points);
-	}
+		// The candidate lattice vector moves the unit cell's first vertex to the
+		// mouse, snapped to a vertex of the unit cell when one is close by
+		olc::vf2d anchor = upShapes_.front()->getDrawPoints().front();
+		olc::vf2d translation = vMouse - anchor;
+		float snapDist = SNAP_DIST_MAX;
+		for (const auto& upShape : upShapes_) {
+			for (const auto& point : upShape->getDrawPoints()) {
+				float distance = (point - vMouse).mag();
+				if (distance < snapDist) {
+					snapDist = distance;
+					translation = point - anchor;
+				}
+			}
+		}
 
-	void CreateNewSquare(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
-		// Calculate half of the side length to position vertices around the center
-		float halfSide = sideLength / 2.0f;
+		if (GetMouse(0).bPressed && translation.mag() > SNAP_DIST_MAX) {
+			latticeVectors_.push_back(translation);
+			if (latticeVectors_.size() == 2) {
+				std::vector<std::unique_ptr<TessShape>> upCell = TakeShapesFrom(0);
+				if (periodic_.setUnitCell(std::move(upCell), latticeVectors_[0], latticeVectors_[1])) {
+					undo_.clear();
+				}
+				else {
+					InsertShapes(upCell); // Back as they were
+				}
+				latticeVectors_.clear();
+				return true;
+			}
+		}
 
-		// Calculate vertices of the square
-		olc::vf2d p0 = position + olc::vf2d(-halfSide, -halfSide); // Top left vertex
-		olc::vf2d p1 = position + olc::vf2d(halfSide, -halfSide);  // Top right vertex
-		olc::vf2d p2 = position + olc::vf2d(halfSide, halfSide);   // Bottom right vertex
-		olc::vf2d p3 = position + olc::vf2d(-halfSide, halfSide);  // Bottom left vertex
+		// ***************************
+		// Draw the unit cell copy and the lattice vectors
+		// ***************************
+		for (const auto& upShape : upShapes_) {
+			const auto& points = upShape->getDrawPoints();
+			for (size_t i = 0; i < points.size(); ++i) {
+				tv_.DrawLine(points[i] + translation, points[(i + 1) % points.size()] + translation, olc::CYAN);
+			}
+		}
+		for (const auto& vector : latticeVectors_) {
+			tv_.DrawLine(anchor, anchor + vector, olc::YELLOW);
+		}
+		tv_.DrawLine(anchor, anchor + translation, olc::GREEN);
 
-		// Create a vector of points and initialize the current shape
-		std::vector<olc::vf2d> points = { p0, p1, p2, p3 };
-		upCurrentShape_ = std::make_unique<TessShape>(&tv_, points);
+		return true;
 	}
 
-	void CreateNewHexagon(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
-		std::vector<olc::vf2d> points;
+	// Find the unit cell and lattice the placed shapes repeat on, and keep
+	// the block of copies as one periodic tiling: the unit cell is held
+	// once and only the copies on screen are generated. Shapes that aren't
+	// copies stay placed. Nothing changes unless every copy in the block is
+	// there and the cell is at most half the shapes.
+	void DetectPeriodicity()
+	{
+		auto start = std::chrono::steady_clock::now();
+		TessSceneFile::Tables tables;
+		std::vector<TessSceneFile::TileRecord> tiles(upShapes_.size());
+		std::string error;
+		for (size_t i = 0; i < upShapes_.size(); ++i) {
+			if (!tables.encode(*upShapes_[i], tiles[i], error)) {
+				periodicStatus_ = error;
+				return;
+			}
+		}
 
-		// The angle between the center and any vertex of the hexagon is 60 degrees (pi/3 radians).
-		// We loop through all six vertices to calculate their positions.
-		for (int i = 0; i < 6; ++i) {
-			float angle_rad = (float)(M_PI / 3.0f * i); // Convert angle to radians
-			// Calculate the position of each vertex
-			olc::vf2d vertex = position + olc::vf2d(cos(angle_rad) * sideLength, sin(angle_rad) * sideLength);
-			points.push_back(vertex);
+		TessPeriodicity::Repeat repeat;
+		if (!TessPeriodicity::find(tiles.data(), tiles.size(), repeat, true) || repeat.cell.size() * 2 > upShapes_.size()) {
+			periodicStatus_ = "No periodic patch found";
+			return;
 		}
 
-		// Create a new TessShape with the calculated vertices
-		upCurrentShape_ = std::make_unique<TessShape>(&tv_, points);
+		// Stored positions to world units
+		const double SCALE = 1.0 / ((double)TessPeriodicity::FINE * TessSceneFile::POSITION_SCALE);
+		std::vector<std::unique_ptr<TessShape>> upCell;
+		for (const TessPeriodicity::CellTile& cellTile : repeat.cell) {
+			auto upShape = std::make_unique<TessShape>(*upShapes_[cellTile.tile]);
+			upShape->moveTo({ (float)(cellTile.x * SCALE), (float)(cellTile.y * SCALE) });
+			upCell.push_back(std::move(upShape));
+		}
+		olc::vf2d a = { (float)(repeat.ax * SCALE), (float)(repeat.ay * SCALE) };
+		olc::vf2d b = { (float)(repeat.bx * SCALE), (float)(repeat.by * SCALE) };
+		if (!periodic_.setUnitCell(std::move(upCell), a, b, repeat.countA, repeat.countB)) {
+			periodicStatus_ = "No periodic patch found";
+			return;
+		}
+		// The shapes moved into the periodic tiling can't be undone back
+		std::vector<std::unique_ptr<TessShape>> upPatch = TakeShapesFrom(0);
+		std::vector<std::unique_ptr<TessShape>> upResidual;
+		for (uint32_t t : repeat.residual) {
+			upResidual.push_back(std::move(upPatch[t]));
+		}
+		InsertShapes(upResidual);
+		undo_.clear();
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		periodicStatus_ = std::to_string(repeat.cell.size()) + " shape cell x " + std::to_string(repeat.countA) + " x " +
+			std::to_string(repeat.countB) + ", " + std::to_string(upResidual.size()) + " left over, in " + std::to_string((int)ms) + " ms";
 	}
 
-	//void CreateNewDart(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
-	//	std::vector<olc::vf2d> points;
+	// Do post tess draw updates for the Wallpaper tool
+	// The placed shapes are the fundamental domain. Clicking sets the origin of
+	// the chosen wallpaper group and fills the canvas with the symmetric tiling.
+	bool ToolWallpaperUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		// Right click turns the wallpaper off and returns the domain to the placed shapes
+		if (GetMouse(1).bPressed && wallpaper_.isActive()) {
+			std::vector<std::unique_ptr<TessShape>> upDomain = wallpaper_.takeDomain();
+			InsertShapes(upDomain);
+			undo_.clear(); // Undo would take it back along with what was placed since
+			atlas_.clear();
+		}
 
-	//	// Assuming the dart is oriented vertically with one tip at 'position'
-	//	float height = (float)((std::sqrt(3) / 2) * sideLength); // Height of an equilateral triangle
+		if (wallpaper_.isActive()) {
+			DrawString({ 4, 4 }, TessWallpaper::groupName(wallpaper_.getGroup()), olc::WHITE);
+			return true;
+		}
 
-	//	// Calculate vertices based on the dart shape
-	//	olc::vf2d topTip = position; // Top tip of the dart
-	//	olc::vf2d rightVertex = { position.x + (sideLength / 2), position.y + height };
-	//	olc::vf2d bottomTip = { position.x, position.y + 2 * height };
-	//	olc::vf2d leftVertex = { position.x - (sideLength / 2), position.y + height };
+		// ***************************
+		// Handle Keyboard and Mouse Input - Pick the group and cell size
+		// ***************************
+		int groupCount = (int)WallpaperGroup::Count;
+		int groupDelta = 0;
+		timeSinceLastRotation_ += fElapsedTime;
+		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			groupDelta = -1;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		if (GetKey(olc::Key::PERIOD).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			groupDelta = 1;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		int nMouseWheelDelta = GetMouseWheel();
+		if (nMouseWheelDelta > 0) {
+			groupDelta = -1;
+		}
+		else if (nMouseWheelDelta < 0) {
+			groupDelta = 1;
+		}
+		wallpaperGroup_ = (WallpaperGroup)(((int)wallpaperGroup_ + groupDelta + groupCount) % groupCount);
+
+		// Change the cell size with the '-' and '=' keys
+		if (GetKey(olc::Key::MINUS).bPressed && wallpaperCellSize_ > SIDE_LENGTH) {
+			wallpaperCellSize_ -= SIDE_LENGTH / 2.0f;
+		}
+		if (GetKey(olc::Key::EQUALS).bPressed) {
+			wallpaperCellSize_ += SIDE_LENGTH / 2.0f;
+		}
+
+		// The group origin follows the mouse, snapped to the nearest placed vertex
+		olc::vf2d origin = vMouse;
+		float snapDist = SNAP_DIST_MAX;
+		for (const auto& upShape : upShapes_) {
+			for (const auto& point : upShape->snapPoints()) {
+				float distance = (point - vMouse).mag();
+				if (distance < snapDist) {
+					snapDist = distance;
+					origin = point;
+				}
+			}
+		}
+
+		// ***************************
+		// Mouse Input - Generate the wallpaper
+		// ***************************
+		if (GetMouse(0).bPressed && !upShapes_.empty()) {
+			wallpaper_.setDomain(TakeShapesFrom(0), wallpaperGroup_, origin, wallpaperCellSize_);
+			undo_.clear();
+			atlas_.clear(); // Orbit images reuse the same atlas geometry ids
+			return true;
+		}
+
+		// ***************************
+		// Draw the lattice cell at the origin and the group name
+		// ***************************
+		TessLattice lattice = TessWallpaper::latticeFor(wallpaperGroup_, wallpaperCellSize_);
+		olc::vf2d corners[4] = { origin, origin + lattice.a, origin + lattice.a + lattice.b, origin + lattice.b };
+		for (int i = 0; i < 4; ++i) {
+			tv_.DrawLine(corners[i], corners[(i + 1) % 4], olc::CYAN);
+		}
+		tv_.FillCircle(origin, SIDE_LENGTH / 10.0f, olc::YELLOW);
+		DrawString({ 4, 4 }, TessWallpaper::groupName(wallpaperGroup_), olc::CYAN);
+
+		return true;
+	}
+
+	// Do post tess draw updates for the Uniform tiling tool
+	// Clicking grows a patch of the chosen uniform tiling out from the mouse position.
+	bool ToolUniformUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		const std::vector<std::string>& presets = TessUniformTiling::presets();
+
+		// ***************************
+		// Handle Keyboard and Mouse Input - Pick the vertex configuration and patch size
+		// ***************************
+		int presetCount = (int)presets.size();
+		timeSinceLastRotation_ += fElapsedTime;
+		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			uniformPreset_ = (uniformPreset_ - 1 + presetCount) % presetCount;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		if (GetKey(olc::Key::PERIOD).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			uniformPreset_ = (uniformPreset_ + 1) % presetCount;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		int nMouseWheelDelta = GetMouseWheel();
+		if (nMouseWheelDelta > 0) {
+			uniformPreset_ = (uniformPreset_ - 1 + presetCount) % presetCount;
+		}
+		else if (nMouseWheelDelta < 0) {
+			uniformPreset_ = (uniformPreset_ + 1) % presetCount;
+		}
+
+		// Change the patch size with the '-' and '=' keys
+		if (GetKey(olc::Key::MINUS).bPressed && uniformMaxTiles_ > 10) {
+			uniformMaxTiles_ /= 10;
+		}
+		if (GetKey(olc::Key::EQUALS).bPressed && uniformMaxTiles_ < 1000000) {
+			uniformMaxTiles_ *= 10;
+		}
+
+		// The seed vertex follows the mouse, snapped to the nearest placed vertex
+		olc::vf2d seed = vMouse;
+		if (TessShape* pClosestShape = ClosestShape()) {
+			float snapDist = SNAP_DIST_MAX;
+			for (const auto& point : pClosestShape->getDrawPoints()) {
+				float distance = (point - vMouse).mag();
+				if (distance < snapDist) {
+					snapDist = distance;
+					seed = point;
+				}
+			}
+		}
+
+		// ***************************
+		// Mouse Input - Generate a patch, or remove the last one
+		// ***************************
+		if (GetMouse(0).bPressed) {
+			std::vector<int> config;
+			if (TessUniformTiling::parseConfiguration(presets[uniformPreset_], config)) {
+				AddUniformTiles(TessUniformTiling::generate(config, seed, SIDE_LENGTH, uniformMaxTiles_));
+			}
+		}
+
+		// Right click undoes the last edit, the last generated patch as a whole
+		if (GetMouse(1).bPressed) {
+			Undo();
+		}
+
+		// ***************************
+		// Draw the seed vertex and the configuration
+		// ***************************
+		tv_.FillCircle(seed, SIDE_LENGTH / 10.0f, olc::YELLOW);
+		DrawString({ 4, 4 }, presets[uniformPreset_] + "  x" + std::to_string(uniformMaxTiles_), olc::CYAN);
+
+		return true;
+	}
+
+	// Do post tess draw updates for the Substitution tiling tool
+	// Clicking starts a Penrose tiling centred on the mouse. It covers the whole
+	// canvas and is only subdivided where it is visible.
+	bool ToolSubstitutionUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		// ***************************
+		// Handle Keyboard and Mouse Input - Pick the rule
+		// ***************************
+		int ruleCount = (int)SubstitutionRule::Count;
+		int ruleDelta = 0;
+		timeSinceLastRotation_ += fElapsedTime;
+		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			ruleDelta = -1;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		if (GetKey(olc::Key::PERIOD).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			ruleDelta = 1;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		int nMouseWheelDelta = GetMouseWheel();
+		if (nMouseWheelDelta > 0) {
+			ruleDelta = -1;
+		}
+		else if (nMouseWheelDelta < 0) {
+			ruleDelta = 1;
+		}
+		substitutionRule_ = (SubstitutionRule)(((int)substitutionRule_ + ruleDelta + ruleCount) % ruleCount);
+
+		// ***************************
+		// Mouse Input - Start the tiling, or turn it off
+		// ***************************
+		if (GetMouse(0).bPressed) {
+			substitution_.setRule(substitutionRule_, olc::vd2d(vMouse), SUBSTITUTION_RADIUS);
+		}
+		if (GetMouse(1).bPressed) {
+			substitution_.clear();
+		}
+
+		// ***************************
+		// Draw the rule, and the depth and size of the expansion
+		// ***************************
+		DrawString({ 4, 4 }, TessSubstitutionTiling::ruleName(substitutionRule_), olc::CYAN);
+		if (substitution_.isActive()) {
+			DrawString({ 4, 14 }, "depth " + std::to_string(substitutionDepth_) + "  x" + std::to_string(substitutionTriangles_), olc::WHITE);
+		}
+
+		return true;
+	}
+
+	// Do post tess draw updates for the Coverage tool
+	// Dragging picks a world rectangle (a click picks the visible one) and
+	// analyzes it in the background for gaps and overlaps between the shapes.
+	bool ToolCoverageUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		coverage_.poll();
+
+		// ***************************
+		// Handle Keyboard Input - Change the sample size with the '-' and '=' keys
+		// ***************************
+		if (GetKey(olc::Key::MINUS).bPressed && coverageResolution_ > SIDE_LENGTH / 64.0f) {
+			coverageResolution_ /= 2.0f;
+		}
+		if (GetKey(olc::Key::EQUALS).bPressed && coverageResolution_ < SIDE_LENGTH) {
+			coverageResolution_ *= 2.0f;
+		}
+
+		// ***************************
+		// Mouse Input - Pick the rectangle and start the analysis, or clear it
+		// ***************************
+		if (GetMouse(0).bPressed) {
+			coverageDragStart_ = vMouse;
+			coverageDragging_ = true;
+		}
+		olc::vf2d dragMin = coverageDragStart_.min(vMouse);
+		olc::vf2d dragMax = coverageDragStart_.max(vMouse);
+		if (GetMouse(0).bReleased && coverageDragging_) {
+			coverageDragging_ = false;
+			if ((tv_.WorldToScreen(dragMax) - tv_.WorldToScreen(dragMin)).mag() < SNAP_DIST_MAX) {
+				StartCoverage(tv_.GetWorldTL(), tv_.GetWorldBR());
+			}
+			else {
+				StartCoverage(dragMin, dragMax);
+			}
+		}
+		if (GetMouse(1).bPressed) {
+			coverage_.clear();
+		}
+
+		// ***************************
+		// Draw the rectangle, the gaps and overlaps found, and a summary
+		// ***************************
+		if (coverageDragging_) {
+			tv_.DrawRect(dragMin, dragMax - dragMin, olc::CYAN);
+		}
+
+		std::string resolution = "sample " + std::to_string(coverageResolution_).substr(0, 5);
+		if (coverage_.isRunning()) {
+			DrawString({ 4, 4 }, "Analyzing...  " + resolution, olc::CYAN);
+			return true;
+		}
+		if (!coverage_.hasResult()) {
+			DrawString({ 4, 4 }, "Drag a rectangle  " + resolution, olc::CYAN);
+			return true;
+		}
+
+		const TessCoverageAnalyzer::Result& result = coverage_.getResult();
+		tv_.DrawRect(result.worldTL, result.worldBR - result.worldTL, olc::CYAN);
+
+		// Regions are outlined at least a few pixels across, so single sample gaps show up
+		olc::vf2d minSize = olc::vf2d(4.0f, 4.0f) / tv_.GetWorldScale().x;
+		auto drawRegions = [&](const std::vector<TessCoverageAnalyzer::Region>& regions, olc::Pixel color) {
+			for (const auto& region : regions) {
+				olc::vf2d centre = (region.vMin + region.vMax) * 0.5f;
+				olc::vf2d half = ((region.vMax - region.vMin) * 0.5f).max(minSize);
+				tv_.DrawRect(centre - half, half * 2.0f, color);
+			}
+		};
+		drawRegions(result.gaps, olc::RED);
+		drawRegions(result.overlaps, olc::YELLOW);
+
+		auto percent = [&](double area) {
+			return std::to_string(100.0 * area / result.rectArea).substr(0, 6) + "%";
+		};
+		DrawString({ 4, 4 }, "Gaps " + percent(result.uncoveredArea) + " in " + std::to_string(result.gaps.size()) + " regions", olc::RED);
+		DrawString({ 4, 14 }, "Overlaps " + percent(result.overlapArea) + " in " + std::to_string(result.overlaps.size()) + " regions", olc::YELLOW);
+		DrawString({ 4, 24 }, std::to_string(result.polygons) + " shapes, " + std::to_string(result.width) + "x" + std::to_string(result.height) +
+			" samples, " + std::to_string((int)result.milliseconds) + " ms", olc::WHITE);
+
+		return true;
+	}
+
+	// Snapshot the shapes in the world rectangle [worldTL, worldBR] and start
+	// analyzing their coverage in the background
+	void StartCoverage(const olc::vf2d& worldTL, const olc::vf2d& worldBR)
+	{
+		TessCoverageAnalyzer::Snapshot snapshot;
+		shapeIndex_.query(worldTL, worldBR, [&](const TessSpatialIndex::Entry& entry) {
+			snapshot.add(entry.pShape->getDrawPoints());
+		});
+
+		// Generated tilings count too
+		periodic_.forEachShape([&](TessShape& shape) {
+			snapshot.add(shape.getDrawPoints());
+		});
+		wallpaper_.forEachVisibleImage(worldTL, worldBR,
+			[&](size_t imageIndex, const TessWallpaper::Image& image, const olc::vf2d& offset) {
+				snapshot.add(image.points, offset);
+			});
+
+		coverage_.start(worldTL, worldBR, coverageResolution_, std::move(snapshot));
+	}
+
+	// Do pre-draw updates for the Select tool
+	// Dragging from empty space picks the placed shapes whose centres fall in a
+	// rectangle (or lasso); dragging a selected shape moves the selection, and
+	// the wheel or '<' '>' turn it about its centre.
+	bool ToolSelectUpdatePre(float fElapsedTime, olc::vf2d vMouse)
+	{
+		// ***************************
+		// Handle Keyboard Input
+		// ***************************
+
+		// Copy the selection with Ctrl+C, and stamp copies of it with Ctrl+V
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::C).bPressed && !selection_.empty()) {
+			CopySelection();
+		}
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::V).bPressed && clipboard_) {
+			ApplySelectionMove();
+			pasting_ = true;
+			pasteBegin_ = stamps_.size();
+		}
+		if (pasting_) {
+			return ToolPasteUpdatePre(fElapsedTime, vMouse);
+		}
+
+		// Toggle between rectangle and lasso selection with the 'L' key
+		if (GetKey(olc::Key::L).bPressed) {
+			selectLasso_ = !selectLasso_;
+		}
+
+		// Fill the selection with the Fill tool's color with the 'F' key
+		if (GetKey(olc::Key::F).bPressed) {
+			ApplySelectionMove();
+			RecolorShapes(selection_, colors_[currentColorIndex_]);
+		}
+
+		// Turn the selection with the '<' and '>' keys, or the scroll wheel
+		float turn = 0.0f;
+		timeSinceLastRotation_ += fElapsedTime;
+		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			turn = -15.0f;
+		}
+		if (GetKey(olc::Key::PERIOD).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			turn = 15.0f;
+		}
+		int nMouseWheelDelta = GetMouseWheel();
+		if (nMouseWheelDelta > 0) {
+			turn = -15.0f;
+		}
+		else if (nMouseWheelDelta < 0) {
+			turn = 15.0f;
+		}
+		if (turn != 0.0f && !selection_.empty()) {
+			selectionTurn_ += turn;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+
+		// ***************************
+		// Handle Mouse Input - Select, or move the selection
+		// ***************************
+		if (GetMouse(0).bPressed) {
+			ApplySelectionMove();
+			selectDragStart_ = vMouse;
+			selectionMoving_ = SelectionContains(vMouse);
+			selecting_ = !selectionMoving_;
+			lasso_.assign(1, vMouse);
+		}
+		if (selectionMoving_) {
+			selectionOffset_ = vMouse - selectDragStart_;
+		}
+		if (selecting_ && selectLasso_ && (tv_.WorldToScreen(vMouse) - tv_.WorldToScreen(lasso_.back())).mag() >= SNAP_DIST_MAX) {
+			lasso_.push_back(vMouse);
+		}
+		if (GetMouse(0).bReleased) {
+			if (selecting_) {
+				// Shift adds to the selection
+				SelectShapes(vMouse, GetKey(olc::Key::SHIFT).bHeld);
+			}
+			selecting_ = false;
+			selectionMoving_ = false;
+			ApplySelectionMove();
+		}
+
+		// A turn without a drag is applied once the turning stops
+		if (!selectionMoving_ && selectionTurn_ != 0.0f && timeSinceLastRotation_ >= SELECTION_TURN_DELAY) {
+			ApplySelectionMove();
+		}
+
+		// Right click clears the selection
+		if (GetMouse(1).bPressed) {
+			ApplySelectionMove();
+			selection_.clear();
+		}
+
+		return true;
+	}
+
+	// Do post tess draw updates for the Select tool
+	bool ToolSelectUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		if (pasting_) {
+			return ToolPasteUpdatePost(fElapsedTime, vMouse);
+		}
+		if (selecting_ && selectLasso_) {
+			for (size_t i = 1; i < lasso_.size(); ++i) {
+				tv_.DrawLine(lasso_[i - 1], lasso_[i], olc::CYAN);
+			}
+			tv_.DrawLine(lasso_.back(), vMouse, olc::CYAN);
+		}
+		else if (selecting_) {
+			olc::vf2d dragMin = selectDragStart_.min(vMouse);
+			olc::vf2d dragMax = selectDragStart_.max(vMouse);
+			tv_.DrawRect(dragMin, dragMax - dragMin, olc::CYAN);
+		}
+		DrawString({ 4, 4 }, std::string(selectLasso_ ? "Lasso" : "Rectangle") + "  " + std::to_string(selection_.size()) + " selected", olc::CYAN);
+
+		return true;
+	}
+
+	// Do pre-draw updates for the Select tool while it pastes
+	// The clipboard follows the mouse, snapped to the closest shape, and each
+	// click stamps it there.
+	bool ToolPasteUpdatePre(float fElapsedTime, olc::vf2d vMouse)
+	{
+		// ***************************
+		// Handle Keyboard Input
+		// ***************************
+
+		// Turn the stamp with the '<' and '>' keys, or the scroll wheel
+		timeSinceLastRotation_ += fElapsedTime;
+		if (GetKey(olc::Key::COMMA).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			pasteRotation_ -= 15.0f;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		if (GetKey(olc::Key::PERIOD).bHeld && timeSinceLastRotation_ >= ROTATION_INTERVAL) {
+			pasteRotation_ += 15.0f;
+			timeSinceLastRotation_ = 0.0f; // Reset the timer
+		}
+		int nMouseWheelDelta = GetMouseWheel();
+		if (nMouseWheelDelta > 0) {
+			pasteRotation_ -= 15.0f;
+		}
+		else if (nMouseWheelDelta < 0) {
+			pasteRotation_ += 15.0f;
+		}
+		pasteRotation_ = std::fmod(pasteRotation_, 360.0f);
+
+		// Bake the stamps into placed shapes with the 'Enter' key
+		if (GetKey(olc::Key::ENTER).bPressed) {
+			BakeStamps();
+		}
+
+		// ***************************
+		// Handle Mouse Input - Stamp the clipboard
+		// ***************************
+		pastePosition_ = SnapPaste(vMouse);
+		if (GetMouse(0).bPressed) {
+			stamps_.stamp(clipboard_, pastePosition_, pasteRotation_);
+		}
+
+		// Right click takes back the last stamp of this paste, or stops pasting
+		if (GetMouse(1).bPressed) {
+			if (stamps_.size() > pasteBegin_) {
+				stamps_.removeLast();
+			}
+			else {
+				pasting_ = false;
+				BakeStamps();
+			}
+		}
+
+		return true;
+	}
+
+	// Do post tess draw updates for the Select tool while it pastes
+	bool ToolPasteUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		TessTransform motion = TessTransform::translation(pastePosition_) * TessTransform::rotation(pasteRotation_);
+		for (const auto& upShape : clipboard_->upShapes) {
+			DrawMovedShape(*upShape, motion, pasteRotation_, olc::CYAN);
+		}
+		DrawString({ 4, 4 }, "Pasting " + std::to_string(clipboard_->upShapes.size()) + " shapes  " +
+			std::to_string(stamps_.size()) + " stamps", olc::CYAN);
+
+		return true;
+	}
+
+	// Bake the stamps into placed shapes, as one edit that can be undone and
+	// is journaled like any other. Stamps are only kept while pasting.
+	void BakeStamps()
+	{
+		if (stamps_.empty()) {
+			return;
+		}
+		std::vector<std::unique_ptr<TessShape>> upBatch = stamps_.expandAll();
+		ClearStamps();
+		AddShapes(upBatch);
+	}
+
+	// Drop the stamps, and the copy of the one closest to the mouse
+	void ClearStamps()
+	{
+		stamps_.clear();
+		pasteBegin_ = 0;
+		closestStamp_ = SIZE_MAX;
+		if (pClosestUnplacedShape_ == upClosestStampShape_.get()) {
+			pClosestUnplacedShape_ = nullptr;
+		}
+		upClosestStampShape_.reset();
+	}
+
+	// Copy the selected shapes to the clipboard, as a patch centred on the
+	// selection's pivot
+	void CopySelection()
+	{
+		ApplySelectionMove();
+		std::vector<TessShape*> pShapes;
+		pShapes.reserve(selection_.size());
+		for (size_t i : selection_) {
+			pShapes.push_back(upShapes_[i].get());
+		}
+		clipboard_ = TessInstances::makePatch(pShapes, selectionPivot_);
+		pasteRotation_ = 0.0f;
+	}
+
+	// Where the next stamp of the clipboard goes: centred on the mouse, then
+	// moved so that the nearest pair of a vertex or edge midpoint of the
+	// stamp and one of the closest shape meet, if they are near enough
+	olc::vf2d SnapPaste(const olc::vf2d& vMouse)
+	{
+		TessShape* pClosestShape = ClosestShape();
+		if (!pClosestShape) {
+			return vMouse;
+		}
+
+		TessTransform motion = TessTransform::translation(vMouse) * TessTransform::rotation(pasteRotation_);
+		olc::vf2d target = pClosestShape->getCentroid();
+		std::vector<olc::vf2d> targetPoints = pClosestShape->snapPoints();
+		olc::vf2d snap = { 0.0f, 0.0f };
+		float snapDist = SNAP_DIST_MAX;
+		for (const auto& upShape : clipboard_->upShapes) {
+			// Only the stamp's shapes next to the closest shape can meet it
+			if ((motion.apply(upShape->getCentroid()) - target).mag() > 4.0f * SIDE_LENGTH) {
+				continue;
+			}
+			for (const auto& point : upShape->snapPoints()) {
+				olc::vf2d moved = motion.apply(point);
+				for (const auto& targetPoint : targetPoints) {
+					float distance = (targetPoint - moved).mag();
+					if (distance < snapDist) {
+						snapDist = distance;
+						snap = targetPoint - moved;
+					}
+				}
+			}
+		}
+		return vMouse + snap;
+	}
+
+	// Select the placed shapes whose centres are in the rectangle or lasso
+	// dragged out to vMouse, found through the spatial index. With add, they
+	// join the current selection.
+	void SelectShapes(const olc::vf2d& vMouse, bool add)
+	{
+		olc::vf2d vMin = selectDragStart_.min(vMouse);
+		olc::vf2d vMax = selectDragStart_.max(vMouse);
+		if (selectLasso_) {
+			lasso_.push_back(vMouse);
+			for (const auto& point : lasso_) {
+				vMin = vMin.min(point);
+				vMax = vMax.max(point);
+			}
+		}
+
+		std::vector<size_t> selection;
+		shapeIndex_.query(vMin, vMax, [&](const TessSpatialIndex::Entry& entry) {
+			olc::vf2d centroid = entry.pShape->getCentroid();
+			bool inside = selectLasso_ ? TessPolygon::containsPoint(lasso_.data(), lasso_.size(), centroid) :
+				centroid.x >= vMin.x && centroid.x <= vMax.x && centroid.y >= vMin.y && centroid.y <= vMax.y;
+			if (inside) {
+				selection.push_back(upShapes_.indexOf(upShapes_.find(entry.pShape)));
+			}
+		});
+		std::sort(selection.begin(), selection.end());
+		if (add) {
+			std::vector<size_t> merged;
+			std::set_union(selection_.begin(), selection_.end(), selection.begin(), selection.end(), std::back_inserter(merged));
+			selection.swap(merged);
+		}
+		selection_.swap(selection);
+		UpdateSelectionPivot();
+	}
+
+	// Put the pivot the selection turns about at the mean of its centres
+	void UpdateSelectionPivot()
+	{
+		selectionPivot_ = { 0.0f, 0.0f };
+		for (size_t i : selection_) {
+			selectionPivot_ += upShapes_[i]->getCentroid();
+		}
+		if (!selection_.empty()) {
+			selectionPivot_ /= (float)selection_.size();
+		}
+	}
+
+	// True if point is inside a selected shape
+	bool SelectionContains(const olc::vf2d& point)
+	{
+		for (size_t i : selection_) {
+			if (upShapes_[i]->isInside(point)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Apply the move and turn of the selection so far to the shapes, as one
+	// edit that can be undone
+	void ApplySelectionMove()
+	{
+		if (selectionOffset_ == olc::vf2d(0.0f, 0.0f) && selectionTurn_ == 0.0f) {
+			return;
+		}
+		TransformShapes(selection_, selectionPivot_, selectionTurn_, selectionOffset_);
+		selectionPivot_ += selectionOffset_;
+		selectDragStart_ += selectionOffset_; // A drag still going on carries on from here
+		selectionOffset_ = { 0.0f, 0.0f };
+		selectionTurn_ = 0.0f;
+	}
+
+	// Do pre-draw updates for the Eraser tool
+	// Dragging erases the placed shapes under the mouse, or under the brush
+	bool ToolEraseUpdatePre(float fElapsedTime, olc::vf2d vMouse)
+	{
+		// ***************************
+		// Handle Keyboard Input - Change the brush radius with the '-' and '=' keys
+		// ***************************
+		if (GetKey(olc::Key::MINUS).bPressed) {
+			eraseRadius_ = std::max(0.0f, eraseRadius_ - SIDE_LENGTH / 2.0f);
+		}
+		if (GetKey(olc::Key::EQUALS).bPressed && eraseRadius_ < ERASE_RADIUS_MAX) {
+			eraseRadius_ += SIDE_LENGTH / 2.0f;
+		}
+
+		// ***************************
+		// Mouse Input - Erase, each drag as one edit, and undo
+		// ***************************
+		if (GetMouse(0).bPressed) {
+			eraseStroke_ = false;
+		}
+		if (GetMouse(0).bHeld && EraseShapesNear(vMouse, eraseRadius_, eraseStroke_)) {
+			eraseStroke_ = true;
+		}
+		if (GetMouse(1).bPressed) {
+			Undo();
+		}
+
+		return true;
+	}
+
+	// Do post tess draw updates for the Eraser tool
+	bool ToolEraseUpdatePost(float fElapsedTime, olc::vf2d vMouse)
+	{
+		if (eraseRadius_ > 0.0f) {
+			tv_.DrawCircle(vMouse, eraseRadius_, olc::RED);
+		}
+		else {
+			TessShape* pClosestShape = ClosestShape();
+			if (pClosestShape && upShapes_.find(pClosestShape).slot != TessSlotMap<TessShape>::NONE && pClosestShape->isInside(vMouse)) {
+				pClosestShape->draw(olc::RED);
+			}
+		}
+		DrawString({ 4, 4 }, "Eraser radius " + std::to_string((int)eraseRadius_), olc::RED);
+
+		return true;
+	}
+
+	// Erase the placed shapes that contain centre or whose centres are within
+	// radius of it, found through the spatial index. With join, they carry
+	// on the last erase edit. Returns true if any were erased.
+	bool EraseShapesNear(const olc::vf2d& centre, float radius, bool join)
+	{
+		olc::vf2d reach = { radius, radius };
+		std::vector<size_t> indices;
+		shapeIndex_.query(centre - reach, centre + reach, [&](const TessSpatialIndex::Entry& entry) {
+			if ((entry.pShape->getCentroid() - centre).mag() <= radius || entry.pShape->isInside(centre)) {
+				indices.push_back(upShapes_.indexOf(upShapes_.find(entry.pShape)));
+			}
+		});
+		if (indices.empty()) {
+			return false;
+		}
+
+		// From the back, so a shape swapped into an erased one's place has
+		// already been dealt with
+		std::sort(indices.begin(), indices.end(), std::greater<size_t>());
+		std::vector<std::unique_ptr<TessShape>> upErased;
+		for (size_t index : indices) {
+			upErased.push_back(TakeShapeAt(index));
+		}
+		undo_.recordErase(std::move(indices), std::move(upErased), join);
+		return true;
+	}
+
+	// Draw one triangle of the substitution tiling: filled, with its two tile edges.
+	// The world to screen transform is done in double precision, and the triangle
+	// is clipped to the screen, so deep zooms neither jitter nor overflow.
+	void DrawSubstitutionTriangle(const TessSubstitutionTiling::Triangle& t)
+	{
+		olc::vd2d offset = olc::vd2d(tv_.GetWorldOffset());
+		olc::vd2d scale = olc::vd2d(tv_.GetWorldScale());
+		olc::vf2d points[3] = { olc::vf2d((t.a - offset) * scale), olc::vf2d((t.b - offset) * scale), olc::vf2d((t.c - offset) * scale) };
+
+		olc::vf2d vMin = { -1.0f, -1.0f };
+		olc::vf2d vMax = { (float)ScreenWidth(), (float)ScreenHeight() };
+		TessClip::polygon(points, 3, vMin, vMax, clipPoints_);
+		for (size_t i = 1; i + 1 < clipPoints_.size(); ++i) {
+			FillTriangle(olc::vi2d(clipPoints_[0]), olc::vi2d(clipPoints_[i]), olc::vi2d(clipPoints_[i + 1]), substitutionColors_[t.type]);
+		}
+
+		for (int i = 1; i < 3; ++i) {
+			olc::vf2d p = points[0];
+			olc::vf2d q = points[i];
+			if (TessClip::segment(p, q, vMin, vMax)) {
+				DrawLine(olc::vi2d(p), olc::vi2d(q), olc::WHITE);
+			}
+		}
+	}
+
+	// Add the tiles of a generated uniform tiling to the placed shapes, as
+	// one batch
+	void AddUniformTiles(const std::vector<TessUniformTiling::Tile>& tiles)
+	{
+		std::vector<std::unique_ptr<TessShape>> upBatch;
+		upBatch.reserve(tiles.size());
+		for (const auto& tile : tiles) {
+			ShapeType type = ShapeType::Triangle;
+			switch (tile.sides)
+			{
+				case 4: type = ShapeType::Square; break;
+				case 6: type = ShapeType::Hexagon; break;
+				case 8: type = ShapeType::Octagon; break;
+				case 12: type = ShapeType::Dodecagon; break;
+				default: break;
+			}
+
+			// Rotate the prototype so its first vertex lines up with the tile's.
+			// Both angles are multiples of 15 degrees apart, so round to that.
+			auto upShape = CreateNewShape(type, tile.centre);
+			olc::vf2d firstVertex = upShape->getDrawPoints().front() - upShape->getCentroid();
+			float prototypeAngle = std::atan2(firstVertex.y, firstVertex.x) * 180.0f / (float)M_PI;
+			float rotation = std::round((tile.firstVertexAngle - prototypeAngle) / 15.0f) * 15.0f;
+			rotation = std::fmod(rotation + 720.0f, 360.0f);
+			upShape->rotate(rotation);
+			upBatch.push_back(std::move(upShape));
+		}
+		AddShapes(upBatch);
+	}
+
+
+	bool OnUserDestroy() override
+	{
+		world_.close(); // Writes back the chunks that changed
+		journal_.close();
+		input_.stopRecording();
+		return true;
+	}
+
+	bool OnUserUpdate(float fElapsedTime) override
+	{
+		bool ret = true;
+
+		// Take the input of this frame, live or replayed
+		fElapsedTime = input_.beginFrame(*this, fElapsedTime);
+
+		Clear(olc::GREY);
+
+		// Switch tools with the 'T' key
+		//if (GetKey(olc::Key::T).bPressed) {
+		//	switch (currentTool_)
+		//	{
+		//		case ToolType::PlaceShape:
+		//			currentTool_ = ToolType::FillShape;
+		//			break;
+		//		case ToolType::FillShape:
+		//			currentTool_ = ToolType::PlaceShape;
+		//			break;
+		//	}
+		//}
+
+		// Number Key 1 selects the PlaceShape tool
+		if (GetKey(olc::Key::K1).bPressed) {
+			currentTool_ = ToolType::PlaceShape;
+		}
+
+		// Number Key 2 selects the FillShape tool
+		if (GetKey(olc::Key::K2).bPressed) {
+			currentTool_ = ToolType::FillShape;
+		}
+
+		// Number key 3 hides the tool
+		if (GetKey(olc::Key::K3).bPressed) {
+			currentTool_ = ToolType::HideTool;
+		}
+
+		// Number key 4 selects the Periodic tool
+		if (GetKey(olc::Key::K4).bPressed) {
+			currentTool_ = ToolType::Periodic;
+			latticeVectors_.clear();
+		}
+
+		// Number key 5 selects the Wallpaper tool
+		if (GetKey(olc::Key::K5).bPressed) {
+			currentTool_ = ToolType::Wallpaper;
+		}
+
+		// Number key 6 selects the Uniform tiling tool
+		if (GetKey(olc::Key::K6).bPressed) {
+			currentTool_ = ToolType::Uniform;
+		}
+
+		// Number key 7 selects the Substitution tiling tool
+		if (GetKey(olc::Key::K7).bPressed) {
+			currentTool_ = ToolType::Substitution;
+		}
+
+		// Number key 8 selects the Region fill tool
+		if (GetKey(olc::Key::K8).bPressed) {
+			currentTool_ = ToolType::RegionFill;
+		}
+
+		// Number key 9 selects the Coverage analysis tool
+		if (GetKey(olc::Key::K9).bPressed) {
+			currentTool_ = ToolType::Coverage;
+		}
+
+		// Number key 0 selects the Select tool
+		if (GetKey(olc::Key::K0).bPressed) {
+			currentTool_ = ToolType::Select;
+		}
+
+		// Key X selects the Eraser tool
+		if (GetKey(olc::Key::X).bPressed) {
+			currentTool_ = ToolType::Erase;
+		}
+
+		// The selection, and pasting, only last while the Select tool is in use
+		if (currentTool_ != ToolType::Select && !selection_.empty()) {
+			ApplySelectionMove();
+			selection_.clear();
+		}
+		if (currentTool_ != ToolType::Select && pasting_) {
+			pasting_ = false;
+			BakeStamps();
+		}
+
+		// Ctrl+S saves the scene, in the background once its edits are
+		// journaled, and Ctrl+O loads it
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::S).bPressed) {
+			BakeStamps();
+			if (journal_.isOpen()) {
+				journal_.save();
+				SetFileStatus("Saving " + journal_.scenePath());
+			}
+			else {
+				SaveScene(SCENE_FILE);
+			}
+		}
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::O).bPressed) {
+			LoadScene(SCENE_FILE);
+		}
+
+		// Ctrl+E exports the placed shapes as SVG
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::E).bPressed) {
+			BakeStamps();
+			ExportSvg(SVG_FILE);
+		}
+
+		// Ctrl+P exports the placed shapes as a PNG image
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::P).bPressed) {
+			BakeStamps();
+			ExportPng(PNG_FILE, PNG_EXPORT_WIDTH);
+		}
+
+		// Ctrl+Z undoes the last edit to the placed shapes, and Ctrl+Y redoes it
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::Z).bPressed) {
+			Undo();
+		}
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::Y).bPressed) {
+			Redo();
+		}
+
+		// Ctrl+W opens the streamed world, and moves the placed shapes into it
+		if (GetKey(olc::Key::CTRL).bHeld && GetKey(olc::Key::W).bPressed) {
+			BakeStamps();
+			MoveShapesToWorld();
+		}
+
+		// Zooming in and out
+		timeSinceLastZoom_ += fElapsedTime;
+		if (GetKey(olc::Key::Q).bHeld && timeSinceLastZoom_ >= ZOOM_INTERVAL) {
+			tv_.ZoomAtScreenPos(1.1f, { ScreenWidth() / 2, ScreenHeight() / 2 }); // Zoom in at screen center
+			//std::cout << "Q: Zoom Level: " << tv_.GetWorldScale().x << std::endl;
+			timeSinceLastZoom_ = 0.0f; // Reset the timer
+		}
+		if (GetKey(olc::Key::A).bHeld && timeSinceLastZoom_ >= ZOOM_INTERVAL) {
+			tv_.ZoomAtScreenPos(0.9f, { ScreenWidth() / 2, ScreenHeight() / 2 }); // Zoom out at screen center
+			//std::cout << "A: Zoom Level: " << tv_.GetWorldScale().x << std::endl;
+			timeSinceLastZoom_ = 0.0f; // Reset the timer
+		}
+
+		// Panning
+		olc::vf2d panDelta = { 0.0f, 0.0f };
+		float panSpeed = 100.0f * fElapsedTime; // Adjust pan speed as necessary
+		if (GetKey(olc::Key::LEFT).bHeld) panDelta.x += panSpeed;
+		if (GetKey(olc::Key::RIGHT).bHeld) panDelta.x -= panSpeed;
+		if (GetKey(olc::Key::UP).bHeld) panDelta.y += panSpeed;
+		if (GetKey(olc::Key::DOWN).bHeld) panDelta.y -= panSpeed;
+
+		tv_.MoveWorldOffset(panDelta);
+
+		olc::vf2d vMouse = tv_.ScreenToWorld(GetMousePos());
+
+		// Sync the journal, and save the scene in the background when due
+		std::string journalStatus;
+		if (journal_.update(fElapsedTime, journalStatus)) {
+			SetFileStatus(journalStatus);
+		}
+
+		// Page the world in around the view
+		if (world_.update(tv_.GetWorldTL(), tv_.GetWorldBR(), WORLD_MEMORY_BUDGET, fElapsedTime,
+			[&](const TessSceneFile::TileRecord& tile) { return CreateWorldShape(tile); })) {
+			pClosestUnplacedShape_ = nullptr; // It may have been paged out
+		}
+
+		// Handle tool-specific updates, before drawing the shapes
+		switch (currentTool_)
+		{
+		case ToolType::PlaceShape:
+				ret &= ToolPlaceShapeUpdatePre(fElapsedTime, vMouse);
+				break;
+		case ToolType::FillShape:
+				ret &= ToolFillUpdatePre(fElapsedTime, vMouse);
+				break;
+		case ToolType::RegionFill:
+				ret &= ToolRegionFillUpdatePre(fElapsedTime, vMouse);
+				break;
+		case ToolType::Select:
+				ret &= ToolSelectUpdatePre(fElapsedTime, vMouse);
+				break;
+		case ToolType::Erase:
+				ret &= ToolEraseUpdatePre(fElapsedTime, vMouse);
+				break;
+		case ToolType::Periodic:
+		case ToolType::Wallpaper:
+		case ToolType::Uniform:
+		case ToolType::Substitution:
+		case ToolType::Coverage:
+		case ToolType::HideTool:
+				break; // Nothing to do before drawing
+		}
+
+
+		// ***************************
+		// Draw the shapes
+		// ***************************
+
+		closestDist_ = { 100000.0f, 100000.0f }; // Initialize with a large value
+
+		// Cached sprites are only valid for the zoom level they were rasterized at
+		atlas_.setZoom(tv_.GetWorldScale().x);
+
+		// Generate the periodic tiling for the visible cells and draw it under the placed shapes
+		periodic_.update(tv_.GetWorldTL(), tv_.GetWorldBR());
+		periodic_.forEachShape([&](TessShape& shape) { DrawPlacedShape(shape); });
+
+		// Draw the wallpaper group images in the visible lattice cells
+		wallpaper_.forEachVisibleImage(tv_.GetWorldTL(), tv_.GetWorldBR(),
+			[&](size_t imageIndex, const TessWallpaper::Image& image, const olc::vf2d& offset) {
+				if (!atlas_.draw(TessWallpaper::GEOMETRY_ID_BASE + (int)imageIndex, 0, image.points, image.centroid,
+					image.centroid + offset, image.color, olc::WHITE, tv_)) {
+					DrawPolygon(image.points, offset, image.color, olc::WHITE);
+				}
+			});
+
+		// Expand the substitution tiling over the visible part of the world and draw it.
+		// Tiles are SIDE_LENGTH across, unless that would make them too small to see.
+		substitutionTriangles_ = 0;
+		substitutionDepth_ = substitution_.forEachVisibleTriangle(olc::vd2d(tv_.GetWorldTL()), olc::vd2d(tv_.GetWorldBR()),
+			SIDE_LENGTH, MIN_TILE_PIXELS / tv_.GetWorldScale().x,
+			[&](const TessSubstitutionTiling::Triangle& t) {
+				DrawSubstitutionTriangle(t);
+				++substitutionTriangles_;
+			});
+
+		// Draw the stamps whose bounds are in view, moving each shape of their
+		// patch into place as it is drawn. Also find the closest shape to the mouse.
+		closestStamp_ = SIZE_MAX;
+		stamps_.forEachVisible(tv_.GetWorldTL(), tv_.GetWorldBR(), [&](size_t index, const TessInstances::Instance& instance) {
+			TessTransform motion = instance.motion();
+			const auto& upPatchShapes = instance.pPatch->upShapes;
+			for (size_t k = 0; k < upPatchShapes.size(); ++k) {
+				olc::vf2d dist = vMouse - DrawMovedShape(*upPatchShapes[k], motion, instance.rotation, olc::WHITE);
+				if (dist.mag() < closestDist_.mag()) {
+					closestDist_ = dist;
+					closestStamp_ = index;
+					closestStampShape_ = k;
+				}
+			}
+		});
+
+		// Draw the world and all placed shapes, carrying on the search for the closest shape
+		auto drawShape = [&](TessShape& shape, size_t index) {
+			DrawPlacedShape(shape);
+			olc::vf2d dist = vMouse - shape.getCentroid();
+			if (dist.mag() < closestDist_.mag()) {
+				closestDist_ = dist;
+				closestStamp_ = SIZE_MAX;
+				if (index == TessSlotMap<TessShape>::NPOS) {
+					closestShape_ = {};
+					pClosestUnplacedShape_ = &shape;
+				}
+				else {
+					closestShape_ = upShapes_.handleAt(index);
+					pClosestUnplacedShape_ = nullptr;
+				}
+			}
+		};
+		world_.forEachShape(tv_.GetWorldTL(), tv_.GetWorldBR(), [&](TessShape& shape) { drawShape(shape, TessSlotMap<TessShape>::NPOS); });
+		size_t nextSelected = 0;
+		for (size_t i = 0; i < upShapes_.size(); ++i) {
+			if (nextSelected < selection_.size() && selection_[nextSelected] == i) {
+				DrawSelectedShape(*upShapes_[i]);
+				++nextSelected;
+			}
+			else {
+				drawShape(*upShapes_[i], i);
+			}
+		}
+
+		// Only a stamped shape closest to the mouse is expanded, to be snapped to
+		if (closestStamp_ != SIZE_MAX) {
+			upClosestStampShape_ = TessInstances::expandShape(stamps_[closestStamp_], closestStampShape_);
+			closestShape_ = {};
+			pClosestUnplacedShape_ = upClosestStampShape_.get();
+		}
+
+		// Handle tool-specific updates, after drawing the shapes
+		switch (currentTool_)
+		{
+		case ToolType::PlaceShape:
+				ret &= ToolPlaceShapeUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::FillShape:
+				ret &= ToolFillUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::RegionFill:
+				ret &= ToolRegionFillUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Periodic:
+				ret &= ToolPeriodicUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Wallpaper:
+				ret &= ToolWallpaperUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Uniform:
+				ret &= ToolUniformUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Substitution:
+				ret &= ToolSubstitutionUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Coverage:
+				ret &= ToolCoverageUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Select:
+				ret &= ToolSelectUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::Erase:
+				ret &= ToolEraseUpdatePost(fElapsedTime, vMouse);
+				break;
+		case ToolType::HideTool:
+				break;
+		}
+
+		if (fileStatusTime_ > 0.0f) {
+			fileStatusTime_ -= fElapsedTime;
+			DrawString({ 4, ScreenHeight() - 22 }, fileStatus_, olc::WHITE);
+		}
+
+
+		return ret;
+
+	}
+
+	// The closest shape to the mouse when the shapes were last drawn, or
+	// nullptr if there is none or it has since been removed
+	TessShape* ClosestShape() const
+	{
+		if (TessShape* pShape = upShapes_.get(closestShape_)) {
+			return pShape;
+		}
+		return pClosestUnplacedShape_;
+	}
+
+	// Draw a placed shape, blitting it from the sprite atlas when possible
+	void DrawPlacedShape(TessShape& shape)
+	{
+		if (!atlas_.draw(shape, tv_, olc::WHITE)) {
+			shape.draw(olc::WHITE);
+		}
+	}
+
+	// Draw a selected shape outlined in yellow, where the move or turn not yet
+	// applied puts it
+	void DrawSelectedShape(TessShape& shape)
+	{
+		TessTransform motion = TessTransform::translation(selectionOffset_) * TessTransform::rotation(selectionTurn_, selectionPivot_);
+		DrawMovedShape(shape, motion, selectionTurn_, olc::YELLOW);
+	}
+
+	// Draw a shape where motion, which turns it by degrees, puts it, leaving
+	// the shape alone. Returns where its centroid was drawn.
+	olc::vf2d DrawMovedShape(TessShape& shape, const TessTransform& motion, float degrees, olc::Pixel outline)
+	{
+		olc::vf2d centroid = shape.getCentroid();
+		olc::vf2d moved = motion.apply(centroid);
+		if (degrees == 0.0f) {
+			// Only moved, so the sprite of the shape as it is can be drawn further along
+			if (shape.getPrototype() < 0 || !atlas_.draw(shape.getPrototype(), TessSpriteAtlas::rotationKey(shape.getRotation()),
+				shape.getDrawPoints(), centroid, moved, shape.getColor(), outline, tv_)) {
+				DrawPolygon(shape.getDrawPoints(), moved - centroid, shape.getColor(), outline);
+			}
+			return moved;
+		}
+		selectionPoints_.clear();
+		for (const auto& point : shape.getDrawPoints()) {
+			selectionPoints_.push_back(motion.apply(point));
+		}
+		if (shape.getPrototype() < 0 || !atlas_.draw(shape.getPrototype(), TessSpriteAtlas::rotationKey(shape.getRotation() + degrees),
+			selectionPoints_, moved, moved, shape.getColor(), outline, tv_)) {
+			DrawPolygon(selectionPoints_, { 0.0f, 0.0f }, shape.getColor(), outline);
+		}
+		return moved;
+	}
+
+	// Draw a polygon translated by offset, filled if fill is not olc::BLANK
+	void DrawPolygon(const std::vector<olc::vf2d>& points, const olc::vf2d& offset, olc::Pixel fill, olc::Pixel outline)
+	{
+		if (fill != olc::BLANK) {
+			for (size_t i = 0; i < points.size() - 1; ++i) {
+				tv_.FillTriangle(points[0] + offset, points[i] + offset, points[i + 1] + offset, fill);
+			}
+		}
+		for (size_t i = 0; i < points.size(); ++i) {
+			tv_.DrawLine(points[i] + offset, points[(i + 1) % points.size()] + offset, outline);
+		}
+	}
+
+	// True if the current shape, and any symmetry images, would overlap a placed
+	// shape when placed (after snapping). Runs every frame, so it doesn't allocate.
+	bool CurrentShapeOverlaps()
+	{
+		if (!upCurrentShape_) {
+			return false;
+		}
+
+		olc::vf2d translation = { 0.0f, 0.0f };
+		if (snapPair_.distance < SNAP_DIST_MAX) {
+			translation = snapPair_.bestClosestPoint - snapPair_.bestCurrentPoint;
+		}
+
+		const std::vector<olc::vf2d>& points = upCurrentShape_->getDrawPoints();
+		size_t images = std::max<size_t>(1, symmetryOps_.size());
+		for (size_t k = 0; k < images; ++k) {
+			overlapPoints_.clear();
+			for (const auto& point : points) {
+				overlapPoints_.push_back(k == 0 ? point + translation : symmetryOps_[k].apply(point + translation));
+			}
+			if (shapeIndex_.overlaps(overlapPoints_)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Rebuild the symmetry group after the mode or centre changed
+	void UpdateSymmetryOps()
+	{
+		const SymmetryMode& mode = SYMMETRY_MODES[symmetryMode_];
+		symmetryOps_ = TessTransform::pointGroup(mode.order, mode.dihedral, symmetryCentre_);
+	}
+
+	// The images of shape under the symmetry group, the shape itself first.
+	// Images that coincide (a shape on a mirror or at the centre) are only made once.
+	std::vector<std::unique_ptr<TessShape>> CreateSymmetryImages(TessShape& shape)
+	{
+		std::vector<std::unique_ptr<TessShape>> upImages;
+		const std::vector<olc::vf2d>& points = shape.getDrawPoints();
+		for (const auto& op : symmetryOps_) {
+			std::vector<olc::vf2d> imagePoints;
+			for (const auto& point : points) {
+				imagePoints.push_back(op.apply(point));
+			}
+
+			bool duplicate = false;
+			for (const auto& upImage : upImages) {
+				duplicate |= SamePolygon(upImage->getDrawPoints(), imagePoints);
+			}
+			if (duplicate) {
+				continue;
+			}
+
+			// Recreate the image from the prototype, so it can be drawn from the atlas.
+			// A rotation turns the shape by the same angle; a mirror image of a
+			// symmetric prototype is the prototype at some other 15 degree rotation.
+			olc::vf2d centroid = op.apply(shape.getCentroid());
+			std::unique_ptr<TessShape> upImage;
+			if (!op.isReflection()) {
+				float angle = std::round(std::atan2(op.m10, op.m00) * 180.0f / (float)M_PI / 15.0f) * 15.0f;
+				upImage = CreateNewShape(currentShapeType_, centroid);
+				upImage->rotate(shape.getRotation() + angle);
+			}
+			else {
+				for (int k = 0; k < 24 && !upImage; ++k) {
+					auto upCandidate = CreateNewShape(currentShapeType_, centroid);
+					upCandidate->rotate(k * 15.0f);
+					if (SamePolygon(upCandidate->getDrawPoints(), imagePoints)) {
+						upImage = std::move(upCandidate);
+					}
+				}
+				if (!upImage) {
+					upImage = std::make_unique<TessShape>(&tv_, imagePoints);
+				}
+			}
+			upImage->setColor(shape.getColor());
+			upImages.push_back(std::move(upImage));
+		}
+		return upImages;
+	}
+
+	// True if the two polygons have the same vertices, in any order
+	static bool SamePolygon(const std::vector<olc::vf2d>& a, const std::vector<olc::vf2d>& b)
+	{
+		if (a.size() != b.size()) {
+			return false;
+		}
+		for (const auto& p : a) {
+			bool found = false;
+			for (const auto& q : b) {
+				found |= (p - q).mag() < 0.05f;
+			}
+			if (!found) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Add a shape to the placed shapes, as an edit that can be undone
+	void AddShape(std::unique_ptr<TessShape> upShape)
+	{
+		undo_.recordInsert(upShapes_.size(), 1);
+		journal_.appendAdd(*upShape);
+		shapeIndex_.insert(*upShape);
+		topology_.addShape(*upShape);
+		upShapes_.push_back(std::move(upShape));
+	}
+
+	// Add a batch of shapes to the placed shapes, as one edit that can be
+	// undone
+	void AddShapes(std::vector<std::unique_ptr<TessShape>>& upBatch)
+	{
+		undo_.recordInsert(upShapes_.size(), upBatch.size());
+		InsertShapes(upBatch);
+	}
+
+	// Add a batch of shapes to the placed shapes, the journal, and the
+	// spatial index and topology (bulk loaded), leaving the undo history alone
+	void InsertShapes(std::vector<std::unique_ptr<TessShape>>& upBatch)
+	{
+		journal_.appendAdd(upBatch);
+		shapeIndex_.insert(upBatch);
+		if (!topologyStale_) {
+			topology_.addShapes(upBatch);
+		}
+		upShapes_.reserve(upShapes_.size() + upBatch.size());
+		for (auto& upShape : upBatch) {
+			upShapes_.push_back(std::move(upShape));
+		}
+		upBatch.clear();
+	}
+
+	// Add tiles to the placed shapes in one batch, as one edit that can be
+	// undone, for scripts and generators. Each tile is a copy of one
+	// prototype per shape type, made in parallel. Like a load, it leaves
+	// the topology to be built when it is first needed.
+	void AddTiles(const std::vector<TileSpec>& tiles)
+	{
+		std::unique_ptr<TessShape> upPrototypes[(int)ShapeType::Dodecagon + 1];
+		for (const TileSpec& tile : tiles) {
+			if (!upPrototypes[(int)tile.type]) {
+				upPrototypes[(int)tile.type] = CreateNewShape(tile.type, { 0.0f, 0.0f });
+			}
+		}
+		std::vector<std::unique_ptr<TessShape>> upBatch(tiles.size());
+		tessParallelFor(tiles.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const TileSpec& tile = tiles[i];
+				upBatch[i] = CreatePlacedShape(*upPrototypes[(int)tile.type], tile.rotation, tile.position, tile.color);
+			}
+		});
+		topologyStale_ = true;
+		AddShapes(upBatch);
+	}
+
+	// Take the placed shapes from index begin onward out of the placed
+	// shapes, the journal, the spatial index and the topology, leaving the
+	// undo history alone
+	std::vector<std::unique_ptr<TessShape>> TakeShapesFrom(size_t begin)
+	{
+		journal_.appendRemoveFrom(begin);
+		begin = std::min(begin, upShapes_.size());
+		if (begin == 0) {
+			// Everything goes, so start the index and topology afresh
+			shapeIndex_.clear();
+			topology_.clear();
+		}
+		else {
+			for (size_t i = begin; i < upShapes_.size(); ++i) {
+				shapeIndex_.remove(upShapes_[i].get());
+				topology_.removeShape(upShapes_[i].get());
+			}
+		}
+		while (!selection_.empty() && selection_.back() >= begin) {
+			selection_.pop_back();
+		}
+		return upShapes_.takeFrom(begin);
+	}
+
+	// Take the placed shape at index out of the placed shapes, the journal,
+	// the spatial index and the topology, moving the last shape into its
+	// place. Leaves the undo history alone.
+	std::unique_ptr<TessShape> TakeShapeAt(size_t index)
+	{
+		size_t last = upShapes_.size() - 1;
+		if (index != last) {
+			journal_.appendSwap(index, last);
+		}
+		journal_.appendRemoveFrom(last);
+		shapeIndex_.remove(upShapes_[index].get());
+		topology_.removeShape(upShapes_[index].get());
+		return upShapes_.eraseAt(index);
+	}
+
+	// Put a shape taken with TakeShapeAt() back at index, moving the shape
+	// there to the end again. Leaves the undo history alone.
+	void PutShapeAt(size_t index, std::unique_ptr<TessShape> upShape)
+	{
+		journal_.appendAdd(*upShape);
+		shapeIndex_.insert(*upShape);
+		topology_.addShape(*upShape);
+		upShapes_.push_back(std::move(upShape));
+		size_t last = upShapes_.size() - 1;
+		if (index != last) {
+			journal_.appendSwap(index, last);
+			upShapes_.swap(index, last);
+		}
+	}
+
+	// Move and turn the placed shapes at indices, as one edit that can be
+	// undone. Each shape turns by degrees about pivot, then moves by
+	// translation.
+	void TransformShapes(const std::vector<size_t>& indices, const olc::vf2d& pivot, float degrees, const olc::vf2d& translation)
+	{
+		TessTransform motion = TessTransform::translation(translation) * TessTransform::rotation(degrees, pivot);
+		std::vector<TessUndoStack::PoseChange> poses;
+		poses.reserve(indices.size());
+		for (size_t index : indices) {
+			TessShape& shape = *upShapes_[index];
+			olc::vf2d centroid = shape.getCentroid();
+			poses.push_back({ index, centroid, shape.getRotation(), motion.apply(centroid), shape.getRotation() + degrees });
+		}
+		SetShapePoses(poses, false);
+		undo_.recordPoses(std::move(poses));
+	}
+
+	// Put the shapes of poses where they were before (or after) the change,
+	// re-indexing them, leaving the undo history alone
+	void SetShapePoses(const std::vector<TessUndoStack::PoseChange>& poses, bool before)
+	{
+		std::vector<size_t> indices;
+		indices.reserve(poses.size());
+		for (const auto& pose : poses) {
+			TessShape& shape = *upShapes_[pose.index];
+			shapeIndex_.remove(&shape);
+			topology_.removeShape(&shape);
+			shape.moveTo(before ? pose.fromCentroid : pose.toCentroid);
+			shape.rotate((before ? pose.fromRotation : pose.toRotation) - shape.getRotation());
+			indices.push_back(pose.index);
+		}
+		journal_.appendReplace(upShapes_.values(), indices);
+		// Added back once all have moved, so shapes that moved together
+		// join up with each other again
+		for (const auto& pose : poses) {
+			TessShape& shape = *upShapes_[pose.index];
+			shapeIndex_.insert(shape);
+			topology_.addShape(shape);
+		}
+	}
+
+	// Set the fill colors of the shapes of runs to what they were before (or
+	// after) the change, leaving the undo history alone
+	void SetShapeColors(const std::vector<TessUndoStack::ColorRun>& runs, bool before)
+	{
+		for (const auto& run : runs) {
+			const olc::Pixel& color = before ? run.from : run.to;
+			for (size_t i = run.first; i < run.first + run.count; ++i) {
+				upShapes_[i]->setColor(color);
+			}
+		}
+		journal_.appendSetColors(runs.size(), [&](size_t i, uint64_t& index, olc::Pixel& color, uint64_t& count) {
+			index = runs[i].first;
+			color = before ? runs[i].from : runs[i].to;
+			count = runs[i].count;
+		});
+	}
+
+	// Fill the shapes of the same color as shape that it reaches through
+	// shared sides, shape included, as one edit that can be undone. Shapes
+	// that aren't placed have no neighbours, and are filled alone.
+	void FillRegion(TessShape& shape, const olc::Pixel& color)
+	{
+		UpdateTopology();
+		int32_t start = topology_.findFace(&shape);
+		if (start == TessTopology::NONE) {
+			SetShapeColor(shape, color);
+			return;
+		}
+
+		olc::Pixel from = shape.getColor();
+		if (from == color) {
+			return;
+		}
+		const std::vector<int32_t>& faces = topology_.floodFaces(start, [&](int32_t f) {
+			return topology_.face(f).pShape->getColor() == from;
+		});
+
+		// Look up the region's places in upShapes_ and sort them, so the
+		// fill journals and undoes as runs
+		std::vector<size_t> indices(faces.size());
+		tessParallelFor(faces.size(), 16384, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				indices[i] = upShapes_.indexOf(upShapes_.find(topology_.face(faces[i]).pShape));
+			}
+		});
+		std::sort(indices.begin(), indices.end());
+		RecolorShapes(indices, color);
+	}
+
+	// Fill the placed shapes from the palette, starting at the current fill
+	// color, so that no two sharing a side have the same color, as one edit
+	// that can be undone. With lattice, a periodic patch is colored in the
+	// repeating pattern taking the fewest colors, such as three colors of
+	// hexagons, if one fits the palette.
+	void AutoColor(bool lattice)
+	{
+		auto start = std::chrono::steady_clock::now();
+		TessColoring::Graph graph = BuildShapeGraph();
+		std::vector<uint8_t> classes;
+		int used = 0;
+		if (lattice) {
+			std::vector<TessColoring::LatticePlace> places;
+			if (FindLatticePlaces(places)) {
+				used = TessColoring::colorLattice(graph, places, (int)colors_.size(), classes);
+			}
+		}
+		// A pattern that takes more colors than the palette has is no use
+		bool patterned = used > 0 && used <= (int)colors_.size();
+		if (!patterned) {
+			used = TessColoring::color(graph, classes);
+		}
+
+		std::vector<TessUndoStack::ColorRun> runs;
+		for (size_t i = 0; i < upShapes_.size(); ++i) {
+			const olc::Pixel& color = colors_[(currentColorIndex_ + classes[i]) % colors_.size()];
+			TessUndoStack::addColor(runs, i, upShapes_[i]->getColor(), color);
+		}
+		SetShapeColors(runs, false);
+		undo_.recordColors(std::move(runs));
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		fillStatus_ = std::to_string(used) + " colors" + (lattice && !patterned ? ", no pattern fits" : "") +
+			(used > (int)colors_.size() ? ", more than the palette has" : "") + " (" + std::to_string(elapsed.count()) + " ms)";
+	}
+
+	// The graph of the placed shapes, by index, linking shapes that share a
+	// side in the topology
+	TessColoring::Graph BuildShapeGraph()
+	{
+		UpdateTopology();
+		size_t count = upShapes_.size();
+		std::vector<int32_t> faceOf(count);
+		std::vector<uint32_t> indexOf(topology_.faceSlotCount(), UINT32_MAX);
+		tessParallelFor(count, 16384, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				faceOf[i] = topology_.findFace(upShapes_[i].get());
+				if (faceOf[i] != TessTopology::NONE) {
+					indexOf[faceOf[i]] = (uint32_t)i;
+				}
+			}
+		});
+
+		TessColoring::Graph graph;
+		graph.offsets.assign(count + 1, 0);
+		tessParallelFor(count, 16384, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				if (faceOf[i] != TessTopology::NONE) {
+					topology_.forEachNeighbour(faceOf[i], [&](int32_t, int32_t) { graph.offsets[i + 1] += 1; });
+				}
+			}
+		});
+		for (size_t i = 0; i < count; ++i) {
+			graph.offsets[i + 1] += graph.offsets[i];
+		}
+		graph.neighbours.resize(graph.offsets[count]);
+		tessParallelFor(count, 16384, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				uint32_t next = graph.offsets[i];
+				if (faceOf[i] != TessTopology::NONE) {
+					topology_.forEachNeighbour(faceOf[i], [&](int32_t f, int32_t) { graph.neighbours[next++] = indexOf[f]; });
+				}
+			}
+		});
+		return graph;
+	}
+
+	// Where each placed shape is in the periodic repeat of the placed
+	// shapes, found whatever their colors. False if they don't repeat.
+	bool FindLatticePlaces(std::vector<TessColoring::LatticePlace>& places)
+	{
+		TessSceneFile::Tables tables;
+		std::vector<TessSceneFile::TileRecord> tiles(upShapes_.size());
+		std::string error;
+		for (size_t i = 0; i < upShapes_.size(); ++i) {
+			if (!tables.encode(*upShapes_[i], tiles[i], error)) {
+				return false;
+			}
+			tiles[i].color = 0; // Tiles are of a kind by their shape alone
+		}
+
+		TessPeriodicity::Repeat repeat;
+		if (!TessPeriodicity::find(tiles.data(), tiles.size(), repeat)) {
+			return false;
+		}
+		places.assign(tiles.size(), {});
+		uint64_t repeated = repeat.repeatedCount();
+		for (size_t t = 0; t < tiles.size(); ++t) {
+			uint64_t place = repeat.order[t];
+			if (place < repeated) {
+				uint64_t copy = place / repeat.cell.size();
+				places[t] = { (uint32_t)(place % repeat.cell.size()), (int64_t)(copy % repeat.countA), (int64_t)(copy / repeat.countA) };
+			}
+		}
+
+		// Tiles outside the block of copies, such as around the edge of a
+		// round patch, are on the lattice all the same: look for a cell tile
+		// of their shape that whole copies carry onto them. Its rotation
+		// may differ by a symmetry of the shape. Patterns are only tried on
+		// small cells, so larger ones aren't searched.
+		double det = (double)repeat.ax * repeat.by - (double)repeat.ay * repeat.bx;
+		if (repeat.cell.size() > 64 || det == 0.0) {
+			return true;
+		}
+		const double TOLERANCE = (double)TessPeriodicity::TOLERANCE * TessPeriodicity::FINE;
+		for (uint32_t t : repeat.residual) {
+			for (size_t k = 0; k < repeat.cell.size(); ++k) {
+				const TessPeriodicity::CellTile& cellTile = repeat.cell[k];
+				const TessSceneFile::TileRecord& kind = tiles[cellTile.tile];
+				if (tiles[t].prototype != kind.prototype) {
+					continue;
+				}
+				double dx = (double)tiles[t].x * TessPeriodicity::FINE - cellTile.x;
+				double dy = (double)tiles[t].y * TessPeriodicity::FINE - cellTile.y;
+				double i = std::round((dx * repeat.by - dy * repeat.bx) / det);
+				double j = std::round((dy * repeat.ax - dx * repeat.ay) / det);
+				if (std::abs(dx - i * repeat.ax - j * repeat.bx) <= TOLERANCE && std::abs(dy - i * repeat.ay - j * repeat.by) <= TOLERANCE) {
+					places[t] = { (uint32_t)k, (int64_t)i, (int64_t)j };
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Fill the placed shapes at indices with color, as one edit that can be
+	// undone
+	void RecolorShapes(const std::vector<size_t>& indices, const olc::Pixel& color)
+	{
+		std::vector<TessUndoStack::ColorRun> runs;
+		for (size_t index : indices) {
+			TessUndoStack::addColor(runs, index, upShapes_[index]->getColor(), color);
+		}
+		SetShapeColors(runs, false);
+		undo_.recordColors(std::move(runs));
+	}
+
+	// Get ready to undo or redo a step, which may reorder the placed shapes.
+	// Stamps are baked first, so undo takes them back as the latest edit.
+	// Returns the handles of the selection, to find it again after.
+	std::vector<TessSlotMap<TessShape>::Handle> BeginUndoRedo()
+	{
+		ApplySelectionMove();
+		BakeStamps();
+		eraseStroke_ = false; // The stroke's step may be undone
+		std::vector<TessSlotMap<TessShape>::Handle> selected;
+		for (size_t i : selection_) {
+			selected.push_back(upShapes_.handleAt(i));
+		}
+		return selected;
+	}
+
+	// Find the selection again, and its pivot, after an undo or redo
+	void EndUndoRedo(const std::vector<TessSlotMap<TessShape>::Handle>& selected)
+	{
+		selection_.clear();
+		for (const auto& handle : selected) {
+			size_t index = upShapes_.indexOf(handle);
+			if (index != TessSlotMap<TessShape>::NPOS) {
+				selection_.push_back(index);
+			}
+		}
+		std::sort(selection_.begin(), selection_.end());
+		UpdateSelectionPivot();
+	}
+
+	// Undo the last edit to the placed shapes
+	void Undo()
+	{
+		std::vector<TessSlotMap<TessShape>::Handle> selected = BeginUndoRedo();
+		if (!undo_.canUndo()) {
+			return;
+		}
+		TessUndoStack::Step step = undo_.takeUndo();
+		switch (step.kind)
+		{
+			case TessUndoStack::Kind::Insert: step.upShapes = TakeShapesFrom(step.begin); break;
+			case TessUndoStack::Kind::Recolor: SetShapeColors(step.colors, true); break;
+			case TessUndoStack::Kind::Pose: SetShapePoses(step.poses, true); break;
+			case TessUndoStack::Kind::Erase:
+				for (size_t i = step.indices.size(); i > 0; --i) {
+					PutShapeAt(step.indices[i - 1], std::move(step.upShapes[i - 1]));
+				}
+				step.upShapes.clear();
+				break;
+		}
+		undo_.pushRedo(std::move(step));
+		EndUndoRedo(selected);
+	}
+
+	// Redo the last edit undone
+	void Redo()
+	{
+		std::vector<TessSlotMap<TessShape>::Handle> selected = BeginUndoRedo();
+		if (!undo_.canRedo()) {
+			return;
+		}
+		TessUndoStack::Step step = undo_.takeRedo();
+		switch (step.kind)
+		{
+			case TessUndoStack::Kind::Insert: InsertShapes(step.upShapes); break;
+			case TessUndoStack::Kind::Recolor: SetShapeColors(step.colors, false); break;
+			case TessUndoStack::Kind::Pose: SetShapePoses(step.poses, false); break;
+			case TessUndoStack::Kind::Erase:
+				for (size_t index : step.indices) {
+					step.upShapes.push_back(TakeShapeAt(index));
+				}
+				break;
+		}
+		undo_.pushUndo(std::move(step));
+		EndUndoRedo(selected);
+	}
+
+	// Save the placed shapes to a .tess file. Saving the journaled scene
+	// starts its journal afresh.
+	bool SaveScene(const std::string& path)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::string error;
+		uint64_t checksum = 0;
+		bool saved = TessSceneFile::save(path, upShapes_.values(), error, &checksum);
+		if (saved && path == journal_.scenePath()) {
+			saved = journal_.reset(checksum, error);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		SetFileStatus(saved ? "Saved " + std::to_string(upShapes_.size()) + " shapes in " + std::to_string((int)ms) + " ms" : error);
+		return saved;
+	}
+
+	// Replace the placed shapes with the ones in a .tess file and the edits
+	// journaled since it was saved. Each prototype is built once, and the
+	// shapes are copied from it in parallel. With journalEdits, or when this
+	// file's journal was already open, later edits are journaled for it.
+	bool LoadScene(const std::string& path, bool journalEdits = false)
+	{
+		auto start = std::chrono::steady_clock::now();
+		journalEdits |= journal_.isOpen() && journal_.scenePath() == path;
+		journal_.close();
+		TessJournal::recover(path);
+		std::string error;
+		if (!journalEdits && !std::filesystem::exists(path)) {
+			SetFileStatus("Could not open " + path);
+			return false;
+		}
+		TessSceneFile::Tables tables;
+		std::vector<TessSceneFile::TileRecord> tiles;
+		uint64_t base = 0;
+		uint64_t journalLength = 0;
+		if (!TessJournal::load(path, UINT64_MAX, tables, tiles, base, journalLength, error)) {
+			SetFileStatus(error);
+			return false;
+		}
+
+		std::vector<std::unique_ptr<TessShape>> upPrototypes;
+		for (const auto& prototype : tables.prototypes) {
+			upPrototypes.push_back(CreatePrototypeShape(prototype, tables.vertices.data()));
+		}
+
+		std::vector<std::unique_ptr<TessShape>> upBatch(tiles.size());
+		tessParallelFor(upBatch.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				upBatch[i] = CreateTileShape(*upPrototypes[tiles[i].prototype], tiles[i], tables.palette.data());
+			}
+		});
+
+		// Only fills, coloring and SVG export use the topology, so it is built
+		// when one of them first needs it rather than holding up the load
+		TakeShapesFrom(0);
+		topologyStale_ = true;
+		InsertShapes(upBatch);
+		undo_.clear();
+		ClearStamps();
+
+		if (journalEdits && !journal_.open(path, base, journalLength, error)) {
+			SetFileStatus(error);
+			return false;
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		SetFileStatus("Loaded " + std::to_string(upShapes_.size()) + " shapes in " + std::to_string((int)ms) + " ms");
+		return true;
+	}
+
+	// Build the topology of the placed shapes afresh if a load left it for
+	// later. Edits made since then only kept a partial mesh of their shapes.
+	void UpdateTopology()
+	{
+		if (topologyStale_) {
+			topology_.clear();
+			topology_.addShapes(upShapes_.values());
+			topologyStale_ = false;
+		}
+	}
+
+	// Export the placed shapes to an SVG file
+	bool ExportSvg(const std::string& path)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::string error;
+		UpdateTopology();
+		bool exported = TessSvgExport::write(path, upShapes_.values(), topology_, error);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		SetFileStatus(exported ? "Exported " + std::to_string(upShapes_.size()) + " shapes in " + std::to_string((int)ms) + " ms" : error);
+		return exported;
+	}
+
+	// Render the placed shapes to a PNG image width pixels across
+	bool ExportPng(const std::string& path, uint32_t width)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::string error;
+		bool exported = TessPngExport::write(path, upShapes_.values(), shapeIndex_, width, error);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		SetFileStatus(exported ? "Rendered " + std::to_string(upShapes_.size()) + " shapes in " + std::to_string((int)ms) + " ms" : error);
+		return exported;
+	}
+
+	// Convert a .tess file to SVG without opening a window, for batch exports
+	// from the command line
+	bool ExportSvgHeadless(const std::string& scenePath, const std::string& svgPath)
+	{
+		bool exported = LoadScene(scenePath) && ExportSvg(svgPath);
+		std::cout << fileStatus_ << std::endl;
+		return exported;
+	}
+
+	// Render a .tess file to PNG without opening a window
+	bool ExportPngHeadless(const std::string& scenePath, const std::string& pngPath, uint32_t width)
+	{
+		bool exported = LoadScene(scenePath) && ExportPng(pngPath, width);
+		std::cout << fileStatus_ << std::endl;
+		return exported;
+	}
+
+	// Build a scene from a list of tiles and save it without opening a
+	// window, for scripts and generators. Each line of the list is a shape
+	// name, a rotation in degrees, the x and y of the shape's centre and an
+	// optional rrggbb fill color. Lines starting with '#' are skipped.
+	bool BuildSceneHeadless(const std::string& tilesPath, const std::string& scenePath)
+	{
+		std::ifstream in(tilesPath);
+		if (!in) {
+			std::cout << "Could not open " << tilesPath << std::endl;
+			return false;
+		}
+		std::vector<TileSpec> tiles;
+		std::string line;
+		for (size_t lineNumber = 1; std::getline(in, line); ++lineNumber) {
+			std::istringstream fields(line);
+			std::string name;
+			if (!(fields >> name) || name[0] == '#') {
+				continue;
+			}
+			TileSpec tile;
+			auto type = std::find(std::begin(SHAPE_NAMES), std::end(SHAPE_NAMES), name);
+			if (type == std::end(SHAPE_NAMES) || !(fields >> tile.rotation >> tile.position.x >> tile.position.y)) {
+				std::cout << tilesPath << ":" << lineNumber << ": expected a shape name, rotation, x and y" << std::endl;
+				return false;
+			}
+			tile.type = (ShapeType)(type - std::begin(SHAPE_NAMES));
+			std::string color;
+			if (fields >> color) {
+				char* pEnd = nullptr;
+				uint32_t rgb = (uint32_t)std::strtoul(color.c_str(), &pEnd, 16);
+				if (color.size() != 6 || *pEnd != '\0') {
+					std::cout << tilesPath << ":" << lineNumber << ": expected an rrggbb color" << std::endl;
+					return false;
+				}
+				tile.color = olc::Pixel((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+			}
+			tiles.push_back(tile);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		AddTiles(tiles);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Built " << upShapes_.size() << " shapes in " << (int)ms << " ms" << std::endl;
+		bool saved = SaveScene(scenePath);
+		std::cout << fileStatus_ << std::endl;
+		return saved;
+	}
+
+	// Record the input of the session to path, and the scene it starts from
+	// next to it. Call before Start().
+	void RecordInput(const std::string& path)
+	{
+		inputLogPath_ = path;
+	}
+
+	// Run a recorded session again without a window, as fast as it goes.
+	// Prints the frame times, and writes each one to timesPath if given.
+	bool ReplayHeadless(const std::string& logPath, const std::string& timesPath)
+	{
+		std::string error;
+		if (!input_.openReplay(logPath, error)) {
+			std::cout << error << std::endl;
+			return false;
+		}
+		inputLogPath_ = logPath;
+
+		// Stand in for the window and graphics device, then start the engine
+		// the way Start() would, minus the window and the frame loop
+		olc::platform = std::make_unique<TessHeadlessPlatform>();
+		olc::renderer = std::make_unique<TessHeadlessRenderer>();
+		if (Construct(input_.screenSize().x, input_.screenSize().y, 1, 1) != olc::OK) {
+			std::cout << "Bad screen size in " << logPath << std::endl;
+			return false;
+		}
+		olc_UpdateWindowSize(input_.screenSize().x, input_.screenSize().y);
+		olc_PrepareEngine();
+		if (!OnUserCreate()) {
+			return false;
+		}
+		std::cout << fileStatus_ << std::endl;
+
+		std::vector<double> frameMs;
+		frameMs.reserve(input_.frameCount());
+		auto start = std::chrono::steady_clock::now();
+		while (input_.hasFrame()) {
+			auto frameStart = std::chrono::steady_clock::now();
+			bool running = OnUserUpdate(0.0f);
+			frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+			for (auto& layer : GetLayers()) {
+				layer.vecDecalInstance.clear();
+			}
+			if (!running) {
+				break;
+			}
+		}
+		double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		OnUserDestroy();
+
+		if (!timesPath.empty()) {
+			std::ofstream times(timesPath);
+			times << "frame,ms\n";
+			for (size_t i = 0; i < frameMs.size(); ++i) {
+				times << i << "," << frameMs[i] << "\n";
+			}
+			if (!times) {
+				std::cout << "Could not write " << timesPath << std::endl;
+				return false;
+			}
+		}
+		std::vector<double> sorted = frameMs;
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&](double p) { return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+		std::cout << "Replayed " << frameMs.size() << " frames in " << (int)totalMs << " ms, frame times median " << percentile(0.5) <<
+			" ms, 99th percentile " << percentile(0.99) << " ms, slowest " << percentile(1.0) << " ms" << std::endl;
+		return true;
+	}
+
+	// The shape a prototype record describes, centred on the origin. Built in
+	// shapes come from CreateNewShape(), so they keep their prototype id.
+	std::unique_ptr<TessShape> CreatePrototypeShape(const TessSceneFile::PrototypeRecord& prototype, const TessSceneFile::VertexRecord* pVertices)
+	{
+		if (prototype.shapeType >= (int32_t)ShapeType::Triangle && prototype.shapeType <= (int32_t)ShapeType::Dodecagon) {
+			return CreateNewShape((ShapeType)prototype.shapeType, { 0.0f, 0.0f });
+		}
+		std::vector<olc::vf2d> outline;
+		for (uint32_t k = 0; k < prototype.vertexCount; ++k) {
+			const TessSceneFile::VertexRecord& vertex = pVertices[prototype.firstVertex + k];
+			outline.push_back(TessSceneFile::position(vertex.x, vertex.y));
+		}
+		return std::make_unique<TessShape>(&tv_, outline);
+	}
+
+	// A copy of the prototype shape, turned, placed and colored as the tile
+	// record says. Only reads the prototype, so it may run on several threads.
+	std::unique_ptr<TessShape> CreateTileShape(const TessShape& prototype, const TessSceneFile::TileRecord& tile, const uint32_t* pPalette)
+	{
+		olc::Pixel color = tile.color != TessSceneFile::NO_COLOR ? olc::Pixel(pPalette[tile.color]) : olc::BLANK;
+		return CreatePlacedShape(prototype, TessSceneFile::rotation(tile), TessSceneFile::position(tile.x, tile.y), color);
+	}
+
+	// A copy of the prototype shape turned rotation degrees, centred on
+	// position and filled with color. Only reads the prototype, so it may run
+	// on several threads.
+	static std::unique_ptr<TessShape> CreatePlacedShape(const TessShape& prototype, float rotation, const olc::vf2d& position, const olc::Pixel& color)
+	{
+		auto upShape = std::make_unique<TessShape>(prototype);
+		upShape->rotate(rotation);
+		upShape->moveTo(position);
+		if (color != olc::BLANK) {
+			upShape->setColor(color);
+		}
+		upShape->getDrawPoints(); // Computed here rather than on first use
+		return upShape;
+	}
+
+	// A shape of the streamed world from its tile record
+	std::unique_ptr<TessShape> CreateWorldShape(const TessSceneFile::TileRecord& tile)
+	{
+		const TessSceneFile::Tables& tables = world_.tables();
+		while (upWorldPrototypes_.size() < tables.prototypes.size()) {
+			upWorldPrototypes_.push_back(CreatePrototypeShape(tables.prototypes[upWorldPrototypes_.size()], tables.vertices.data()));
+		}
+		return CreateTileShape(*upWorldPrototypes_[tile.prototype], tile, tables.palette.data());
+	}
+
+	// Open the streamed world, creating it if there is none yet, and move the
+	// placed shapes into it. Its chunks are written back as they change.
+	void MoveShapesToWorld()
+	{
+		std::string error;
+		if (!world_.isOpen()) {
+			upWorldPrototypes_.clear();
+			if (!std::filesystem::exists(WORLD_FILE) && !TessChunkStore::create(WORLD_FILE, WORLD_CHUNK_SIZE, error)) {
+				SetFileStatus(error);
+				return;
+			}
+			if (!world_.open(WORLD_FILE, error)) {
+				SetFileStatus(error);
+				return;
+			}
+		}
+
+		size_t count = upShapes_.size();
+		for (auto& upShape : TakeShapesFrom(0)) {
+			world_.addShape(std::move(upShape));
+		}
+		undo_.clear();
+		world_.flush();
+		SetFileStatus("Moved " + std::to_string(count) + " shapes to " + WORLD_FILE);
+	}
+
+	// Fill a shape, recording the change wherever the shape is kept. A
+	// placed shape's fill can be undone.
+	void SetShapeColor(TessShape& shape, const olc::Pixel& color)
+	{
+		olc::Pixel oldColor = shape.getColor();
+		shape.setColor(color);
+		world_.markDirty(shape);
+		size_t index = upShapes_.indexOf(upShapes_.find(&shape));
+		if (index != TessSlotMap<TessShape>::NPOS) {
+			journal_.appendSetColor(index, color);
+			undo_.recordColor(index, oldColor, color);
+		}
+	}
+
+	// All input is read through input_, so a replay can stand in for the
+	// engine's. These hide the engine's functions of the same names.
+	olc::HWButton GetKey(olc::Key key) const { return input_.key(key); }
+	olc::HWButton GetMouse(uint32_t button) const { return input_.mouse(button); }
+	olc::vi2d GetMousePos() const { return input_.mousePos(); }
+	int32_t GetMouseWheel() const { return input_.mouseWheel(); }
+
+	void SetFileStatus(const std::string& status)
+	{
+		fileStatus_ = status;
+		fileStatusTime_ = STATUS_SECONDS;
+	}
+
+	// Create a new shape of the given type centered at position
+	std::unique_ptr<TessShape> CreateNewShape(ShapeType type, const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
+		switch (type)
+		{
+			case ShapeType::Square:
+				return CreateNewSquare(position, sideLength);
+			case ShapeType::Hexagon:
+				return CreateNewHexagon(position, sideLength);
+			case ShapeType::IsoQuad:
+				return CreateNewIsoQuad(position, sideLength);
+			case ShapeType::Octagon:
+				// Flat sides on top and bottom, like the square
+				return CreateNewRegularPolygon(position, 8, 22.5f, sideLength, ShapeType::Octagon);
+			case ShapeType::Dodecagon:
+				return CreateNewRegularPolygon(position, 12, 15.0f, sideLength, ShapeType::Dodecagon);
+			default:
+				return CreateNewTriangle(position, sideLength);
+		}
+	}
+
+	std::unique_ptr<TessShape> CreateNewTriangle(const olc::vf2d& position, float sideLength=SIDE_LENGTH) {
+		// Height of the equilateral triangle
+		float height = (std::sqrt(3.0f) / 2.0f) * sideLength;
+
+		// Calculate vertices of the equilateral triangle
+		olc::vf2d p0 = position + olc::vf2d(0.0f, -2.0f / 3.0f * height); // Top vertex
+		olc::vf2d p1 = position + olc::vf2d(-sideLength / 2.0f, height / 3.0f); // Bottom left vertex
+		olc::vf2d p2 = position + olc::vf2d(sideLength / 2.0f, height / 3.0f); // Bottom right vertex
+
+		// Create a vector of points and initiaize the current shape
+		std::vector<olc::vf2d> points = { p0, p1, p2 };
+		return std::make_unique<TessShape>(&tv_, points, (int)ShapeType::Triangle);
+	}
+
+	std::unique_ptr<TessShape> CreateNewSquare(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
+		// Calculate half of the side length to position vertices around the center
+		float halfSide = sideLength / 2.0f;
+
+		// Calculate vertices of the square
+		olc::vf2d p0 = position + olc::vf2d(-halfSide, -halfSide); // Top left vertex
+		olc::vf2d p1 = position + olc::vf2d(halfSide, -halfSide);  // Top right vertex
+		olc::vf2d p2 = position + olc::vf2d(halfSide, halfSide);   // Bottom right vertex
+		olc::vf2d p3 = position + olc::vf2d(-halfSide, halfSide);  // Bottom left vertex
+
+		// Create a vector of points and initialize the current shape
+		std::vector<olc::vf2d> points = { p0, p1, p2, p3 };
+		return std::make_unique<TessShape>(&tv_, points, (int)ShapeType::Square);
+	}
+
+	std::unique_ptr<TessShape> CreateNewHexagon(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
+		std::vector<olc::vf2d> points;
+
+		// The angle between the center and any vertex of the hexagon is 60 degrees (pi/3 radians).
+		// We loop through all six vertices to calculate their positions.
+		for (int i = 0; i < 6; ++i) {
+			float angle_rad = (float)(M_PI / 3.0f * i); // Convert angle to radians
+			// Calculate the position of each vertex
+			olc::vf2d vertex = position + olc::vf2d(cos(angle_rad) * sideLength, sin(angle_rad) * sideLength);
+			points.push_back(vertex);
+		}
+
+		// Create a new TessShape with the calculated vertices
+		return std::make_unique<TessShape>(&tv_, points, (int)ShapeType::Hexagon);
+	}
+
+	// Create a regular polygon with the given number of sides, with its first vertex
+	// at firstVertexAngle degrees from the center
+	std::unique_ptr<TessShape> CreateNewRegularPolygon(const olc::vf2d& position, int sides, float firstVertexAngle, float sideLength, ShapeType type) {
+		std::vector<olc::vf2d> points;
+
+		// Distance from the center to each vertex
+		float radius = sideLength / (2.0f * std::sin((float)M_PI / sides));
+		for (int i = 0; i < sides; ++i) {
+			float angle_rad = (float)((firstVertexAngle + 360.0f * i / sides) * M_PI / 180.0f);
+			points.push_back(position + olc::vf2d(cos(angle_rad) * radius, sin(angle_rad) * radius));
+		}
+
+		return std::make_unique<TessShape>(&tv_, points, (int)type);
+	}
+
+	//void CreateNewDart(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
+	//	std::vector<olc::vf2d> points;
+
+	//	// Assuming the dart is oriented vertically with one tip at 'position'
+	//	float height = (float)((std::sqrt(3) / 2) * sideLength); // Height of an equilateral triangle
+
+	//	// Calculate vertices based on the dart shape
+	//	olc::vf2d topTip = position; // Top tip of the dart
+	//	olc::vf2d rightVertex = { position.x + (sideLength / 2), position.y + height };
+	//	olc::vf2d bottomTip = { position.x, position.y + 2 * height };
+	//	olc::vf2d leftVertex = { position.x - (sideLength / 2), position.y + height };
 
 	//	// Assemble points in order
 	//	points.push_back(topTip);
@@ -549,7 +3056,7 @@ public:
 	//	upCurrentShape_ = std::make_unique<TessShape>(&tv_, points);
 	//}
 
-	void CreateNewIsoQuad(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
+	std::unique_ptr<TessShape> CreateNewIsoQuad(const olc::vf2d& position, float sideLength = SIDE_LENGTH) {
 		// Calculate the height of the IsoTriangle
 		float height = sideLength * std::sin(75.0f * M_PI / 180.0f);
 
@@ -564,7 +3071,7 @@ public:
 
 		// Create a vector of points and initialize the current shape
 		std::vector<olc::vf2d> points = { p0, p1, p2, p3 };
-		upCurrentShape_ = std::make_unique<TessShape>(&tv_, points);
+		return std::make_unique<TessShape>(&tv_, points, (int)ShapeType::IsoQuad);
 	}
 
 	
@@ -597,9 +3104,31 @@ public:
 	}
 };
 
-int main()
+int main(int argc, char* argv[])
 {
 	Tess demo;
+	// Tessellation --export-svg scene.tess scene.svg
+	if (argc == 4 && std::string(argv[1]) == "--export-svg") {
+		return demo.ExportSvgHeadless(argv[2], argv[3]) ? 0 : 1;
+	}
+	// Tessellation --export-png scene.tess scene.png [width]
+	if ((argc == 4 || argc == 5) && std::string(argv[1]) == "--export-png") {
+		uint32_t width = argc == 5 ? (uint32_t)std::strtoul(argv[4], nullptr, 10) : PNG_EXPORT_WIDTH;
+		return demo.ExportPngHeadless(argv[2], argv[3], width) ? 0 : 1;
+	}
+	// Tessellation --build tiles.txt scene.tess
+	if (argc == 4 && std::string(argv[1]) == "--build") {
+		return demo.BuildSceneHeadless(argv[2], argv[3]) ? 0 : 1;
+	}
+	// Tessellation --replay session.tessin [frames.csv]
+	if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--replay") {
+		return demo.ReplayHeadless(argv[2], argc == 4 ? argv[3] : "") ? 0 : 1;
+	}
+	// Tessellation --record session.tessin
+	if (argc == 3 && std::string(argv[1]) == "--record") {
+		demo.RecordInput(argv[2]);
+	}
+
 	// if (demo.Construct(1024, 960, 1, 1))
 	if (demo.Construct(512, 480, 2, 2))
 	// if (demo.Construct(256, 240, 4, 4))
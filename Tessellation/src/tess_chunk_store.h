@@ -0,0 +1,690 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_chunk_store.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A world of shapes too large to keep in memory, streamed from a chunked
+	.tessw file.
+
+	The world is cut into square chunks. Each chunk's shapes are stored as
+	a run of .tess tile records, and a directory at the end of the file
+	says where each chunk's run is. The file layout is:
+
+		Header                  Where the footer is, and its checksum
+		TileRecord runs         One per chunk, with room to grow
+		Footer                  FooterCounts, then the prototype, vertex
+		                        and palette tables and the ChunkEntry directory
+
+	Every frame update() asks for the chunks around the view that aren't in
+	memory yet. A background thread reads them, and update() turns the
+	records into shapes on the main thread. Chunks far from the view are
+	dropped, farthest first, while the shapes in memory exceed the budget.
+
+	Adding or recoloring a shape marks its chunk dirty. Dirty chunks are
+	written back, one chunk at a time, when they are dropped, every
+	FLUSH_SECONDS, and on close(). A chunk is rewritten in place if it fits
+	its run, otherwise it moves to the end of the file with room to spare.
+	The new directory is written after the runs and the header is updated
+	last, so the file on disk is always consistent with one directory or
+	the next. The space of moved runs and old directories is not reused.
+
+	All file access after open() is on the background thread, which works
+	through its jobs in order; without threads the jobs run inline.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_scene_file.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(TESS_NO_THREADS)
+	#include <condition_variable>
+	#include <mutex>
+	#include <thread>
+#endif
+
+class TessChunkStore {
+public:
+	using PrototypeRecord = TessSceneFile::PrototypeRecord;
+	using VertexRecord = TessSceneFile::VertexRecord;
+	using TileRecord = TessSceneFile::TileRecord;
+
+	static constexpr uint32_t VERSION = 1;
+	static constexpr int64_t MAX_WANTED_CHUNKS = 64;  // Chunks wanted across the view, at most, in each direction
+	static constexpr size_t MAX_LOADS_IN_FLIGHT = 32;
+	static constexpr float FLUSH_SECONDS = 10.0f;
+
+	struct Header {
+		char magic[4];            // "TESW"
+		uint32_t version;
+		float chunkSize;          // World units
+		uint32_t reserved;
+		uint64_t footerOffset;
+		uint64_t footerSize;
+		uint64_t checksum;        // FNV-1a of the footer
+	};
+
+	struct FooterCounts {
+		uint32_t prototypeCount;
+		uint32_t vertexCount;
+		uint32_t paletteCount;
+		uint32_t reserved;
+		uint64_t chunkCount;
+	};
+
+	struct ChunkEntry {
+		int32_t x;                // Chunk coordinates
+		int32_t y;
+		uint32_t tileCount;
+		uint32_t capacity;        // Records the run has room for
+		uint64_t offset;
+		uint64_t checksum;        // FNV-1a of the tile records
+	};
+
+	static_assert(sizeof(Header) == 40 && sizeof(FooterCounts) == 24 && sizeof(ChunkEntry) == 32,
+		"The .tessw records must match the file layout");
+
+	TessChunkStore() {}
+	TessChunkStore(const TessChunkStore&) = delete;
+	TessChunkStore& operator=(const TessChunkStore&) = delete;
+
+	~TessChunkStore() {
+		close();
+	}
+
+	// Write an empty world to path
+	static bool create(const std::string& path, float chunkSize, std::string& error) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		FooterCounts counts = {};
+		Header header = {};
+		std::memcpy(header.magic, "TESW", 4);
+		header.version = VERSION;
+		header.chunkSize = chunkSize;
+		header.footerOffset = sizeof(Header);
+		header.footerSize = sizeof(FooterCounts);
+		header.checksum = TessSceneFile::checksum(TessSceneFile::FNV_OFFSET, &counts, sizeof(counts));
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)&counts, sizeof(counts));
+		if (!out) {
+			error = "Could not write " + path;
+			return false;
+		}
+		return true;
+	}
+
+	// Open the world at path and start its I/O thread
+	bool open(const std::string& path, std::string& error) {
+		close();
+		file_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+		if (!file_ || !file_.read((char*)&header_, sizeof(header_)) || std::memcmp(header_.magic, "TESW", 4) != 0 ||
+			header_.version != VERSION || !(header_.chunkSize > 0.0f)) {
+			error = path + ": not a .tessw file";
+			file_.close();
+			return false;
+		}
+
+		file_.seekg(0, std::ios::end);
+		uint64_t fileSize = (uint64_t)file_.tellg();
+		if (header_.footerOffset > fileSize || header_.footerSize > fileSize - header_.footerOffset) {
+			error = path + ": truncated file";
+			file_.close();
+			return false;
+		}
+		std::vector<uint8_t> footer(header_.footerSize);
+		file_.seekg(header_.footerOffset);
+		if (footer.size() < sizeof(FooterCounts) || !file_.read((char*)footer.data(), footer.size()) ||
+			TessSceneFile::checksum(TessSceneFile::FNV_OFFSET, footer.data(), footer.size()) != header_.checksum) {
+			error = path + ": bad directory";
+			file_.close();
+			return false;
+		}
+		FooterCounts counts;
+		std::memcpy(&counts, footer.data(), sizeof(counts));
+		uint64_t expected = sizeof(FooterCounts) + (uint64_t)counts.prototypeCount * sizeof(PrototypeRecord) +
+			(uint64_t)counts.vertexCount * sizeof(VertexRecord) + (uint64_t)counts.paletteCount * sizeof(uint32_t) +
+			counts.chunkCount * sizeof(ChunkEntry);
+		if (expected != footer.size() || !TessSceneFile::checkRecords((const PrototypeRecord*)(footer.data() + sizeof(FooterCounts)),
+			counts.prototypeCount, counts.vertexCount, counts.paletteCount, nullptr, 0, error)) {
+			error = path + ": bad directory";
+			file_.close();
+			return false;
+		}
+
+		const uint8_t* p = footer.data() + sizeof(FooterCounts);
+		const PrototypeRecord* pPrototypes = (const PrototypeRecord*)p;
+		const VertexRecord* pVertices = (const VertexRecord*)(pPrototypes + counts.prototypeCount);
+		const uint32_t* pPalette = (const uint32_t*)(pVertices + counts.vertexCount);
+		const ChunkEntry* pEntries = (const ChunkEntry*)(pPalette + counts.paletteCount);
+		tables_.assign(pPrototypes, counts.prototypeCount, pVertices, counts.vertexCount, pPalette, counts.paletteCount);
+		ioPrototypes_ = tables_.prototypes;
+		ioVertices_ = tables_.vertices;
+		ioPalette_ = tables_.palette;
+		tablesSent_ = tables_.prototypes.size() + tables_.palette.size();
+		for (uint64_t i = 0; i < counts.chunkCount; ++i) {
+			directory_[chunkKey(pEntries[i].x, pEntries[i].y)] = pEntries[i];
+		}
+		dataEnd_ = header_.footerOffset + header_.footerSize;
+		footerDirty_ = false;
+		open_ = true;
+		error_.clear();
+
+#if !defined(TESS_NO_THREADS)
+		stop_ = false;
+		thread_ = std::thread([this]() { run(); });
+#endif
+		return true;
+	}
+
+	// Write back every dirty chunk, finish the I/O thread's jobs and close the file
+	void close() {
+		if (!open_) {
+			return;
+		}
+		flush();
+		// Chunks still loading have had shapes added; append them to what is on disk
+		for (auto& [key, chunk] : chunks_) {
+			if (chunk.loading && !chunk.upShapes.empty()) {
+				submitWrite(chunk, true);
+			}
+		}
+#if !defined(TESS_NO_THREADS)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		thread_.join();
+#endif
+		writeFooter();
+		file_.close();
+		chunks_.clear();
+		directory_.clear();
+		loaded_.clear();
+		residentBytes_ = 0;
+		loadsInFlight_ = 0;
+		open_ = false;
+	}
+
+	bool isOpen() const { return open_; }
+	float chunkSize() const { return header_.chunkSize; }
+	const TessSceneFile::Tables& tables() const { return tables_; }
+
+	// Page in the chunks around [vMin, vMax], turning their records into shapes
+	// with makeShape(const TileRecord&), and drop far chunks while the shapes
+	// in memory take more than budgetBytes. Returns true if any shapes were
+	// destroyed.
+	template <typename MakeShape>
+	bool update(const olc::vf2d& vMin, const olc::vf2d& vMax, size_t budgetBytes, float fElapsedTime, MakeShape makeShape) {
+		if (!open_) {
+			return false;
+		}
+		++frame_;
+
+		// The chunks overlapping the view and a margin of one chunk, at most
+		// MAX_WANTED_CHUNKS across around its centre
+		olc::vf2d centre = (vMin + vMax) * 0.5f;
+		int64_t cx = chunkCoord(centre.x), cy = chunkCoord(centre.y);
+		int64_t half = MAX_WANTED_CHUNKS / 2;
+		int64_t x0 = std::max(chunkCoord(vMin.x) - 1, cx - half), x1 = std::min(chunkCoord(vMax.x) + 1, cx + half);
+		int64_t y0 = std::max(chunkCoord(vMin.y) - 1, cy - half), y1 = std::min(chunkCoord(vMax.y) + 1, cy + half);
+
+		std::vector<std::pair<int64_t, int64_t>> missing;
+		for (int64_t x = x0; x <= x1; ++x) {
+			for (int64_t y = y0; y <= y1; ++y) {
+				auto it = chunks_.find(chunkKey(x, y));
+				if (it != chunks_.end()) {
+					it->second.lastWanted = frame_;
+				}
+				else {
+					missing.push_back({ x, y });
+				}
+			}
+		}
+
+		// Request the missing chunks nearest the centre first, unless memory is
+		// already full of chunks that are wanted
+		std::sort(missing.begin(), missing.end(), [&](const auto& a, const auto& b) {
+			return distance2(a.first, a.second, cx, cy) < distance2(b.first, b.second, cx, cy);
+		});
+		for (const auto& [x, y] : missing) {
+			if (loadsInFlight_ >= MAX_LOADS_IN_FLIGHT || residentBytes_ > budgetBytes) {
+				break;
+			}
+			requestChunk(x, y).lastWanted = frame_;
+		}
+
+		// Turn finished loads into shapes, before any shapes added while loading
+		std::vector<Loaded> loaded;
+#if !defined(TESS_NO_THREADS)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			loaded.swap(loaded_);
+		}
+#else
+		loaded.swap(loaded_);
+#endif
+		for (auto& result : loaded) {
+			--loadsInFlight_;
+			if (!result.error.empty()) {
+				error_ = result.error;
+			}
+			auto it = chunks_.find(chunkKey(result.x, result.y));
+			if (it == chunks_.end()) {
+				continue;
+			}
+			Chunk& chunk = it->second;
+			std::string error;
+			if (!TessSceneFile::checkRecords(tables_.prototypes.data(), tables_.prototypes.size(), tables_.vertices.size(), tables_.palette.size(),
+				result.tiles.data(), result.tiles.size(), error)) {
+				error_ = "Chunk " + std::to_string(result.x) + "," + std::to_string(result.y) + ": " + error;
+				result.tiles.clear();
+			}
+			std::vector<std::unique_ptr<TessShape>> upShapes;
+			upShapes.reserve(result.tiles.size() + chunk.upShapes.size());
+			for (const auto& tile : result.tiles) {
+				upShapes.push_back(makeShape(tile));
+			}
+			for (auto& upShape : chunk.upShapes) {
+				upShapes.push_back(std::move(upShape));
+			}
+			chunk.upShapes.swap(upShapes);
+			chunk.loading = false;
+			residentBytes_ -= chunk.bytes;
+			chunk.bytes = sizeof(Chunk);
+			for (const auto& upShape : chunk.upShapes) {
+				chunk.bytes += shapeBytes(*upShape);
+			}
+			residentBytes_ += chunk.bytes;
+		}
+
+		// Drop unwanted chunks, farthest first, while over budget
+		bool evicted = false;
+		if (residentBytes_ > budgetBytes) {
+			std::vector<std::pair<int64_t, uint64_t>> candidates;
+			for (const auto& [key, chunk] : chunks_) {
+				if (!chunk.loading && chunk.lastWanted != frame_) {
+					candidates.push_back({ distance2(chunk.x, chunk.y, cx, cy), key });
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+			for (const auto& candidate : candidates) {
+				if (residentBytes_ <= budgetBytes) {
+					break;
+				}
+				auto it = chunks_.find(candidate.second);
+				if (it->second.dirty) {
+					submitTables();
+					submitWrite(it->second, false);
+				}
+				residentBytes_ -= it->second.bytes;
+				chunks_.erase(it);
+				evicted = true;
+			}
+			finishWrites();
+		}
+
+		flushTime_ += fElapsedTime;
+		if (flushTime_ >= FLUSH_SECONDS) {
+			flush();
+		}
+		return evicted;
+	}
+
+	// Add a shape to the world, in the chunk of its centroid
+	void addShape(std::unique_ptr<TessShape> upShape) {
+		olc::vf2d centroid = upShape->getCentroid();
+		Chunk& chunk = requestChunk(chunkCoord(centroid.x), chunkCoord(centroid.y));
+		size_t bytes = shapeBytes(*upShape);
+		chunk.bytes += bytes;
+		residentBytes_ += bytes;
+		chunk.upShapes.push_back(std::move(upShape));
+		chunk.dirty = true;
+	}
+
+	// Note that a shape of the world has changed, so its chunk is written back
+	void markDirty(TessShape& shape) {
+		olc::vf2d centroid = shape.getCentroid();
+		auto it = chunks_.find(chunkKey(chunkCoord(centroid.x), chunkCoord(centroid.y)));
+		if (it != chunks_.end()) {
+			it->second.dirty = true;
+		}
+	}
+
+	// Queue every dirty chunk in memory to be written back
+	void flush() {
+		flushTime_ = 0.0f;
+		submitTables();
+		for (auto& [key, chunk] : chunks_) {
+			if (chunk.dirty && !chunk.loading) {
+				submitWrite(chunk, false);
+			}
+		}
+		finishWrites();
+	}
+
+	// Call fn(TessShape&) for the shapes in memory whose chunks overlap [vMin, vMax]
+	template <typename Fn>
+	void forEachShape(const olc::vf2d& vMin, const olc::vf2d& vMax, Fn fn) {
+		int64_t x0 = chunkCoord(vMin.x) - 1, x1 = chunkCoord(vMax.x) + 1;
+		int64_t y0 = chunkCoord(vMin.y) - 1, y1 = chunkCoord(vMax.y) + 1;
+		for (auto& [key, chunk] : chunks_) {
+			if (chunk.x >= x0 && chunk.x <= x1 && chunk.y >= y0 && chunk.y <= y1) {
+				for (auto& upShape : chunk.upShapes) {
+					fn(*upShape);
+				}
+			}
+		}
+	}
+
+	size_t residentChunks() const { return chunks_.size(); }
+	size_t residentBytes() const { return residentBytes_; }
+	size_t loadsInFlight() const { return loadsInFlight_; }
+
+	// The last read or write error, empty if there was none
+	const std::string& error() const { return error_; }
+
+private:
+	// A chunk in memory, or on its way
+	struct Chunk {
+		int64_t x = 0;
+		int64_t y = 0;
+		std::vector<std::unique_ptr<TessShape>> upShapes;
+		size_t bytes = 0;
+		bool loading = true;
+		bool dirty = false;
+		uint64_t lastWanted = 0;    // Frame the chunk was last near the view
+	};
+
+	struct Job {
+		enum class Type { Load, Write, Append, Tables } type;
+		int64_t x = 0;
+		int64_t y = 0;
+		std::vector<TileRecord> tiles;
+		std::vector<PrototypeRecord> prototypes;
+		std::vector<VertexRecord> vertices;
+		std::vector<uint32_t> palette;
+	};
+
+	struct Loaded {
+		int64_t x;
+		int64_t y;
+		std::vector<TileRecord> tiles;
+		std::string error;
+	};
+
+	// Main thread state
+	bool open_ = false;
+	Header header_ = {};
+	TessSceneFile::Tables tables_;
+	std::unordered_map<uint64_t, Chunk> chunks_;
+	size_t residentBytes_ = 0;
+	size_t loadsInFlight_ = 0;
+	size_t tablesSent_ = 0;        // Prototype and palette counts last sent to the I/O thread
+	uint64_t frame_ = 0;
+	float flushTime_ = 0.0f;
+	std::string error_;
+
+	// I/O thread state
+	std::fstream file_;
+	std::unordered_map<uint64_t, ChunkEntry> directory_;
+	std::vector<PrototypeRecord> ioPrototypes_;
+	std::vector<VertexRecord> ioVertices_;
+	std::vector<uint32_t> ioPalette_;
+	uint64_t dataEnd_ = 0;         // New runs and directories go here
+	bool footerDirty_ = false;
+
+	// Shared, under mutex_
+	std::deque<Job> jobs_;
+	std::vector<Loaded> loaded_;
+#if !defined(TESS_NO_THREADS)
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stop_ = false;
+	std::thread thread_;
+#endif
+
+	int64_t chunkCoord(float v) const {
+		return (int64_t)std::floor(v / header_.chunkSize);
+	}
+
+	static uint64_t chunkKey(int64_t x, int64_t y) {
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+	}
+
+	static int64_t distance2(int64_t x, int64_t y, int64_t cx, int64_t cy) {
+		return (x - cx) * (x - cx) + (y - cy) * (y - cy);
+	}
+
+	// Memory held by a shape: the object, its two vertex lists and the pointer to it
+	static size_t shapeBytes(TessShape& shape) {
+		return sizeof(TessShape) + sizeof(void*) + 2 * shape.getDrawPoints().size() * sizeof(olc::vf2d);
+	}
+
+	// The chunk at (x, y), asking the I/O thread for it if it isn't in memory
+	Chunk& requestChunk(int64_t x, int64_t y) {
+		auto [it, added] = chunks_.try_emplace(chunkKey(x, y));
+		if (added) {
+			it->second.x = x;
+			it->second.y = y;
+			it->second.bytes = sizeof(Chunk);
+			residentBytes_ += sizeof(Chunk);
+			Job job;
+			job.type = Job::Type::Load;
+			job.x = x;
+			job.y = y;
+			++loadsInFlight_;
+			submit(std::move(job));
+		}
+		return it->second;
+	}
+
+	// Send the I/O thread the tables if shapes with new prototypes or colors were encoded
+	void submitTables() {
+		size_t count = tables_.prototypes.size() + tables_.palette.size();
+		if (count == tablesSent_) {
+			return;
+		}
+		tablesSent_ = count;
+		Job job;
+		job.type = Job::Type::Tables;
+		job.prototypes = tables_.prototypes;
+		job.vertices = tables_.vertices;
+		job.palette = tables_.palette;
+		submit(std::move(job));
+	}
+
+	// Queue the chunk's shapes to be written, replacing or appending to its run
+	void submitWrite(Chunk& chunk, bool append) {
+		Job job;
+		job.type = append ? Job::Type::Append : Job::Type::Write;
+		job.x = chunk.x;
+		job.y = chunk.y;
+		job.tiles.resize(chunk.upShapes.size());
+		size_t count = 0;
+		for (const auto& upShape : chunk.upShapes) {
+			std::string error;
+			if (tables_.encode(*upShape, job.tiles[count], error)) {
+				++count;
+			}
+			else {
+				error_ = error;
+			}
+		}
+		job.tiles.resize(count);
+		submitTables(); // Encoding may have added to the tables
+		submit(std::move(job));
+		chunk.dirty = false;
+	}
+
+	void submit(Job&& job) {
+#if !defined(TESS_NO_THREADS)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			jobs_.push_back(std::move(job));
+		}
+		wake_.notify_one();
+#else
+		process(job);
+#endif
+	}
+
+	// Without threads, write the directory once a batch of writes is done.
+	// The I/O thread does this itself whenever it runs out of jobs.
+	void finishWrites() {
+#if defined(TESS_NO_THREADS)
+		writeFooter();
+#endif
+	}
+
+#if !defined(TESS_NO_THREADS)
+	void run() {
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				if (jobs_.empty()) {
+					lock.unlock();
+					writeFooter();
+					lock.lock();
+				}
+				wake_.wait(lock, [&]() { return stop_ || !jobs_.empty(); });
+				if (jobs_.empty()) {
+					return;
+				}
+				job = std::move(jobs_.front());
+				jobs_.pop_front();
+			}
+			process(job);
+		}
+	}
+#endif
+
+	// Run one job, on the I/O thread
+	void process(Job& job) {
+		switch (job.type)
+		{
+			case Job::Type::Load: {
+				Loaded result = { job.x, job.y, {}, {} };
+				readChunk(job.x, job.y, result.tiles, result.error);
+#if !defined(TESS_NO_THREADS)
+				std::lock_guard<std::mutex> lock(mutex_);
+#endif
+				loaded_.push_back(std::move(result));
+				break;
+			}
+			case Job::Type::Append: {
+				std::vector<TileRecord> tiles;
+				std::string error;
+				readChunk(job.x, job.y, tiles, error);
+				tiles.insert(tiles.end(), job.tiles.begin(), job.tiles.end());
+				writeChunk(job.x, job.y, tiles);
+				break;
+			}
+			case Job::Type::Write:
+				writeChunk(job.x, job.y, job.tiles);
+				break;
+			case Job::Type::Tables:
+				ioPrototypes_.swap(job.prototypes);
+				ioVertices_.swap(job.vertices);
+				ioPalette_.swap(job.palette);
+				footerDirty_ = true;
+				break;
+		}
+	}
+
+	void readChunk(int64_t x, int64_t y, std::vector<TileRecord>& tiles, std::string& error) {
+		auto it = directory_.find(chunkKey(x, y));
+		if (it == directory_.end() || it->second.tileCount == 0) {
+			return;
+		}
+		const ChunkEntry& entry = it->second;
+		tiles.resize(entry.tileCount);
+		file_.seekg(entry.offset);
+		if (!file_.read((char*)tiles.data(), tiles.size() * sizeof(TileRecord)) ||
+			TessSceneFile::checksum(TessSceneFile::FNV_OFFSET, tiles.data(), tiles.size() * sizeof(TileRecord)) != entry.checksum) {
+			file_.clear();
+			tiles.clear();
+			error = "Chunk " + std::to_string(x) + "," + std::to_string(y) + " is damaged";
+		}
+	}
+
+	void writeChunk(int64_t x, int64_t y, const std::vector<TileRecord>& tiles) {
+		if (tiles.empty() && directory_.count(chunkKey(x, y)) == 0) {
+			return;
+		}
+		ChunkEntry& entry = directory_[chunkKey(x, y)];
+		entry.x = (int32_t)x;
+		entry.y = (int32_t)y;
+		if (tiles.size() > entry.capacity) {
+			// Move the run to the end, with room to grow
+			entry.capacity = (uint32_t)std::max<size_t>(16, tiles.size() + tiles.size() / 2);
+			entry.offset = dataEnd_;
+			dataEnd_ += (uint64_t)entry.capacity * sizeof(TileRecord);
+		}
+		entry.tileCount = (uint32_t)tiles.size();
+		entry.checksum = TessSceneFile::checksum(TessSceneFile::FNV_OFFSET, tiles.data(), tiles.size() * sizeof(TileRecord));
+		file_.seekp(entry.offset);
+		file_.write((const char*)tiles.data(), tiles.size() * sizeof(TileRecord));
+		footerDirty_ = true;
+	}
+
+	// Write the tables and directory after the runs, then point the header at them
+	void writeFooter() {
+		if (!footerDirty_) {
+			return;
+		}
+		FooterCounts counts = {};
+		counts.prototypeCount = (uint32_t)ioPrototypes_.size();
+		counts.vertexCount = (uint32_t)ioVertices_.size();
+		counts.paletteCount = (uint32_t)ioPalette_.size();
+		counts.chunkCount = directory_.size();
+
+		std::vector<uint8_t> footer;
+		auto append = [&](const void* pData, size_t size) {
+			footer.insert(footer.end(), (const uint8_t*)pData, (const uint8_t*)pData + size);
+		};
+		append(&counts, sizeof(counts));
+		append(ioPrototypes_.data(), ioPrototypes_.size() * sizeof(PrototypeRecord));
+		append(ioVertices_.data(), ioVertices_.size() * sizeof(VertexRecord));
+		append(ioPalette_.data(), ioPalette_.size() * sizeof(uint32_t));
+		for (const auto& [key, entry] : directory_) {
+			append(&entry, sizeof(entry));
+		}
+
+		Header header = header_;
+		header.footerOffset = dataEnd_;
+		header.footerSize = footer.size();
+		header.checksum = TessSceneFile::checksum(TessSceneFile::FNV_OFFSET, footer.data(), footer.size());
+		file_.seekp(header.footerOffset);
+		file_.write((const char*)footer.data(), footer.size());
+		file_.flush();
+		file_.seekp(0);
+		file_.write((const char*)&header, sizeof(header));
+		file_.flush();
+		dataEnd_ += footer.size();
+		footerDirty_ = false;
+	}
+};
@@ -0,0 +1,477 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_coloring.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Proper colorings of a graph, such as the graph of placed shapes that
+	share a side: each vertex gets a color index, and no two neighbours get
+	the same one.
+
+	color() colors each connected component on its own. A component of up
+	to EXACT_MAX_VERTICES is colored exactly, with as few colors as it can
+	take, by backtracking. The rest are colored greedily in parallel, the
+	Jones-Plassmann way: each round, every uncolored vertex that outranks
+	its uncolored neighbours takes the smallest color they leave free.
+	Vertices rank by degree, then by a hash of their index, so the rounds
+	are the same from run to run and the busiest vertices choose first.
+	No two neighbours are colored in the same round, so a round needs no
+	locks. A greedy coloring takes at most one more color than the highest
+	degree.
+
+	colorLattice() colors a periodic patch in a repeating pattern. Given
+	each vertex's tile k of the unit cell and copy (i, j) of the lattice,
+	a pattern gives it the class of k and (a i + b j) mod m. A class must
+	never neighbour itself, and the classes are then colored exactly, as a
+	graph of a few dozen vertices at most. Of the patterns up to
+	MAX_PATTERN_PERIOD, the one taking the fewest colors is used, such as
+	three colors of a hexagon tiling (m = 3), which no greedy order is sure
+	to find. Vertices outside the repeat are colored greedily around it.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_flat_map.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TessColoring {
+public:
+	static constexpr uint8_t NONE = 0xFF;
+	static constexpr int MAX_COLORS = 64;                   // A vertex's free colors are the bits of a mask
+	static constexpr size_t EXACT_MAX_VERTICES = 32;        // Components this small are colored exactly
+	static constexpr uint64_t EXACT_MAX_STEPS = 1 << 20;    // Backtracking steps before an exact coloring gives up
+	static constexpr int64_t MAX_PATTERN_PERIOD = 4;        // Largest m of the lattice patterns tried
+	static constexpr int REGREEDY_PASSES = 4;               // Passes of iterated greedy after the parallel rounds
+
+	// Neighbours of vertex v are neighbours[offsets[v]] .. neighbours[offsets[v + 1] - 1]
+	struct Graph {
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> neighbours;
+
+		size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+	};
+
+	// Where a vertex is in a periodic patch: tile k of the unit cell, in
+	// copy (i, j) of the lattice
+	struct LatticePlace {
+		uint32_t k = UINT32_MAX;     // UINT32_MAX if the vertex isn't part of the repeat
+		int64_t i = 0;
+		int64_t j = 0;
+	};
+
+	// Color every vertex, each component as described above. Returns the
+	// number of colors used.
+	static int color(const Graph& graph, std::vector<uint8_t>& colors) {
+		size_t n = graph.size();
+		colors.assign(n, NONE);
+
+		// Components, breadth first. The small ones are colored exactly.
+		std::vector<uint8_t> seen(n, 0);
+		std::vector<uint32_t> component;
+		std::vector<uint64_t> adjacency;
+		std::vector<uint8_t> exact;
+		for (uint32_t root = 0; root < n; ++root) {
+			if (seen[root]) {
+				continue;
+			}
+			seen[root] = 1;
+			component.assign(1, root);
+			for (size_t head = 0; head < component.size(); ++head) {
+				uint32_t v = component[head];
+				for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; ++e) {
+					uint32_t u = graph.neighbours[e];
+					if (!seen[u]) {
+						seen[u] = 1;
+						component.push_back(u);
+					}
+				}
+			}
+			if (component.size() > EXACT_MAX_VERTICES) {
+				continue;
+			}
+
+			// Numbered in the component by breadth first order
+			adjacency.assign(component.size(), 0);
+			for (size_t a = 0; a < component.size(); ++a) {
+				uint32_t v = component[a];
+				for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; ++e) {
+					size_t b = std::find(component.begin(), component.end(), graph.neighbours[e]) - component.begin();
+					if (b != a) {
+						adjacency[a] |= 1ull << b;
+					}
+				}
+			}
+			if (colorExact(adjacency, (int)component.size(), exact) > 0) {
+				for (size_t a = 0; a < component.size(); ++a) {
+					colors[component[a]] = exact[a];
+				}
+			}
+		}
+
+		return colorGreedy(graph, colors);
+	}
+
+	// Color the vertices still NONE greedily, in parallel rounds, around
+	// the ones already colored. Returns the number of colors used by all.
+	static int colorGreedy(const Graph& graph, std::vector<uint8_t>& colors) {
+		size_t n = graph.size();
+		std::vector<uint64_t> ranks(n);
+		tessParallelFor(n, 65536, [&](size_t begin, size_t end) {
+			for (size_t v = begin; v < end; ++v) {
+				uint64_t degree = graph.offsets[v + 1] - graph.offsets[v];
+				ranks[v] = (std::min<uint64_t>(degree, 0xFFFF) << 48) | (hash(v) >> 16);
+			}
+		});
+		auto outranks = [&](uint32_t v, uint32_t u) {
+			return ranks[v] != ranks[u] ? ranks[v] > ranks[u] : v > u;
+		};
+
+		std::vector<uint32_t> work;
+		for (uint32_t v = 0; v < n; ++v) {
+			if (colors[v] == NONE) {
+				work.push_back(v);
+			}
+		}
+		const std::vector<uint32_t> free = work;
+		std::vector<uint8_t> ready;
+		while (!work.empty()) {
+			// Only reads colors, so every vertex can decide at once
+			ready.assign(work.size(), 0);
+			tessParallelFor(work.size(), 16384, [&](size_t begin, size_t end) {
+				for (size_t w = begin; w < end; ++w) {
+					uint32_t v = work[w];
+					bool first = true;
+					for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1] && first; ++e) {
+						uint32_t u = graph.neighbours[e];
+						first = colors[u] != NONE || u == v || outranks(v, u);
+					}
+					ready[w] = first;
+				}
+			});
+
+			// The vertices ready are never neighbours, so none of them reads
+			// a color another is writing
+			tessParallelFor(work.size(), 16384, [&](size_t begin, size_t end) {
+				for (size_t w = begin; w < end; ++w) {
+					if (ready[w]) {
+						colors[work[w]] = freeColor(graph, colors, work[w]);
+					}
+				}
+			});
+
+			size_t kept = 0;
+			for (size_t w = 0; w < work.size(); ++w) {
+				if (!ready[w]) {
+					work[kept++] = work[w];
+				}
+			}
+			work.resize(kept);
+		}
+
+		int used = 0;
+		for (uint8_t c : colors) {
+			used = std::max(used, c + 1);
+		}
+		for (int pass = 0; pass < REGREEDY_PASSES && used > 2; ++pass) {
+			used = regreedy(graph, free, colors, used);
+		}
+		return used;
+	}
+
+	// Color a graph of at most 64 vertices, given as a mask of each
+	// vertex's neighbours, with as few colors as it takes, up to maxColors.
+	// Returns the number of colors, or 0 if it takes more than maxColors or
+	// the search ran out of steps.
+	static int colorExact(const std::vector<uint64_t>& adjacency, int maxColors, std::vector<uint8_t>& colors) {
+		size_t n = adjacency.size();
+		colors.assign(n, NONE);
+		if (n == 0) {
+			return 0;
+		}
+		for (size_t v = 0; v < n; ++v) {
+			if (adjacency[v] >> v & 1) {
+				return 0; // A vertex neighbouring itself can't be colored
+			}
+		}
+
+		// Busiest vertices first, each followed as soon as it can be by its
+		// neighbours, so conflicts show early
+		std::vector<uint32_t> order;
+		uint64_t placedMask = 0;
+		while (order.size() < n) {
+			uint32_t best = 0;
+			int bestScore = -1;
+			for (uint32_t v = 0; v < n; ++v) {
+				if (placedMask >> v & 1) {
+					continue;
+				}
+				int score = std::popcount(adjacency[v] & placedMask) * 64 + std::popcount(adjacency[v]);
+				if (score > bestScore) {
+					bestScore = score;
+					best = v;
+				}
+			}
+			placedMask |= 1ull << best;
+			order.push_back(best);
+		}
+
+		uint64_t steps = 0;
+		for (int k = 1; k <= std::min(maxColors, MAX_COLORS); ++k) {
+			if (search(adjacency, order, 0, k, 0, colors, steps)) {
+				return k;
+			}
+			if (steps > EXACT_MAX_STEPS) {
+				break;
+			}
+		}
+		colors.assign(n, NONE);
+		return 0;
+	}
+
+	// Color a periodic patch in the repeating pattern taking the fewest
+	// colors, up to maxColors, and the vertices outside the repeat greedily.
+	// Returns the number of colors used, or 0 with colors untouched if no
+	// pattern fits.
+	static int colorLattice(const Graph& graph, const std::vector<LatticePlace>& places, int maxColors, std::vector<uint8_t>& colors) {
+		size_t n = graph.size();
+		uint32_t cellSize = 0;
+		for (const auto& place : places) {
+			if (place.k != UINT32_MAX) {
+				cellSize = std::max(cellSize, place.k + 1);
+			}
+		}
+		if (cellSize == 0 || cellSize > 64) {
+			return 0;
+		}
+
+		// The kinds of side shared in the repeat: tile k1 next to tile k2
+		// di, dj copies along. There are only a few, wherever they are.
+		std::vector<std::vector<uint64_t>> found(tessThreadCount());
+		tessParallelFor(found.size(), 1, [&](size_t first, size_t last) {
+			size_t slice = (n + found.size() - 1) / found.size();
+			for (size_t t = first; t < last; ++t) {
+				TessFlatMap<uint64_t, uint8_t> kinds;
+				for (size_t v = t * slice; v < std::min(n, (t + 1) * slice); ++v) {
+					const LatticePlace& from = places[v];
+					if (from.k == UINT32_MAX) {
+						continue;
+					}
+					for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; ++e) {
+						const LatticePlace& to = places[graph.neighbours[e]];
+						if (to.k != UINT32_MAX) {
+							kinds.try_emplace(sideKey(from.k, to.k, to.i - from.i, to.j - from.j), 1);
+						}
+					}
+				}
+				for (const auto& kind : kinds) {
+					found[t].push_back(kind.first);
+				}
+			}
+		});
+		TessFlatMap<uint64_t, uint8_t> merged;
+		for (const auto& keys : found) {
+			for (uint64_t key : keys) {
+				merged.try_emplace(key, 1);
+			}
+		}
+		std::vector<uint64_t> sides;
+		for (const auto& side : merged) {
+			if (side.first == UINT64_MAX) {
+				return 0; // Neighbours too many copies apart to be a pattern
+			}
+			sides.push_back(side.first);
+		}
+
+		int64_t bestM = 0, bestA = 0, bestB = 0;
+		int bestColors = maxColors + 1;
+		std::vector<uint8_t> bestClassColors;
+		std::vector<uint64_t> adjacency;
+		std::vector<uint8_t> classColors;
+		for (int64_t m = 1; m <= MAX_PATTERN_PERIOD && cellSize * m <= 64 && bestColors > 2; ++m) {
+			for (int64_t a = 0; a < m; ++a) {
+				for (int64_t b = 0; b < m; ++b) {
+					adjacency.assign(cellSize * m, 0);
+					for (uint64_t side : sides) {
+						uint32_t k1 = (uint32_t)(side >> 48);
+						uint32_t k2 = (uint32_t)(side >> 32) & 0xFFFF;
+						int64_t di = (int64_t)((side >> 16) & 0xFFFF) - 0x8000;
+						int64_t dj = (int64_t)(side & 0xFFFF) - 0x8000;
+						int64_t shift = mod(a * di + b * dj, m);
+						for (int64_t r = 0; r < m; ++r) {
+							size_t q1 = k1 * m + r;
+							size_t q2 = k2 * m + mod(r + shift, m);
+							adjacency[q1] |= 1ull << q2;
+							adjacency[q2] |= 1ull << q1;
+						}
+					}
+					int used = colorExact(adjacency, bestColors - 1, classColors);
+					if (used > 0) {
+						bestColors = used;
+						bestM = m;
+						bestA = a;
+						bestB = b;
+						bestClassColors = classColors;
+					}
+				}
+			}
+		}
+		if (bestM == 0) {
+			return 0;
+		}
+
+		colors.assign(n, NONE);
+		tessParallelFor(n, 65536, [&](size_t begin, size_t end) {
+			for (size_t v = begin; v < end; ++v) {
+				const LatticePlace& place = places[v];
+				if (place.k != UINT32_MAX) {
+					colors[v] = bestClassColors[place.k * bestM + mod(bestA * place.i + bestB * place.j, bestM)];
+				}
+			}
+		});
+
+		// A place found for a tile that isn't part of the repeat may not
+		// fit the pattern. Such tiles, and the neighbours they clash
+		// with, are left to be colored greedily.
+		std::vector<uint8_t> clash(n, 0);
+		tessParallelFor(n, 65536, [&](size_t begin, size_t end) {
+			for (size_t v = begin; v < end; ++v) {
+				for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; ++e) {
+					uint32_t u = graph.neighbours[e];
+					if (u != v && colors[v] != NONE && colors[u] == colors[v]) {
+						clash[v] = 1;
+					}
+				}
+			}
+		});
+		for (size_t v = 0; v < n; ++v) {
+			if (clash[v]) {
+				colors[v] = NONE;
+			}
+		}
+		return colorGreedy(graph, colors);
+	}
+
+private:
+	// splitmix64, a well mixed hash of an index
+	static uint64_t hash(uint64_t x) {
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	static int64_t mod(int64_t x, int64_t m) {
+		int64_t r = x % m;
+		return r < 0 ? r + m : r;
+	}
+
+	// The smallest color none of v's neighbours has
+	static uint8_t freeColor(const Graph& graph, const std::vector<uint8_t>& colors, uint32_t v) {
+		uint64_t taken = 0;
+		for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; ++e) {
+			uint8_t c = colors[graph.neighbours[e]];
+			if (c != NONE) {
+				taken |= 1ull << c;
+			}
+		}
+		if (taken == UINT64_MAX) {
+			return MAX_COLORS - 1; // Only a vertex with 64 or more neighbours gets here
+		}
+		return (uint8_t)std::countr_zero(~taken);
+	}
+
+	// Color the vertices of free again, one old color class after another,
+	// highest first, each vertex taking the smallest color its neighbours
+	// colored so far leave free (iterated greedy). A class never neighbours
+	// itself, so its vertices are colored in parallel, and it still fits in
+	// a color the old classes before it left free, so no more colors are
+	// used than before and often fewer. Returns the number of colors used.
+	static int regreedy(const Graph& graph, const std::vector<uint32_t>& free, std::vector<uint8_t>& colors, int used) {
+		std::vector<uint32_t> starts(used + 1, 0);
+		for (uint32_t v : free) {
+			starts[colors[v] + 1] += 1;
+		}
+		for (int c = 0; c < used; ++c) {
+			starts[c + 1] += starts[c];
+		}
+		std::vector<uint32_t> classes(free.size());
+		std::vector<uint32_t> next(starts.begin(), starts.end() - 1);
+		for (uint32_t v : free) {
+			classes[next[colors[v]]++] = v;
+		}
+		for (uint32_t v : free) {
+			colors[v] = NONE;
+		}
+
+		for (int c = used - 1; c >= 0; --c) {
+			tessParallelFor(starts[c + 1] - starts[c], 16384, [&](size_t begin, size_t end) {
+				for (size_t w = starts[c] + begin; w < starts[c] + end; ++w) {
+					colors[classes[w]] = freeColor(graph, colors, classes[w]);
+				}
+			});
+		}
+
+		int reused = 0;
+		for (uint8_t c : colors) {
+			reused = std::max(reused, c + 1);
+		}
+		return reused;
+	}
+
+	// A kind of side in a repeat, or UINT64_MAX if the copies are too far
+	// apart to pack
+	static uint64_t sideKey(uint32_t k1, uint32_t k2, int64_t di, int64_t dj) {
+		if (di < -0x7FFF || di > 0x7FFF || dj < -0x7FFF || dj > 0x7FFF) {
+			return UINT64_MAX;
+		}
+		return (uint64_t)k1 << 48 | (uint64_t)k2 << 32 | (uint64_t)(di + 0x8000) << 16 | (uint64_t)(dj + 0x8000);
+	}
+
+	// Color order[depth] onward with at most k colors, used of which are
+	// taken so far. A color never used yet is as good as any other, so only
+	// the first of them is tried.
+	static bool search(const std::vector<uint64_t>& adjacency, const std::vector<uint32_t>& order, size_t depth, int k, int used,
+		std::vector<uint8_t>& colors, uint64_t& steps) {
+		if (depth == order.size()) {
+			return true;
+		}
+		if (++steps > EXACT_MAX_STEPS) {
+			return false;
+		}
+		uint32_t v = order[depth];
+		uint64_t taken = 0;
+		for (uint64_t mask = adjacency[v]; mask != 0; mask &= mask - 1) {
+			uint8_t c = colors[std::countr_zero(mask)];
+			if (c != NONE) {
+				taken |= 1ull << c;
+			}
+		}
+		int limit = std::min(k, used + 1);
+		for (int c = 0; c < limit; ++c) {
+			if (!(taken >> c & 1)) {
+				colors[v] = (uint8_t)c;
+				if (search(adjacency, order, depth + 1, k, std::max(used, c + 1), colors, steps)) {
+					return true;
+				}
+			}
+		}
+		colors[v] = NONE;
+		return false;
+	}
+};
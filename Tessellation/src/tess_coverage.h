@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_coverage.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A coverage analyzer that finds the gaps and overlaps of a tiling inside a
+	world rectangle.
+
+	The shapes are rasterized into a coverage bitmap: one sample per
+	resolution x resolution world units, holding how many shapes cover the
+	sample's centre. A sample is covered if it lies inside the shape, using
+	a top-left rule (half-open spans and edges), so two shapes that share an
+	edge never both cover a sample on it. Samples covered by no shape are
+	gaps; samples covered by two or more are overlaps. Neighbouring gap (or
+	overlap) samples are grouped into regions, which are reported with their
+	bounds and area.
+
+	The rows of the bitmap are split into bands, and each band is rasterized
+	on its own thread. The whole analysis runs on a background thread, on a
+	snapshot of the shapes, so the application stays responsive.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+class TessCoverageAnalyzer {
+public:
+	// Upper bound on the bitmap size. Coarser samples are used for larger rectangles.
+	static constexpr size_t MAX_SAMPLES = (size_t)1 << 26;
+	// Only the largest regions of each kind are reported
+	static constexpr size_t MAX_REGIONS = 256;
+	// Rows per band of the bitmap, the unit of work of a rasterizer thread
+	static constexpr int32_t BAND_ROWS = 64;
+
+	// The polygons to analyze, stored flat
+	struct Snapshot {
+		std::vector<olc::vf2d> points;
+		std::vector<uint32_t> starts; // Index of each polygon's first point
+
+		void add(const std::vector<olc::vf2d>& polygon, const olc::vf2d& offset = { 0.0f, 0.0f }) {
+			starts.push_back((uint32_t)points.size());
+			for (const auto& point : polygon) {
+				points.push_back(point + offset);
+			}
+		}
+
+		size_t size() const {
+			return starts.size();
+		}
+	};
+
+	// A connected group of gap or overlap samples
+	struct Region {
+		olc::vf2d vMin;
+		olc::vf2d vMax;
+		double area;
+	};
+
+	struct Result {
+		olc::vf2d worldTL;
+		olc::vf2d worldBR;
+		float resolution = 0.0f;      // World size of a sample
+		int32_t width = 0;            // Bitmap size in samples
+		int32_t height = 0;
+		size_t polygons = 0;
+		double rectArea = 0.0;
+		double uncoveredArea = 0.0;
+		double overlapArea = 0.0;
+		std::vector<Region> gaps;     // Largest first
+		std::vector<Region> overlaps; // Largest first
+		double milliseconds = 0.0;
+	};
+
+	~TessCoverageAnalyzer() {
+		cancel();
+	}
+
+	// Start analyzing the rectangle [worldTL, worldBR] in the background. Any
+	// analysis still running is cancelled.
+	void start(const olc::vf2d& worldTL, const olc::vf2d& worldBR, float resolution, Snapshot&& snapshot) {
+		cancel();
+		hasResult_ = false;
+		cancelled_ = false;
+		running_ = true;
+		pending_ = true;
+
+#ifdef TESS_NO_THREADS
+		analyze(worldTL, worldBR, resolution, std::move(snapshot));
+#else
+		worker_ = std::thread([this, worldTL, worldBR, resolution, snapshot = std::move(snapshot)]() mutable {
+			analyze(worldTL, worldBR, resolution, std::move(snapshot));
+		});
+#endif
+	}
+
+	// Call once a frame. Returns true if a result has just become available.
+	bool poll() {
+		if (!pending_ || running_) {
+			return false;
+		}
+		if (worker_.joinable()) {
+			worker_.join();
+		}
+		pending_ = false;
+		hasResult_ = !cancelled_;
+		return hasResult_;
+	}
+
+	void cancel() {
+		cancelled_ = true;
+		if (worker_.joinable()) {
+			worker_.join();
+		}
+		running_ = false;
+		pending_ = false;
+	}
+
+	// Drop the last result
+	void clear() {
+		cancel();
+		hasResult_ = false;
+		result_ = Result();
+	}
+
+	bool isRunning() const {
+		return running_;
+	}
+
+	bool hasResult() const {
+		return hasResult_;
+	}
+
+	const Result& getResult() const {
+		return result_;
+	}
+
+private:
+	static constexpr uint8_t CLAIMED = 255;   // Sample already grouped into a region
+	static constexpr uint8_t MAX_COUNT = 254;
+
+	std::thread worker_;
+	std::atomic<bool> running_ = false;
+	std::atomic<bool> cancelled_ = false;
+	bool pending_ = false;       // Started, and the result hasn't been collected by poll()
+	bool hasResult_ = false;
+	Result result_;
+
+	void analyze(olc::vf2d worldTL, olc::vf2d worldBR, float resolution, Snapshot snapshot) {
+		auto startTime = std::chrono::steady_clock::now();
+		Result result;
+
+		// Size the bitmap, coarsening the samples if it would be too large
+		olc::vf2d size = (worldBR - worldTL).max({ resolution, resolution });
+		double samples = (double)size.x * size.y / ((double)resolution * resolution);
+		if (samples > (double)MAX_SAMPLES) {
+			resolution *= (float)std::sqrt(samples / (double)MAX_SAMPLES);
+		}
+		result.worldTL = worldTL;
+		result.worldBR = worldTL + size;
+		result.resolution = resolution;
+		result.width = std::max(1, (int32_t)std::ceil(size.x / resolution));
+		result.height = std::max(1, (int32_t)std::ceil(size.y / resolution));
+		result.polygons = snapshot.size();
+		result.rectArea = (double)size.x * size.y;
+
+		std::vector<uint8_t> counts = rasterize(snapshot, worldTL, resolution, result.width, result.height);
+		if (cancelled_) {
+			running_ = false;
+			return;
+		}
+
+		double sampleArea = (double)resolution * resolution;
+		size_t uncovered = 0, overlapped = 0;
+		for (uint8_t count : counts) {
+			uncovered += count == 0;
+			overlapped += count >= 2;
+		}
+		result.uncoveredArea = uncovered * sampleArea;
+		result.overlapArea = overlapped * sampleArea;
+
+		result.gaps = findRegions(counts, result, [](uint8_t count) { return count == 0; });
+		result.overlaps = findRegions(counts, result, [](uint8_t count) { return count >= 2 && count != CLAIMED; });
+
+		result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		result_ = std::move(result);
+		running_ = false;
+	}
+
+	// Coverage count of every sample, saturating at MAX_COUNT
+	std::vector<uint8_t> rasterize(const Snapshot& snapshot, const olc::vf2d& worldTL, float resolution, int32_t width, int32_t height) const {
+		std::vector<uint8_t> counts((size_t)width * height, 0);
+
+		// Bin the polygons by the bands of rows they touch
+		int32_t bandCount = (height + BAND_ROWS - 1) / BAND_ROWS;
+		std::vector<std::vector<uint32_t>> bands(bandCount);
+		for (size_t i = 0; i < snapshot.size(); ++i) {
+			float yMin, yMax;
+			polygonRange(snapshot, i, yMin, yMax);
+			int32_t r0 = std::max(0, (int32_t)std::floor((yMin - worldTL.y) / resolution) / BAND_ROWS);
+			int32_t r1 = std::min(bandCount - 1, (int32_t)std::floor((yMax - worldTL.y) / resolution) / BAND_ROWS);
+			for (int32_t band = r0; band <= r1; ++band) {
+				bands[band].push_back((uint32_t)i);
+			}
+		}
+
+		// Each band only writes its own rows
+		tessParallelFor((size_t)bandCount, 1, [&](size_t begin, size_t end) {
+			std::vector<float> crossings;
+			for (size_t band = begin; band < end && !cancelled_; ++band) {
+				int32_t rowBegin = (int32_t)band * BAND_ROWS;
+				int32_t rowEnd = std::min(height, rowBegin + BAND_ROWS);
+				for (uint32_t i : bands[band]) {
+					rasterizePolygon(snapshot, i, worldTL, resolution, width, rowBegin, rowEnd, counts, crossings);
+				}
+			}
+		});
+		return counts;
+	}
+
+	static void polygonRange(const Snapshot& snapshot, size_t i, float& yMin, float& yMax) {
+		size_t begin = snapshot.starts[i];
+		size_t end = i + 1 < snapshot.size() ? snapshot.starts[i + 1] : snapshot.points.size();
+		yMin = yMax = snapshot.points[begin].y;
+		for (size_t k = begin; k < end; ++k) {
+			yMin = std::min(yMin, snapshot.points[k].y);
+			yMax = std::max(yMax, snapshot.points[k].y);
+		}
+	}
+
+	// Add the polygon's even-odd coverage of the sample centres in rows [rowBegin, rowEnd)
+	static void rasterizePolygon(const Snapshot& snapshot, size_t i, const olc::vf2d& worldTL, float resolution, int32_t width,
+		int32_t rowBegin, int32_t rowEnd, std::vector<uint8_t>& counts, std::vector<float>& crossings) {
+		size_t begin = snapshot.starts[i];
+		size_t end = i + 1 < snapshot.size() ? snapshot.starts[i + 1] : snapshot.points.size();
+		size_t n = end - begin;
+		const olc::vf2d* points = snapshot.points.data() + begin;
+
+		float yMin, yMax;
+		polygonRange(snapshot, i, yMin, yMax);
+		int32_t r0 = std::max(rowBegin, (int32_t)std::ceil((yMin - worldTL.y) / resolution - 0.5f));
+		int32_t r1 = std::min(rowEnd - 1, (int32_t)std::ceil((yMax - worldTL.y) / resolution - 0.5f) - 1);
+
+		for (int32_t row = r0; row <= r1; ++row) {
+			float y = worldTL.y + (row + 0.5f) * resolution;
+
+			// Edges span [lower y, upper y), always evaluated from the lower end
+			// so a shared edge gives both neighbours exactly the same crossing
+			crossings.clear();
+			for (size_t k = 0; k < n; ++k) {
+				olc::vf2d a = points[k];
+				olc::vf2d b = points[(k + 1) % n];
+				if (a.y > b.y) {
+					std::swap(a, b);
+				}
+				if (y >= a.y && y < b.y) {
+					crossings.push_back(a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y));
+				}
+			}
+			std::sort(crossings.begin(), crossings.end());
+
+			// Spans cover sample centres in [x0, x1)
+			uint8_t* pRow = counts.data() + (size_t)row * width;
+			for (size_t k = 0; k + 1 < crossings.size(); k += 2) {
+				int32_t c0 = std::max(0, (int32_t)std::ceil((crossings[k] - worldTL.x) / resolution - 0.5f));
+				int32_t c1 = std::min(width, (int32_t)std::ceil((crossings[k + 1] - worldTL.x) / resolution - 0.5f));
+				for (int32_t col = c0; col < c1; ++col) {
+					if (pRow[col] < MAX_COUNT) {
+						++pRow[col];
+					}
+				}
+			}
+		}
+	}
+
+	// Group the samples that pass the test into 4-connected regions. Grouped
+	// samples are marked CLAIMED.
+	template <typename Test>
+	std::vector<Region> findRegions(std::vector<uint8_t>& counts, const Result& result, Test test) const {
+		std::vector<Region> regions;
+		std::vector<uint32_t> stack;
+		double sampleArea = (double)result.resolution * result.resolution;
+		int32_t width = result.width;
+		int32_t height = result.height;
+
+		for (size_t start = 0; start < counts.size() && !cancelled_; ++start) {
+			if (!test(counts[start])) {
+				continue;
+			}
+
+			int32_t xMin = width, xMax = -1, yMin = height, yMax = -1;
+			size_t samples = 0;
+			counts[start] = CLAIMED;
+			stack.push_back((uint32_t)start);
+			while (!stack.empty()) {
+				uint32_t s = stack.back();
+				stack.pop_back();
+				int32_t x = (int32_t)(s % width);
+				int32_t y = (int32_t)(s / width);
+				xMin = std::min(xMin, x); xMax = std::max(xMax, x);
+				yMin = std::min(yMin, y); yMax = std::max(yMax, y);
+				++samples;
+
+				const int32_t dx[4] = { 1, -1, 0, 0 };
+				const int32_t dy[4] = { 0, 0, 1, -1 };
+				for (int d = 0; d < 4; ++d) {
+					int32_t nx = x + dx[d];
+					int32_t ny = y + dy[d];
+					if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+						continue;
+					}
+					uint32_t ns = (uint32_t)ny * width + nx;
+					if (test(counts[ns])) {
+						counts[ns] = CLAIMED;
+						stack.push_back(ns);
+					}
+				}
+			}
+
+			Region region;
+			region.vMin = result.worldTL + olc::vf2d((float)xMin, (float)yMin) * result.resolution;
+			region.vMax = result.worldTL + olc::vf2d((float)(xMax + 1), (float)(yMax + 1)) * result.resolution;
+			region.area = samples * sampleArea;
+			regions.push_back(region);
+		}
+
+		std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.area > b.area; });
+		if (regions.size() > MAX_REGIONS) {
+			regions.resize(MAX_REGIONS);
+		}
+		return regions;
+	}
+};
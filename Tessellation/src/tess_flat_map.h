@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_flat_map.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A hash map from integer or pointer keys to values, stored in one flat
+	array with linear probing, for the indexes that hold an entry per
+	placed shape or vertex. A lookup is usually a single cache miss, and
+	an insert allocates nothing once the map has been reserved, where
+	std::unordered_map allocates a node per element and follows a pointer
+	to reach it. A million inserts take a fraction of the time.
+
+	Keys are spread with Fibonacci hashing. Erasing shifts the following
+	elements of the probe run back, so there are no tombstones and lookups
+	stay short however many elements come and go.
+
+	It has the parts of the std::unordered_map interface the indexes use.
+	Unlike std::unordered_map, inserting or erasing moves elements, so
+	iterators and references are only valid until the next change.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename Key, typename Value>
+class TessFlatMap {
+public:
+	static_assert(std::is_integral_v<Key> || std::is_pointer_v<Key>, "TessFlatMap keys are integers or pointers");
+
+	using value_type = std::pair<Key, Value>;
+
+	template <typename Map, typename Element>
+	class Iterator {
+	public:
+		Iterator(Map* pMap, size_t slot) : pMap_(pMap), slot_(slot) {
+			skipEmpty();
+		}
+
+		Element& operator*() const { return pMap_->slots_[slot_]; }
+		Element* operator->() const { return &pMap_->slots_[slot_]; }
+
+		Iterator& operator++() {
+			++slot_;
+			skipEmpty();
+			return *this;
+		}
+
+		bool operator==(const Iterator& other) const { return slot_ == other.slot_; }
+		bool operator!=(const Iterator& other) const { return slot_ != other.slot_; }
+
+	private:
+		friend class TessFlatMap;
+		Map* pMap_;
+		size_t slot_;
+
+		void skipEmpty() {
+			while (slot_ < pMap_->used_.size() && !pMap_->used_[slot_]) {
+				++slot_;
+			}
+		}
+	};
+
+	using iterator = Iterator<TessFlatMap, value_type>;
+	using const_iterator = Iterator<const TessFlatMap, const value_type>;
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, used_.size()); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, used_.size()); }
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	iterator find(Key key) {
+		return iterator(this, findSlot(key));
+	}
+
+	const_iterator find(Key key) const {
+		return const_iterator(this, findSlot(key));
+	}
+
+	size_t count(Key key) const {
+		return findSlot(key) != used_.size() ? 1 : 0;
+	}
+
+	// Insert value under key unless key is already there. Returns the
+	// element with key, and whether it was inserted.
+	std::pair<iterator, bool> try_emplace(Key key, const Value& value = Value()) {
+		if ((size_ + 1) * 4 > used_.size() * 3) {
+			rehash(std::max<size_t>(MIN_SLOTS, used_.size() * 2));
+		}
+		size_t slot = home(key);
+		while (used_[slot]) {
+			if (slots_[slot].first == key) {
+				return { iterator(this, slot), false };
+			}
+			slot = (slot + 1) & mask_;
+		}
+		used_[slot] = 1;
+		slots_[slot] = value_type(key, value);
+		size_ += 1;
+		return { iterator(this, slot), true };
+	}
+
+	Value& operator[](Key key) {
+		return try_emplace(key).first->second;
+	}
+
+	void erase(iterator it) {
+		size_t slot = it.slot_;
+		used_[slot] = 0;
+		slots_[slot] = value_type();
+		size_ -= 1;
+
+		// Shift back any later element of the run that the hole cuts off
+		// from its home slot
+		size_t next = (slot + 1) & mask_;
+		while (used_[next]) {
+			size_t wanted = home(slots_[next].first);
+			if (((next - wanted) & mask_) >= ((next - slot) & mask_)) {
+				slots_[slot] = std::move(slots_[next]);
+				used_[slot] = 1;
+				slots_[next] = value_type();
+				used_[next] = 0;
+				slot = next;
+			}
+			next = (next + 1) & mask_;
+		}
+	}
+
+	size_t erase(Key key) {
+		iterator it = find(key);
+		if (it == end()) {
+			return 0;
+		}
+		erase(it);
+		return 1;
+	}
+
+	// Make room for count elements in all, so adding them doesn't rehash
+	void reserve(size_t count) {
+		size_t slots = MIN_SLOTS;
+		while (slots * 3 < count * 4) {
+			slots *= 2;
+		}
+		if (slots > used_.size()) {
+			rehash(slots);
+		}
+	}
+
+	void clear() {
+		slots_.clear();
+		used_.clear();
+		mask_ = 0;
+		size_ = 0;
+	}
+
+private:
+	static constexpr size_t MIN_SLOTS = 16;
+
+	std::vector<value_type> slots_;
+	std::vector<uint8_t> used_;  // 1 where slots_ holds an element
+	size_t mask_ = 0;            // Slot count - 1, the count being a power of two
+	size_t size_ = 0;
+
+	size_t home(Key key) const {
+		uint64_t bits;
+		if constexpr (std::is_pointer_v<Key>) {
+			bits = (uint64_t)(uintptr_t)key;
+		}
+		else {
+			bits = (uint64_t)key;
+		}
+		return (size_t)((bits * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+	}
+
+	// The slot holding key, or used_.size() if there is none
+	size_t findSlot(Key key) const {
+		if (size_ == 0) {
+			return used_.size();
+		}
+		size_t slot = home(key);
+		while (used_[slot]) {
+			if (slots_[slot].first == key) {
+				return slot;
+			}
+			slot = (slot + 1) & mask_;
+		}
+		return used_.size();
+	}
+
+	void rehash(size_t slotCount) {
+		std::vector<value_type> slots(slotCount);
+		std::vector<uint8_t> used(slotCount, 0);
+		slots.swap(slots_);
+		used.swap(used_);
+		mask_ = slotCount - 1;
+		for (size_t i = 0; i < used.size(); ++i) {
+			if (used[i]) {
+				size_t slot = home(slots[i].first);
+				while (used_[slot]) {
+					slot = (slot + 1) & mask_;
+				}
+				used_[slot] = 1;
+				slots_[slot] = std::move(slots[i]);
+			}
+		}
+	}
+};
@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_geometry.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Small geometry helpers shared by the tiling generators: affine transforms
+	of the plane, 2D lattices, clipping to a rectangle and polygon tests.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// An affine transform of the plane, p' = M * p + t
+struct TessTransform {
+	float m00 = 1.0f, m01 = 0.0f;
+	float m10 = 0.0f, m11 = 1.0f;
+	olc::vf2d t = { 0.0f, 0.0f };
+
+	olc::vf2d apply(const olc::vf2d& p) const {
+		return { m00 * p.x + m01 * p.y + t.x, m10 * p.x + m11 * p.y + t.y };
+	}
+
+	// Apply only the linear part, for directions
+	olc::vf2d applyLinear(const olc::vf2d& v) const {
+		return { m00 * v.x + m01 * v.y, m10 * v.x + m11 * v.y };
+	}
+
+	// The transform that applies other first, then this
+	TessTransform operator*(const TessTransform& other) const {
+		TessTransform r;
+		r.m00 = m00 * other.m00 + m01 * other.m10;
+		r.m01 = m00 * other.m01 + m01 * other.m11;
+		r.m10 = m10 * other.m00 + m11 * other.m10;
+		r.m11 = m10 * other.m01 + m11 * other.m11;
+		r.t = apply(other.t);
+		return r;
+	}
+
+	// True if the transform flips orientation (a reflection or glide reflection)
+	bool isReflection() const {
+		return m00 * m11 - m01 * m10 < 0.0f;
+	}
+
+	static TessTransform translation(const olc::vf2d& v) {
+		TessTransform r;
+		r.t = v;
+		return r;
+	}
+
+	// Rotation by angleDegrees about centre
+	static TessTransform rotation(float angleDegrees, const olc::vf2d& centre = { 0.0f, 0.0f }) {
+		float angleRadians = angleDegrees * (float)(M_PI / 180.0);
+		TessTransform r;
+		r.m00 = std::cos(angleRadians); r.m01 = -std::sin(angleRadians);
+		r.m10 = std::sin(angleRadians); r.m11 = std::cos(angleRadians);
+		r.t = centre - r.applyLinear(centre);
+		return r;
+	}
+
+	// Reflection in the line through point at angleDegrees to the x axis
+	static TessTransform reflection(float angleDegrees, const olc::vf2d& point = { 0.0f, 0.0f }) {
+		float twiceRadians = 2.0f * angleDegrees * (float)(M_PI / 180.0);
+		TessTransform r;
+		r.m00 = std::cos(twiceRadians); r.m01 = std::sin(twiceRadians);
+		r.m10 = std::sin(twiceRadians); r.m11 = -std::cos(twiceRadians);
+		r.t = point - r.applyLinear(point);
+		return r;
+	}
+
+	// The point group Cn (n rotations) or Dn (n rotations and n mirrors) about
+	// centre, identity first. The first mirror of Dn is vertical.
+	static std::vector<TessTransform> pointGroup(int n, bool dihedral, const olc::vf2d& centre) {
+		std::vector<TessTransform> ops;
+		for (int k = 0; k < n; ++k) {
+			ops.push_back(rotation(360.0f * k / n, centre));
+		}
+		if (dihedral) {
+			for (int k = 0; k < n; ++k) {
+				ops.push_back(reflection(90.0f + 180.0f * k / n, centre));
+			}
+		}
+		return ops;
+	}
+};
+
+// A 2D lattice spanned by the vectors a and b
+struct TessLattice {
+	olc::vf2d a = { 1.0f, 0.0f };
+	olc::vf2d b = { 0.0f, 1.0f };
+
+	// A rectangular block of lattice cells, inclusive
+	struct CellRange {
+		int32_t iMin = 0, iMax = -1, jMin = 0, jMax = -1;
+
+		bool contains(int32_t i, int32_t j) const {
+			return i >= iMin && i <= iMax && j >= jMin && j <= jMax;
+		}
+	};
+
+	olc::vf2d offset(int32_t i, int32_t j) const {
+		return a * (float)i + b * (float)j;
+	}
+
+	// Lattice coordinates (i, j) such that p = i * a + j * b
+	olc::vf2d toLattice(const olc::vf2d& p) const {
+		float det = a.cross(b);
+		return { p.cross(b) / det, a.cross(p) / det };
+	}
+
+	// Range of lattice cells whose copy of the bounds [cellMin, cellMax] may
+	// intersect the rectangle [vMin, vMax]. If more than maxCells would be
+	// needed (zoomed far out), only the cells around the middle are kept.
+	CellRange cellRange(const olc::vf2d& cellMin, const olc::vf2d& cellMax,
+		const olc::vf2d& vMin, const olc::vf2d& vMax, int64_t maxCells) const {
+		// A cell at offset o covers [cellMin + o, cellMax + o], so it can only
+		// intersect the rectangle if o lies in [vMin - cellMax, vMax - cellMin]
+		olc::vf2d oMin = vMin - cellMax;
+		olc::vf2d oMax = vMax - cellMin;
+		olc::vf2d corners[4] = { toLattice(oMin), toLattice({ oMax.x, oMin.y }), toLattice(oMax), toLattice({ oMin.x, oMax.y }) };
+
+		olc::vf2d lMin = corners[0];
+		olc::vf2d lMax = corners[0];
+		for (const auto& corner : corners) {
+			lMin = lMin.min(corner);
+			lMax = lMax.max(corner);
+		}
+
+		CellRange range;
+		range.iMin = (int32_t)std::floor(lMin.x);
+		range.iMax = (int32_t)std::ceil(lMax.x);
+		range.jMin = (int32_t)std::floor(lMin.y);
+		range.jMax = (int32_t)std::ceil(lMax.y);
+
+		int64_t count = (int64_t)(range.iMax - range.iMin + 1) * (range.jMax - range.jMin + 1);
+		if (count > maxCells) {
+			int32_t half = (int32_t)(std::sqrt((double)maxCells) / 2.0);
+			int32_t iMid = (range.iMin + range.iMax) / 2;
+			int32_t jMid = (range.jMin + range.jMax) / 2;
+			range.iMin = std::max(range.iMin, iMid - half);
+			range.iMax = std::min(range.iMax, iMid + half);
+			range.jMin = std::max(range.jMin, jMid - half);
+			range.jMax = std::min(range.jMax, jMid + half);
+		}
+		return range;
+	}
+};
+
+// An order of count items by the square cell a point of each falls in, row
+// by row, so that a pass over many shapes in this order works on nearby
+// shapes, and their shared vertices, together. Cell coordinates wrap at
+// 2^16, which only changes the order, so two counting sort passes sort them.
+struct TessSpatialOrder {
+	template <typename Point>
+	static std::vector<uint32_t> of(size_t count, float cellSize, Point point) {
+		std::vector<uint32_t> keys(count);
+		for (size_t i = 0; i < count; ++i) {
+			olc::vf2d p = point(i);
+			keys[i] = key((int64_t)std::floor(p.x / cellSize), (int64_t)std::floor(p.y / cellSize));
+		}
+		return byKey(keys);
+	}
+
+	// The sort key of cell (x, y)
+	static uint32_t key(int64_t x, int64_t y) {
+		return ((uint32_t)y & 0xFFFF) << 16 | ((uint32_t)x & 0xFFFF);
+	}
+
+	// The indices of keys in increasing key order, equal keys in index order
+	static std::vector<uint32_t> byKey(const std::vector<uint32_t>& keys) {
+		std::vector<uint32_t> order(keys.size());
+		std::vector<uint32_t> sorted(keys.size());
+		for (size_t i = 0; i < keys.size(); ++i) {
+			order[i] = (uint32_t)i;
+		}
+		std::vector<uint32_t> starts(0x10001);
+		for (int shift = 0; shift < 32; shift += 16) {
+			std::fill(starts.begin(), starts.end(), 0);
+			for (uint32_t key : keys) {
+				starts[((key >> shift) & 0xFFFF) + 1] += 1;
+			}
+			for (size_t d = 1; d < starts.size(); ++d) {
+				starts[d] += starts[d - 1];
+			}
+			for (uint32_t i : order) {
+				sorted[starts[(keys[i] >> shift) & 0xFFFF]++] = i;
+			}
+			order.swap(sorted);
+		}
+		return order;
+	}
+};
+
+// Clipping against an axis aligned rectangle [vMin, vMax]. Used before
+// rasterizing geometry that may lie far outside the screen, where the
+// integer pixel coordinates would overflow.
+struct TessClip {
+	// Clip the segment pq (Liang-Barsky). Returns false if nothing is left.
+	static bool segment(olc::vf2d& p, olc::vf2d& q, const olc::vf2d& vMin, const olc::vf2d& vMax) {
+		olc::vf2d d = q - p;
+		float t0 = 0.0f;
+		float t1 = 1.0f;
+		const float edges[4][2] = {
+			{ -d.x, p.x - vMin.x }, { d.x, vMax.x - p.x },
+			{ -d.y, p.y - vMin.y }, { d.y, vMax.y - p.y }
+		};
+		for (const auto& edge : edges) {
+			if (edge[0] == 0.0f) {
+				if (edge[1] < 0.0f) {
+					return false; // Parallel to this edge and outside it
+				}
+				continue;
+			}
+			float t = edge[1] / edge[0];
+			if (edge[0] < 0.0f) {
+				t0 = std::max(t0, t);
+			}
+			else {
+				t1 = std::min(t1, t);
+			}
+			if (t0 > t1) {
+				return false;
+			}
+		}
+		q = p + d * t1;
+		p = p + d * t0;
+		return true;
+	}
+
+	// Clip a convex polygon (Sutherland-Hodgman). The result is written to out,
+	// which is empty if the polygon misses the rectangle.
+	static void polygon(const olc::vf2d* points, size_t count, const olc::vf2d& vMin, const olc::vf2d& vMax, std::vector<olc::vf2d>& out) {
+		out.assign(points, points + count);
+		std::vector<olc::vf2d>& in = scratch();
+		for (int side = 0; side < 4 && !out.empty(); ++side) {
+			in.swap(out);
+			out.clear();
+			for (size_t i = 0; i < in.size(); ++i) {
+				const olc::vf2d& p = in[i];
+				const olc::vf2d& q = in[(i + 1) % in.size()];
+				float dp = inside(p, side, vMin, vMax);
+				float dq = inside(q, side, vMin, vMax);
+				if (dp >= 0.0f) {
+					out.push_back(p);
+				}
+				if ((dp >= 0.0f) != (dq >= 0.0f)) {
+					out.push_back(p + (q - p) * (dp / (dp - dq)));
+				}
+			}
+		}
+	}
+
+private:
+	// Signed distance of p inside the given side of the rectangle
+	static float inside(const olc::vf2d& p, int side, const olc::vf2d& vMin, const olc::vf2d& vMax) {
+		switch (side)
+		{
+			case 0: return p.x - vMin.x;
+			case 1: return vMax.x - p.x;
+			case 2: return p.y - vMin.y;
+			default: return vMax.y - p.y;
+		}
+	}
+
+	// Working buffer, reused so clipping doesn't allocate once it has grown
+	static std::vector<olc::vf2d>& scratch() {
+		static thread_local std::vector<olc::vf2d> buffer;
+		return buffer;
+	}
+};
+
+// Polygon tests used for placing tiles
+struct TessPolygon {
+	// Shapes that interpenetrate by less than this (in world units) only touch.
+	// Vertices are rounded to 0.01, so shared edges are well within it.
+	static constexpr float OVERLAP_TOLERANCE = 0.1f;
+
+	// Even-odd test of p against any simple polygon
+	static bool containsPoint(const olc::vf2d* points, size_t count, const olc::vf2d& p) {
+		bool inside = false;
+		for (size_t i = 0, j = count - 1; i < count; j = i++) {
+			if (((points[i].y > p.y) != (points[j].y > p.y)) &&
+				(p.x < (points[j].x - points[i].x) * (p.y - points[i].y) / (points[j].y - points[i].y) + points[i].x)) {
+				inside = !inside;
+			}
+		}
+		return inside;
+	}
+
+	// True if the segments ab and cd cross at a point interior to both
+	static bool segmentsCross(const olc::vf2d& a, const olc::vf2d& b, const olc::vf2d& c, const olc::vf2d& d) {
+		float d1 = (b - a).cross(c - a);
+		float d2 = (b - a).cross(d - a);
+		float d3 = (d - c).cross(a - c);
+		float d4 = (d - c).cross(b - c);
+		return ((d1 > 0.0f && d2 < 0.0f) || (d1 < 0.0f && d2 > 0.0f)) &&
+			((d3 > 0.0f && d4 < 0.0f) || (d3 < 0.0f && d4 > 0.0f));
+	}
+
+	// Separating axis test for two convex polygons. They only count as overlapping
+	// if they interpenetrate by more than tolerance along every axis, so tiles that
+	// share an edge or a vertex don't overlap.
+	static bool overlaps(const olc::vf2d* a, size_t countA, const olc::vf2d* b, size_t countB, float tolerance) {
+		return !hasSeparatingAxis(a, countA, a, countA, b, countB, tolerance) &&
+			!hasSeparatingAxis(b, countB, a, countA, b, countB, tolerance);
+	}
+
+private:
+	// Check the edge normals of edges as separating axes
+	static bool hasSeparatingAxis(const olc::vf2d* edges, size_t countEdges,
+		const olc::vf2d* a, size_t countA, const olc::vf2d* b, size_t countB, float tolerance) {
+		for (size_t i = 0; i < countEdges; ++i) {
+			olc::vf2d edge = edges[(i + 1) % countEdges] - edges[i];
+			float length = edge.mag();
+			if (length <= 0.0f) {
+				continue;
+			}
+			olc::vf2d axis = olc::vf2d(-edge.y, edge.x) / length;
+
+			float minA, maxA, minB, maxB;
+			project(a, countA, axis, minA, maxA);
+			project(b, countB, axis, minB, maxB);
+			if (maxA - minB <= tolerance || maxB - minA <= tolerance) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static void project(const olc::vf2d* points, size_t count, const olc::vf2d& axis, float& vMin, float& vMax) {
+		vMin = vMax = points[0].dot(axis);
+		for (size_t i = 1; i < count; ++i) {
+			float d = points[i].dot(axis);
+			vMin = std::min(vMin, d);
+			vMax = std::max(vMax, d);
+		}
+	}
+};
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_input_log.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Records the input of every frame of a session to a file, and plays it
+	back, so a slow or broken session can be run again exactly as it
+	happened.
+
+	A frame records the time it took (the fElapsedTime passed to
+	OnUserUpdate), the mouse position in screen pixels, the wheel, and the
+	held state of every key and mouse button. Pressed and released are
+	worked out from the held state of the frame before, the same way the
+	engine does, so they replay as they were seen. The file is a header
+	followed by a Frame record per frame, written as the session goes.
+
+	The application reads its input through TessInputLog. While recording
+	or running live it takes the state from the engine each frame; while
+	replaying it takes it from the file instead.
+
+	TessHeadlessPlatform and TessHeadlessRenderer stand in for the window
+	and graphics device, so a replay runs without a display and as fast as
+	the frames can be computed.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// ***************************
+// The input of each frame, recorded or replayed
+// ***************************
+
+class TessInputLog {
+public:
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint32_t FLUSH_FRAMES = 64;   // Frames buffered before they are written out
+	static constexpr size_t KEY_WORDS = 4;         // 64 bit words of key state, for 256 keys
+
+	struct Header {
+		char magic[4];            // "TESI"
+		uint32_t version;
+		int32_t screenWidth;      // Screen the mouse positions are in
+		int32_t screenHeight;
+	};
+
+	struct Frame {
+		float elapsedTime;        // Seconds, as passed to OnUserUpdate
+		int32_t mouseX;           // Screen pixels
+		int32_t mouseY;
+		int32_t mouseWheel;
+		uint32_t mouseButtons;    // Bit per held button
+		uint32_t reserved;
+		uint64_t keys[KEY_WORDS]; // Bit per held olc::Key
+	};
+
+	static_assert(sizeof(Header) == 16 && sizeof(Frame) == 56, "The input log records must match the file layout");
+
+	~TessInputLog() {
+		stopRecording();
+	}
+
+	// Record every frame from now on to path. The scene the session starts
+	// from is the caller's to save alongside, see scenePath().
+	bool startRecording(const std::string& path, const olc::vi2d& screenSize, std::string& error) {
+		stopRecording();
+		out_.open(path, std::ios::binary | std::ios::trunc);
+		Header header = {};
+		std::memcpy(header.magic, "TESI", 4);
+		header.version = VERSION;
+		header.screenWidth = screenSize.x;
+		header.screenHeight = screenSize.y;
+		out_.write((const char*)&header, sizeof(header));
+		if (!out_) {
+			error = "Could not write " + path;
+			out_.close();
+			return false;
+		}
+		return true;
+	}
+
+	void stopRecording() {
+		if (out_.is_open()) {
+			writePending();
+			out_.close();
+		}
+	}
+
+	bool isRecording() const { return out_.is_open(); }
+
+	// Read the frames recorded in path, to be played back in place of the
+	// engine's input
+	bool openReplay(const std::string& path, std::string& error) {
+		std::ifstream in(path, std::ios::binary);
+		Header header = {};
+		in.read((char*)&header, sizeof(header));
+		if (!in || std::memcmp(header.magic, "TESI", 4) != 0 || header.version != VERSION || header.screenWidth <= 0 || header.screenHeight <= 0) {
+			error = path + ": not an input log";
+			return false;
+		}
+		replay_.clear();
+		Frame frame;
+		while (in.read((char*)&frame, sizeof(frame))) {
+			replay_.push_back(frame);
+		}
+		screenSize_ = { header.screenWidth, header.screenHeight };
+		next_ = 0;
+		replaying_ = true;
+		return true;
+	}
+
+	bool isReplaying() const { return replaying_; }
+
+	// Frames left to play back
+	bool hasFrame() const { return replaying_ && next_ < replay_.size(); }
+	size_t frameCount() const { return replay_.size(); }
+
+	// Screen size of the recorded session
+	const olc::vi2d& screenSize() const { return screenSize_; }
+
+	// The scene file saved next to a log, that the session started from
+	static std::string scenePath(const std::string& path) {
+		return path + ".tess";
+	}
+
+	// Take this frame's input, from the engine or the replay, and record it
+	// if recording. Returns the elapsed time to run the frame with.
+	float beginFrame(olc::PixelGameEngine& pge, float fElapsedTime) {
+		previous_ = current_;
+		if (replaying_) {
+			current_ = next_ < replay_.size() ? replay_[next_++] : Frame{};
+			return current_.elapsedTime;
+		}
+
+		current_ = {};
+		current_.elapsedTime = fElapsedTime;
+		olc::vi2d mouse = pge.GetMousePos();
+		current_.mouseX = mouse.x;
+		current_.mouseY = mouse.y;
+		current_.mouseWheel = pge.GetMouseWheel();
+		for (uint32_t button = 0; button < olc::nMouseButtons; ++button) {
+			if (pge.GetMouse(button).bHeld) {
+				current_.mouseButtons |= 1u << button;
+			}
+		}
+		for (int key = olc::Key::NONE + 1; key < olc::Key::ENUM_END; ++key) {
+			if (pge.GetKey((olc::Key)key).bHeld) {
+				current_.keys[key / 64] |= 1ull << (key % 64);
+			}
+		}
+		if (out_.is_open()) {
+			pending_.push_back(current_);
+			if (pending_.size() >= FLUSH_FRAMES) {
+				writePending();
+			}
+		}
+		return fElapsedTime;
+	}
+
+	olc::HWButton key(olc::Key key) const {
+		return button(keyHeld(previous_, key), keyHeld(current_, key));
+	}
+
+	olc::HWButton mouse(uint32_t button) const {
+		if (button >= olc::nMouseButtons) {
+			return {};
+		}
+		return this->button((previous_.mouseButtons >> button) & 1, (current_.mouseButtons >> button) & 1);
+	}
+
+	olc::vi2d mousePos() const { return { current_.mouseX, current_.mouseY }; }
+	int32_t mouseWheel() const { return current_.mouseWheel; }
+
+private:
+	std::ofstream out_;
+	std::vector<Frame> pending_;   // Recorded frames not yet written
+	std::vector<Frame> replay_;    // Frames to play back
+	size_t next_ = 0;              // Next frame of replay_
+	bool replaying_ = false;
+	olc::vi2d screenSize_ = { 0, 0 };
+	Frame current_ = {};
+	Frame previous_ = {};
+
+	static bool keyHeld(const Frame& frame, olc::Key key) {
+		uint32_t k = (uint32_t)key;
+		return k < KEY_WORDS * 64 && ((frame.keys[k / 64] >> (k % 64)) & 1);
+	}
+
+	static olc::HWButton button(bool wasHeld, bool held) {
+		olc::HWButton state;
+		state.bPressed = held && !wasHeld;
+		state.bReleased = !held && wasHeld;
+		state.bHeld = held;
+		return state;
+	}
+
+	void writePending() {
+		out_.write((const char*)pending_.data(), pending_.size() * sizeof(Frame));
+		out_.flush();
+		pending_.clear();
+	}
+};
+
+// ***************************
+// A window and graphics device that do nothing, for replays
+// ***************************
+
+class TessHeadlessPlatform : public olc::Platform {
+public:
+	olc::rcode ApplicationStartUp() override { return olc::rcode::OK; }
+	olc::rcode ApplicationCleanUp() override { return olc::rcode::OK; }
+	olc::rcode ThreadStartUp() override { return olc::rcode::OK; }
+	olc::rcode ThreadCleanUp() override { return olc::rcode::OK; }
+	olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override { return olc::rcode::OK; }
+	olc::rcode CreateWindowPane(const olc::vi2d& vWindowPos, olc::vi2d& vWindowSize, bool bFullScreen) override { return olc::rcode::OK; }
+	olc::rcode SetWindowTitle(const std::string& s) override { return olc::rcode::OK; }
+	olc::rcode StartSystemEventLoop() override { return olc::rcode::OK; }
+	olc::rcode HandleSystemEvent() override { return olc::rcode::OK; }
+};
+
+class TessHeadlessRenderer : public olc::Renderer {
+public:
+	void PrepareDevice() override {}
+	olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) override { return olc::rcode::OK; }
+	olc::rcode DestroyDevice() override { return olc::rcode::OK; }
+	void DisplayFrame() override {}
+	void PrepareDrawing() override {}
+	void SetDecalMode(const olc::DecalMode& mode) override {}
+	void DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) override {}
+	void DrawDecal(const olc::DecalInstance& decal) override {}
+	uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true) override { return 1; }
+	void UpdateTexture(uint32_t id, olc::Sprite* spr) override {}
+	void ReadTexture(uint32_t id, olc::Sprite* spr) override {}
+	uint32_t DeleteTexture(const uint32_t id) override { return 1; }
+	void ApplyTexture(uint32_t id) override {}
+	void UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) override {}
+	void ClearBuffer(olc::Pixel p, bool bDepth) override {}
+};
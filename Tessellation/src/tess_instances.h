@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_instances.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Stamped copies of a patch of shapes. A patch is copied once into a
+	definition, its shapes placed about the patch centre, and each stamp of
+	it is only a reference to the definition, a place and a turn, with its
+	world bounds worked out when it is stamped. A hundred stamps of a
+	10,000 tile motif hold the motif's shapes once, and a few dozen bytes
+	per stamp.
+
+	Nothing is expanded up front. Drawing walks the stamps whose bounds
+	meet the view, and moves each definition shape into place as it is
+	drawn. A stamped shape is only made into a TessShape of its own when
+	it is asked for with expandShape(), such as the one nearest the mouse
+	for snapping to, or when the stamps are baked into placed shapes with
+	expandAll().
+
+	A definition stays alive as long as a stamp or the clipboard refers to
+	it.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+#include "tess_shape.h"
+#include "tess_geometry.h"
+
+#include <cfloat>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class TessInstances {
+public:
+	// The definition of a patch, its shapes placed about the patch centre
+	// at the origin
+	struct Patch {
+		std::vector<std::unique_ptr<TessShape>> upShapes;
+		olc::vf2d vMin = { 0.0f, 0.0f }; // Bounds of the shapes' outlines
+		olc::vf2d vMax = { 0.0f, 0.0f };
+	};
+
+	// A stamp of a patch, turned by rotation degrees about the patch centre
+	// and put at position
+	struct Instance {
+		std::shared_ptr<Patch> pPatch;
+		olc::vf2d position = { 0.0f, 0.0f };
+		float rotation = 0.0f;
+		olc::vf2d vMin = { 0.0f, 0.0f }; // World bounds
+		olc::vf2d vMax = { 0.0f, 0.0f };
+
+		TessTransform motion() const {
+			return TessTransform::translation(position) * TessTransform::rotation(rotation);
+		}
+	};
+
+	// Copy shapes into a new definition, centred on centre
+	static std::shared_ptr<Patch> makePatch(const std::vector<TessShape*>& pShapes, const olc::vf2d& centre) {
+		auto pPatch = std::make_shared<Patch>();
+		pPatch->upShapes.reserve(pShapes.size());
+		olc::vf2d vMin = { FLT_MAX, FLT_MAX };
+		olc::vf2d vMax = { -FLT_MAX, -FLT_MAX };
+		for (TessShape* pShape : pShapes) {
+			auto upShape = std::make_unique<TessShape>(*pShape);
+			upShape->moveTo(pShape->getCentroid() - centre);
+			for (const auto& point : upShape->getDrawPoints()) {
+				vMin = vMin.min(point);
+				vMax = vMax.max(point);
+			}
+			pPatch->upShapes.push_back(std::move(upShape));
+		}
+		if (!pPatch->upShapes.empty()) {
+			pPatch->vMin = vMin;
+			pPatch->vMax = vMax;
+		}
+		return pPatch;
+	}
+
+	size_t size() const { return instances_.size(); }
+	bool empty() const { return instances_.empty(); }
+	const Instance& operator[](size_t index) const { return instances_[index]; }
+
+	// Stamp pPatch, turned by rotation degrees and centred on position
+	void stamp(std::shared_ptr<Patch> pPatch, const olc::vf2d& position, float rotation) {
+		Instance instance;
+		instance.pPatch = std::move(pPatch);
+		instance.position = position;
+		instance.rotation = rotation;
+
+		// The turned corners of the patch bounds hold the turned patch
+		TessTransform motion = instance.motion();
+		const olc::vf2d& pMin = instance.pPatch->vMin;
+		const olc::vf2d& pMax = instance.pPatch->vMax;
+		olc::vf2d corners[4] = { pMin, { pMax.x, pMin.y }, pMax, { pMin.x, pMax.y } };
+		instance.vMin = { FLT_MAX, FLT_MAX };
+		instance.vMax = { -FLT_MAX, -FLT_MAX };
+		for (const auto& corner : corners) {
+			olc::vf2d point = motion.apply(corner);
+			instance.vMin = instance.vMin.min(point);
+			instance.vMax = instance.vMax.max(point);
+		}
+		instances_.push_back(std::move(instance));
+	}
+
+	// Remove the last stamp
+	void removeLast() {
+		if (!instances_.empty()) {
+			instances_.pop_back();
+		}
+	}
+
+	void clear() {
+		instances_.clear();
+	}
+
+	// Call fn(index, instance) for each stamp whose bounds meet the rectangle
+	template <typename Fn>
+	void forEachVisible(const olc::vf2d& worldTL, const olc::vf2d& worldBR, Fn fn) const {
+		for (size_t i = 0; i < instances_.size(); ++i) {
+			const Instance& instance = instances_[i];
+			if (instance.vMax.x < worldTL.x || instance.vMin.x > worldBR.x || instance.vMax.y < worldTL.y || instance.vMin.y > worldBR.y) {
+				continue;
+			}
+			fn(i, instance);
+		}
+	}
+
+	// A copy of shape k of a stamp, moved and turned into place
+	static std::unique_ptr<TessShape> expandShape(const Instance& instance, size_t k) {
+		TessShape& shape = *instance.pPatch->upShapes[k];
+		auto upShape = std::make_unique<TessShape>(shape);
+		upShape->rotate(instance.rotation);
+		upShape->moveTo(instance.motion().apply(shape.getCentroid()));
+		return upShape;
+	}
+
+	// Copies of the shapes of every stamp, in the order they were stamped
+	std::vector<std::unique_ptr<TessShape>> expandAll() const {
+		size_t count = 0;
+		for (const auto& instance : instances_) {
+			count += instance.pPatch->upShapes.size();
+		}
+		std::vector<std::unique_ptr<TessShape>> upShapes;
+		upShapes.reserve(count);
+		for (const auto& instance : instances_) {
+			for (size_t k = 0; k < instance.pPatch->upShapes.size(); ++k) {
+				upShapes.push_back(expandShape(instance, k));
+			}
+		}
+		return upShapes;
+	}
+
+private:
+	std::vector<Instance> instances_;
+};
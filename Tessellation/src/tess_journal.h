@@ -0,0 +1,1030 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_journal.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	An append-only journal of the edits made to the placed shapes since the
+	scene was last saved, kept next to the .tess file so an edit is saved by
+	appending a few dozen bytes rather than rewriting the scene.
+
+	The journal starts with a header naming the scene file it applies to,
+	by that file's checksum, followed by records of these kinds:
+
+		Add          A shape added at the end of the placed shapes
+		RemoveFrom   The placed shapes from an index onward removed
+		SetColor     The fill color of a run of consecutive placed shapes
+		             changed (older journals only have runs of one)
+		Moved        The rest of the edits are in the journal of a new scene file
+		Replace      The placed shape at an index moved or turned, stored as
+		             an Add record is
+		Swap         Two placed shapes changed places, so one can be erased
+		             from the middle by swapping it to the end
+
+	Each record is written to the file as soon as it is made, so a crash of
+	the program loses nothing. The file is synced to disk on a background
+	thread at most SYNC_SECONDS after a write, so a power cut loses at most
+	that much. Every record carries a checksum; loading replays the journal
+	on top of the scene and stops at the first torn or damaged record.
+
+	The scene is saved in the background every AUTOSAVE_SECONDS, when
+	asked to, and whenever the journal passes COMPACT_BYTES. The scene file
+	and the journal up to its current length are a snapshot of the placed
+	shapes that editing never changes, as the file is only ever replaced
+	and the journal only appended to, so taking one costs nothing. A worker
+	thread replays the snapshot and writes the result as a new scene file,
+	and the records appended in the meantime are carried over into a fresh
+	journal for the new scene. The main thread only switches its appends
+	to the fresh journal, leaving a Moved record in the old one; both files
+	are renamed into place on the sync thread, and recover() completes a
+	replacement a crash interrupted.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_scene_file.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !defined(TESS_NO_THREADS)
+	#include <condition_variable>
+	#include <mutex>
+	#include <thread>
+#endif
+
+class TessJournal {
+public:
+	using VertexRecord = TessSceneFile::VertexRecord;
+	using TileRecord = TessSceneFile::TileRecord;
+#if defined(_WIN32)
+	using FileHandle = HANDLE;
+	static inline const HANDLE NO_FILE = INVALID_HANDLE_VALUE;
+#else
+	using FileHandle = int;
+	static constexpr int NO_FILE = -1;
+#endif
+
+	static constexpr uint32_t VERSION = 1;
+	static constexpr float SYNC_SECONDS = 0.25f;                  // Longest a written record waits to be synced
+	static constexpr uint64_t COMPACT_BYTES = 32ull * 1024 * 1024; // Journal size that starts a save
+	static constexpr float AUTOSAVE_SECONDS = 30.0f;              // Longest edits wait to be saved into the scene file
+	static constexpr size_t ENCODE_SHAPES = 65536;                // Shapes of a batch encoded, in parallel, between writes
+
+	enum class RecordType : uint8_t {
+		Add = 1,
+		RemoveFrom = 2,
+		SetColor = 3,
+		Moved = 4,
+		Replace = 5,
+		Swap = 6
+	};
+
+	struct Header {
+		char magic[4];            // "TESJ"
+		uint32_t version;
+		uint64_t base;            // Checksum of the scene file the journal applies to, 0 if there is none
+	};
+
+	struct RecordHeader {
+		uint32_t size;            // Bytes of the record after this header
+		uint8_t type;             // RecordType
+		uint8_t reserved[3];
+		uint64_t checksum;        // FNV-1a of this header, with checksum 0, and the record
+	};
+
+	struct AddRecord {
+		int32_t shapeType;        // Prototype id, or CUSTOM_SHAPE
+		int32_t x;                // Centroid, in .tess units
+		int32_t y;
+		int32_t rotation;         // In .tess units
+		uint32_t color;           // olc::Pixel value, olc::BLANK if unfilled
+		uint32_t vertexCount;     // VertexRecords of the unrotated outline that follow
+	};
+
+	struct RemoveRecord {
+		uint64_t begin;
+	};
+
+	struct SwapRecord {
+		uint64_t a;
+		uint64_t b;
+	};
+
+	struct ColorRecord {
+		uint64_t index;
+		uint32_t color;
+		uint32_t more;     // Shapes after index that changed to color too
+	};
+
+	struct MovedRecord {
+		uint64_t base;            // Checksum of the scene file the rest of the journal applies to
+	};
+
+	struct ReplaceRecord {
+		uint64_t index;
+		AddRecord add;            // The shape now at index, followed by its outline
+	};
+
+	static_assert(sizeof(Header) == 16 && sizeof(RecordHeader) == 16 && sizeof(AddRecord) == 24 && sizeof(RemoveRecord) == 8 &&
+		sizeof(ColorRecord) == 16 && sizeof(MovedRecord) == 8 && sizeof(ReplaceRecord) == 32 && sizeof(SwapRecord) == 16, "The journal records must match the file layout");
+
+	TessJournal() {}
+	TessJournal(const TessJournal&) = delete;
+	TessJournal& operator=(const TessJournal&) = delete;
+
+	~TessJournal() {
+		close();
+	}
+
+	static std::string pathFor(const std::string& scenePath) {
+		return scenePath + ".journal";
+	}
+
+	// Finish replacing the scene at scenePath and its journal if a crash
+	// interrupted it, or delete the leftovers of an unfinished save. The new
+	// files are only kept if the old journal says it moved to them.
+	static void recover(const std::string& scenePath) {
+		std::error_code ec;
+		std::string journalPath = pathFor(scenePath);
+		std::string tempPath = journalPath + ".tmp";
+		std::string newScenePath = compactPath(scenePath);
+		std::filesystem::remove(newScenePath + ".tmp", ec);
+		if (std::filesystem::exists(tempPath)) {
+			Header header = {};
+			std::ifstream in(tempPath, std::ios::binary);
+			bool valid = in.read((char*)&header, sizeof(header)) && std::memcmp(header.magic, "TESJ", 4) == 0;
+			in.close();
+			if (!std::filesystem::exists(newScenePath)) {
+				valid = valid && header.base == sceneChecksum(scenePath);
+			}
+			else if (valid && header.base == sceneChecksum(newScenePath) && movedTo(journalPath) == header.base) {
+				std::filesystem::rename(newScenePath, scenePath, ec);
+				valid = !ec;
+			}
+			else {
+				valid = false;
+			}
+			if (valid) {
+				std::filesystem::rename(tempPath, journalPath, ec);
+			}
+			else {
+				std::filesystem::remove(tempPath, ec);
+			}
+		}
+		std::filesystem::remove(newScenePath, ec);
+	}
+
+	// Read the scene at scenePath into tables and tiles, then replay up to
+	// journalLimit bytes of its journal on top. A missing scene is empty, and
+	// a journal for another scene is ignored. base receives the scene's
+	// checksum and journalLength the length of the journal's valid part, 0 if
+	// there is none. Returns false if the scene can't be read.
+	static bool load(const std::string& scenePath, uint64_t journalLimit, TessSceneFile::Tables& tables, std::vector<TileRecord>& tiles,
+		uint64_t& base, uint64_t& journalLength, std::string& error, const std::atomic<bool>* pCancel = nullptr) {
+		tables = TessSceneFile::Tables();
+		tiles.clear();
+		base = 0;
+		journalLength = 0;
+		if (std::filesystem::exists(scenePath)) {
+			TessSceneFile file;
+			if (!file.open(scenePath, error)) {
+				return false;
+			}
+			const TessSceneFile::Header& header = file.header();
+			tables.assign(file.prototypes(), header.prototypeCount, file.vertices(), header.vertexCount, file.palette(), header.paletteCount);
+			file.expandTiles(tiles);
+			base = header.checksum;
+		}
+
+		TessMappedFile journal;
+		if (!journal.open(pathFor(scenePath))) {
+			return true;
+		}
+		const uint8_t* pData = journal.data();
+		uint64_t limit = std::min<uint64_t>(journal.size(), journalLimit);
+		Header header;
+		if (limit < sizeof(Header)) {
+			return true;
+		}
+		std::memcpy(&header, pData, sizeof(header));
+		if (std::memcmp(header.magic, "TESJ", 4) != 0 || header.version != VERSION || header.base != base) {
+			return true;
+		}
+
+		std::string recordError;
+		uint64_t offset = sizeof(Header);
+		while (limit - offset >= sizeof(RecordHeader)) {
+			if (pCancel && *pCancel) {
+				error = "Cancelled";
+				return false;
+			}
+			RecordHeader record;
+			std::memcpy(&record, pData + offset, sizeof(record));
+			if (record.size > limit - offset - sizeof(RecordHeader) || recordChecksum(record, pData + offset + sizeof(RecordHeader)) != record.checksum ||
+				!apply(record, pData + offset + sizeof(RecordHeader), tables, tiles, recordError)) {
+				break;
+			}
+			offset += sizeof(RecordHeader) + record.size;
+		}
+		journalLength = offset;
+		return true;
+	}
+
+	// Start appending to the journal of the scene at scenePath, whose checksum
+	// is base, keeping its first length bytes as load() found them. A length
+	// of 0 starts a new journal.
+	bool open(const std::string& scenePath, uint64_t base, uint64_t length, std::string& error) {
+		close();
+		scenePath_ = scenePath;
+		base_ = base;
+		std::string journalPath = pathFor(scenePath);
+		if (length < sizeof(Header)) {
+			if (!writeTemp(base, nullptr, 0, error) || !replace(journalPath + ".tmp", journalPath, error)) {
+				return false;
+			}
+			length = sizeof(Header);
+		}
+		FileHandle file;
+		if (!openFile(journalPath, length, file)) {
+			error = "Could not open " + journalPath;
+			return false;
+		}
+		setFile(file);
+		size_ = length;
+		unsynced_ = false;
+		syncTime_ = 0.0f;
+		autosaveTime_ = 0.0f;
+		saveRequested_ = false;
+		error_.clear();
+#if !defined(TESS_NO_THREADS)
+		stop_ = false;
+		syncRequested_ = false;
+		syncThread_ = std::thread([this]() { runSync(); });
+#endif
+		return true;
+	}
+
+	// Stop any save still writing the scene, finish one being swapped in,
+	// sync what was written and close the file
+	void close() {
+		if (!isOpen()) {
+			return;
+		}
+		cancelCompaction();
+#if !defined(TESS_NO_THREADS)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		syncThread_.join();
+#endif
+		swapping_ = false;
+		syncFile();
+		closeHandle(setFile(NO_FILE));
+	}
+
+	bool isOpen() const {
+		return file_ != NO_FILE;
+	}
+
+	const std::string& scenePath() const { return scenePath_; }
+	uint64_t size() const { return size_; }
+	bool isSaving() const { return compacting_ || swapping_; }
+
+	// Save the scene in the background, reporting from update() when done
+	void save() {
+		saveRequested_ = true;
+	}
+
+	// Record shapes added at the end of the placed shapes
+	void appendAdd(TessShape& shape) {
+		if (!isOpen()) {
+			return;
+		}
+		encodeAdd(shape, buffer_, outline_);
+		writeBuffer();
+	}
+
+	void appendAdd(const std::vector<std::unique_ptr<TessShape>>& upShapes) {
+		appendParallel(upShapes.size(), [&](size_t i, std::vector<uint8_t>& buffer, std::vector<VertexRecord>& outline) {
+			encodeAdd(*upShapes[i], buffer, outline);
+		});
+	}
+
+	// Record the removal of the placed shapes from index begin onward
+	void appendRemoveFrom(uint64_t begin) {
+		RemoveRecord remove = { begin };
+		encodeRecord(buffer_, RecordType::RemoveFrom, &remove, sizeof(remove), nullptr, 0);
+		writeBuffer();
+	}
+
+	// Record two placed shapes changing places
+	void appendSwap(uint64_t a, uint64_t b) {
+		SwapRecord swap = { a, b };
+		encodeRecord(buffer_, RecordType::Swap, &swap, sizeof(swap), nullptr, 0);
+		writeBuffer();
+	}
+
+	// Record a new fill color of the placed shapes index .. index + count - 1,
+	// written out in one go
+	void appendSetColor(uint64_t index, const olc::Pixel& color, uint64_t count = 1) {
+		if (!isOpen()) {
+			return;
+		}
+		encodeColor(buffer_, index, color, count);
+		writeBuffer();
+	}
+
+	// Record new fill colors of count runs of placed shapes, encoded in
+	// parallel. run(i, index, color, count) gives run i.
+	template <typename Run>
+	void appendSetColors(size_t count, Run run) {
+		appendParallel(count, [&](size_t i, std::vector<uint8_t>& buffer, std::vector<VertexRecord>&) {
+			uint64_t index = 0;
+			olc::Pixel color;
+			uint64_t runCount = 0;
+			run(i, index, color, runCount);
+			encodeColor(buffer, index, color, runCount);
+		});
+	}
+
+	// Record the new place and rotation of the placed shapes at indices
+	void appendReplace(const std::vector<std::unique_ptr<TessShape>>& upShapes, const std::vector<size_t>& indices) {
+		appendParallel(indices.size(), [&](size_t i, std::vector<uint8_t>& buffer, std::vector<VertexRecord>& outline) {
+			ReplaceRecord replace = {};
+			replace.index = indices[i];
+			encodeShape(*upShapes[indices[i]], replace.add, outline);
+			encodeRecord(buffer, RecordType::Replace, &replace, sizeof(replace), outline.data(), outline.size() * sizeof(VertexRecord));
+		});
+	}
+
+	// Start an empty journal for the scene file just saved, whose checksum is
+	// base. The scene file is synced first, so the old journal is only
+	// dropped once the scene it was folded into is on disk.
+	bool reset(uint64_t base, std::string& error) {
+		if (!isOpen()) {
+			return true;
+		}
+		std::string scenePath = scenePath_;
+		close();
+		syncPath(scenePath);
+		return open(scenePath, base, 0, error);
+	}
+
+	// Sync recent writes, and start or finish a save. Returns true with a
+	// message in status when a save finishes or a write fails.
+	bool update(float fElapsedTime, std::string& status) {
+		if (!isOpen()) {
+			return false;
+		}
+		if (!error_.empty()) {
+			status = error_;
+			error_.clear();
+			return true;
+		}
+
+		syncTime_ += fElapsedTime;
+		if (unsynced_ && syncTime_ >= SYNC_SECONDS) {
+			unsynced_ = false;
+			syncTime_ = 0.0f;
+#if defined(TESS_NO_THREADS)
+			syncFile();
+#else
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				syncRequested_ = true;
+			}
+			wake_.notify_all();
+#endif
+		}
+
+		// Autosave once there are edits to save
+		if (size_ > sizeof(Header)) {
+			autosaveTime_ += fElapsedTime;
+		}
+		if (!isSaving() && (saveRequested_ || size_ >= COMPACT_BYTES || autosaveTime_ >= AUTOSAVE_SECONDS)) {
+			startCompaction();
+		}
+		if (compacting_ && compactDone_) {
+			return finishCompaction(status);
+		}
+		if (swapping_ && swapDone_) {
+			swapping_ = false;
+			status = swapError_.empty() ? (savedOnRequest_ ? "Saved " : "Autosaved ") + scenePath_ : swapError_;
+			return true;
+		}
+		return false;
+	}
+
+private:
+	std::string scenePath_;
+	uint64_t base_ = 0;
+	std::atomic<uint64_t> size_ = 0; // Bytes written to the file, read by the save thread
+	std::vector<uint8_t> buffer_;  // Records encoded but not yet written
+	std::vector<VertexRecord> outline_;
+	bool unsynced_ = false;
+	float syncTime_ = 0.0f;
+	std::string error_;
+	FileHandle file_ = NO_FILE;
+
+	// Saves, written by compactThread_ and swapped in by the sync thread
+	float autosaveTime_ = 0.0f;    // Time the oldest unsaved edit has waited
+	bool saveRequested_ = false;
+	bool savedOnRequest_ = false;
+	bool compacting_ = false;
+	std::atomic<bool> compactDone_ = false;
+	std::atomic<bool> cancel_ = false;
+	uint64_t compactLimit_ = 0;    // Journal bytes folded into the new scene
+	uint64_t compactTailEnd_ = 0;  // Journal bytes after it copied into the new journal
+	uint64_t compactBase_ = 0;     // Checksum of the new scene
+	bool compactOk_ = false;
+	std::string compactError_;
+	bool swapping_ = false;
+	std::atomic<bool> swapDone_ = false;
+	std::string swapError_;
+
+#if !defined(TESS_NO_THREADS)
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stop_ = false;
+	bool syncRequested_ = false;
+	bool swapRequested_ = false;
+	std::vector<FileHandle> retired_; // Handles to sync and close off the main thread
+	std::thread syncThread_;
+	std::thread compactThread_;
+#endif
+
+	static std::string compactPath(const std::string& scenePath) {
+		return scenePath + ".compact";
+	}
+
+	// The checksum in the header of a scene file, 0 if there is none
+	static uint64_t sceneChecksum(const std::string& scenePath) {
+		TessSceneFile::Header header = {};
+		std::ifstream in(scenePath, std::ios::binary);
+		if (!in.read((char*)&header, sizeof(header))) {
+			return 0;
+		}
+		return header.checksum;
+	}
+
+	// The scene checksum in the Moved record of the journal at journalPath, 0
+	// if it has none
+	static uint64_t movedTo(const std::string& journalPath) {
+		TessMappedFile journal;
+		if (!journal.open(journalPath) || journal.size() < sizeof(Header)) {
+			return 0;
+		}
+		const uint8_t* pData = journal.data();
+		uint64_t offset = sizeof(Header);
+		while (journal.size() - offset >= sizeof(RecordHeader)) {
+			RecordHeader record;
+			std::memcpy(&record, pData + offset, sizeof(record));
+			if (record.size > journal.size() - offset - sizeof(RecordHeader)) {
+				break;
+			}
+			if ((RecordType)record.type == RecordType::Moved && record.size == sizeof(MovedRecord) &&
+				recordChecksum(record, pData + offset + sizeof(RecordHeader)) == record.checksum) {
+				MovedRecord moved;
+				std::memcpy(&moved, pData + offset + sizeof(RecordHeader), sizeof(moved));
+				return moved.base;
+			}
+			offset += sizeof(RecordHeader) + record.size;
+		}
+		return 0;
+	}
+
+	static uint64_t recordChecksum(RecordHeader record, const uint8_t* pData) {
+		record.checksum = 0;
+		uint64_t hash = TessSceneFile::checksum(TessSceneFile::FNV_OFFSET, &record, sizeof(record));
+		return TessSceneFile::checksum(hash, pData, record.size);
+	}
+
+	// Apply one record to a scene's tables and tiles. False if it doesn't
+	// make sense, which ends the replay.
+	static bool apply(const RecordHeader& record, const uint8_t* pData, TessSceneFile::Tables& tables, std::vector<TileRecord>& tiles,
+		std::string& error) {
+		switch ((RecordType)record.type) {
+			case RecordType::Add: {
+				AddRecord add;
+				if (record.size < sizeof(add)) {
+					return false;
+				}
+				std::memcpy(&add, pData, sizeof(add));
+				if (record.size != sizeof(add) + (uint64_t)add.vertexCount * sizeof(VertexRecord)) {
+					return false;
+				}
+				TileRecord tile;
+				if (!tables.encode(add.shapeType, (const VertexRecord*)(pData + sizeof(add)), add.vertexCount, { add.x, add.y },
+					add.rotation, add.color, tile, error)) {
+					return false;
+				}
+				tiles.push_back(tile);
+				return true;
+			}
+			case RecordType::RemoveFrom: {
+				RemoveRecord remove;
+				if (record.size != sizeof(remove)) {
+					return false;
+				}
+				std::memcpy(&remove, pData, sizeof(remove));
+				tiles.resize(std::min<uint64_t>(remove.begin, tiles.size()));
+				return true;
+			}
+			case RecordType::Swap: {
+				SwapRecord swap;
+				if (record.size != sizeof(swap)) {
+					return false;
+				}
+				std::memcpy(&swap, pData, sizeof(swap));
+				if (swap.a >= tiles.size() || swap.b >= tiles.size()) {
+					return false;
+				}
+				std::swap(tiles[swap.a], tiles[swap.b]);
+				return true;
+			}
+			case RecordType::SetColor: {
+				ColorRecord color;
+				if (record.size != sizeof(color)) {
+					return false;
+				}
+				std::memcpy(&color, pData, sizeof(color));
+				if (color.index >= tiles.size() || tiles.size() - color.index <= color.more) {
+					return false;
+				}
+				for (uint64_t i = color.index; i <= color.index + color.more; ++i) {
+					if (!tables.encodeColor(color.color, tiles[i].color, error)) {
+						return false;
+					}
+				}
+				return true;
+			}
+			case RecordType::Moved:
+				return false; // Nothing after it applies to this scene
+			case RecordType::Replace: {
+				ReplaceRecord replace;
+				if (record.size < sizeof(replace)) {
+					return false;
+				}
+				std::memcpy(&replace, pData, sizeof(replace));
+				const AddRecord& add = replace.add;
+				if (record.size != sizeof(replace) + (uint64_t)add.vertexCount * sizeof(VertexRecord) || replace.index >= tiles.size()) {
+					return false;
+				}
+				return tables.encode(add.shapeType, (const VertexRecord*)(pData + sizeof(replace)), add.vertexCount, { add.x, add.y },
+					add.rotation, add.color, tiles[replace.index], error);
+			}
+		}
+		return false;
+	}
+
+	// Encode a shape as an Add record the way TessSceneFile::Tables stores
+	// it, at the end of buffer. outline is scratch space.
+	static void encodeAdd(TessShape& shape, std::vector<uint8_t>& buffer, std::vector<VertexRecord>& outline) {
+		AddRecord add = {};
+		encodeShape(shape, add, outline);
+		encodeRecord(buffer, RecordType::Add, &add, sizeof(add), outline.data(), outline.size() * sizeof(VertexRecord));
+	}
+
+	// Append count records, encoding record i with encode(i, buffer, outline).
+	// Each thread encodes a slice of them, and the slices are written in
+	// order.
+	template <typename Encode>
+	void appendParallel(size_t count, Encode encode) {
+		if (!isOpen()) {
+			return;
+		}
+		std::vector<std::vector<uint8_t>> buffers(tessThreadCount());
+		for (size_t begin = 0; begin < count; begin += ENCODE_SHAPES) {
+			size_t end = std::min(count, begin + ENCODE_SHAPES);
+			size_t slice = (end - begin + buffers.size() - 1) / buffers.size();
+			tessParallelFor(buffers.size(), 1, [&](size_t first, size_t last) {
+				std::vector<VertexRecord> outline;
+				for (size_t t = first; t < last; ++t) {
+					for (size_t i = begin + t * slice; i < std::min(end, begin + (t + 1) * slice); ++i) {
+						encode(i, buffers[t], outline);
+					}
+				}
+			});
+			for (auto& buffer : buffers) {
+				buffer_.swap(buffer);
+				writeBuffer();
+			}
+		}
+	}
+
+	// Append the SetColor records of the shapes index .. index + count - 1
+	static void encodeColor(std::vector<uint8_t>& buffer, uint64_t index, const olc::Pixel& color, uint64_t count) {
+		while (count > 0) {
+			uint64_t run = std::min<uint64_t>(count, (uint64_t)UINT32_MAX + 1);
+			ColorRecord record = { index, color.n, (uint32_t)(run - 1) };
+			encodeRecord(buffer, RecordType::SetColor, &record, sizeof(record), nullptr, 0);
+			index += run;
+			count -= run;
+		}
+	}
+
+	// Fill in the Add record of a shape and the outline that follows it
+	static void encodeShape(TessShape& shape, AddRecord& add, std::vector<VertexRecord>& outline) {
+		outline.clear();
+		if (shape.getPrototype() >= 0) {
+			add.shapeType = shape.getPrototype();
+			add.rotation = (int32_t)std::lround(shape.getRotation() * TessSceneFile::ROTATION_SCALE);
+			for (const auto& point : shape.getOutline()) {
+				outline.push_back(TessSceneFile::quantize(point));
+			}
+		}
+		else {
+			add.shapeType = TessSceneFile::CUSTOM_SHAPE;
+			olc::vf2d centroid = shape.getCentroid();
+			for (const auto& point : shape.getDrawPoints()) {
+				outline.push_back(TessSceneFile::quantize(point - centroid));
+			}
+		}
+		VertexRecord position = TessSceneFile::quantize(shape.getCentroid());
+		add.x = position.x;
+		add.y = position.y;
+		add.color = shape.getColor().n;
+		add.vertexCount = (uint32_t)outline.size();
+	}
+
+	static void encodeRecord(std::vector<uint8_t>& buffer, RecordType type, const void* pFirst, size_t firstSize, const void* pSecond,
+		size_t secondSize) {
+		size_t offset = buffer.size();
+		buffer.resize(offset + sizeof(RecordHeader) + firstSize + secondSize);
+		uint8_t* pData = buffer.data() + offset + sizeof(RecordHeader);
+		std::memcpy(pData, pFirst, firstSize);
+		if (secondSize > 0) {
+			std::memcpy(pData + firstSize, pSecond, secondSize);
+		}
+		RecordHeader record = {};
+		record.size = (uint32_t)(firstSize + secondSize);
+		record.type = (uint8_t)type;
+		record.checksum = recordChecksum(record, pData);
+		std::memcpy(buffer.data() + offset, &record, sizeof(record));
+	}
+
+	// Write the encoded records to the file
+	void writeBuffer() {
+		if (buffer_.empty() || !isOpen()) {
+			buffer_.clear();
+			return;
+		}
+		if (!writeFile(file_, buffer_.data(), buffer_.size())) {
+			error_ = "Could not write " + pathFor(scenePath_);
+		}
+		size_ += buffer_.size();
+		unsynced_ = true;
+		buffer_.clear();
+	}
+
+	// Write a journal for the scene with checksum base, holding the records
+	// in pTail, to the temporary file next to the journal, and sync it
+	bool writeTemp(uint64_t base, const uint8_t* pTail, size_t tailSize, std::string& error) {
+		std::string tempPath = pathFor(scenePath_) + ".tmp";
+		Header header = {};
+		std::memcpy(header.magic, "TESJ", 4);
+		header.version = VERSION;
+		header.base = base;
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			out.write((const char*)&header, sizeof(header));
+			if (tailSize > 0) {
+				out.write((const char*)pTail, tailSize);
+			}
+			if (!out) {
+				error = "Could not write " + tempPath;
+				return false;
+			}
+		}
+		syncPath(tempPath);
+		return true;
+	}
+
+	static bool replace(const std::string& from, const std::string& to, std::string& error) {
+		std::error_code ec;
+		std::filesystem::rename(from, to, ec);
+		if (ec) {
+			error = "Could not replace " + to + ": " + ec.message();
+			return false;
+		}
+		return true;
+	}
+
+	// ***************************
+	// Saving
+	// ***************************
+
+	void startCompaction() {
+		compacting_ = true;
+		savedOnRequest_ = saveRequested_;
+		saveRequested_ = false;
+		autosaveTime_ = 0.0f;
+		compactDone_ = false;
+		cancel_ = false;
+		compactLimit_ = size_;
+#if defined(TESS_NO_THREADS)
+		compact();
+#else
+		compactThread_ = std::thread([this]() { compact(); });
+#endif
+	}
+
+	// Fold the journal up to compactLimit_ into a new scene file, then start
+	// the new journal with the records appended so far. Runs on the
+	// compaction thread, reading only the files.
+	void compact() {
+		TessSceneFile::Tables tables;
+		std::vector<TileRecord> tiles;
+		uint64_t base = 0;
+		uint64_t length = 0;
+		std::string error;
+		std::string path = compactPath(scenePath_);
+		compactOk_ = load(scenePath_, compactLimit_, tables, tiles, base, length, error, &cancel_) && base == base_ &&
+			TessSceneFile::write(path, tables, tiles, error, &compactBase_);
+		if (compactOk_) {
+			syncPath(path);
+			compactLimit_ = length;
+			compactTailEnd_ = size_;
+			std::vector<uint8_t> tail;
+			compactOk_ = readJournal(compactLimit_, compactTailEnd_, tail) && writeTemp(compactBase_, tail.data(), tail.size(), error);
+		}
+		if (!compactOk_) {
+			compactError_ = error.empty() ? "Could not save " + scenePath_ : error;
+		}
+		compactDone_ = true;
+	}
+
+	// Switch the appends to the new journal, adding the few records appended
+	// since the compaction thread copied the others, and end the old one
+	// with a Moved record. Renaming the files into place is left to the sync
+	// thread; until then the new journal is written under its temporary name.
+	bool finishCompaction(std::string& status) {
+#if !defined(TESS_NO_THREADS)
+		compactThread_.join();
+#endif
+		compacting_ = false;
+		std::string journalPath = pathFor(scenePath_);
+		std::string tempPath = journalPath + ".tmp";
+		uint64_t length = sizeof(Header) + (compactTailEnd_ - compactLimit_);
+		std::vector<uint8_t> extra;
+		FileHandle file = NO_FILE;
+		if (compactOk_ && !readJournal(compactTailEnd_, size_, extra)) {
+			compactOk_ = false;
+			compactError_ = "Could not read " + journalPath;
+		}
+		if (compactOk_ && (!openFile(tempPath, length, file) || !writeFile(file, extra.data(), extra.size()))) {
+			closeHandle(file);
+			compactOk_ = false;
+			compactError_ = "Could not write " + tempPath;
+		}
+		if (!compactOk_) {
+			std::error_code ec;
+			std::filesystem::remove(compactPath(scenePath_), ec);
+			std::filesystem::remove(tempPath, ec);
+			status = compactError_;
+			return true;
+		}
+
+		MovedRecord moved = { compactBase_ };
+		encodeRecord(buffer_, RecordType::Moved, &moved, sizeof(moved), nullptr, 0);
+		writeBuffer();
+		retire(setFile(file));
+		base_ = compactBase_;
+		size_ = length + extra.size();
+		unsynced_ = true;
+		swapping_ = true;
+		swapDone_ = false;
+#if defined(TESS_NO_THREADS)
+		swapFiles();
+#else
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			swapRequested_ = true;
+		}
+		wake_.notify_all();
+#endif
+		return false;
+	}
+
+	// Rename the new scene file and journal into place, on the sync thread.
+	// The old journal has moved, so recover() would finish this if the
+	// program stopped part way.
+	void swapFiles() {
+		std::string journalPath = pathFor(scenePath_);
+		std::string error;
+		if (replace(compactPath(scenePath_), scenePath_, error)) {
+			replace(journalPath + ".tmp", journalPath, error);
+		}
+		swapError_ = error;
+		swapDone_ = true;
+	}
+
+	// Read bytes [begin, end) of the journal
+	bool readJournal(uint64_t begin, uint64_t end, std::vector<uint8_t>& data) const {
+		data.resize(end - begin);
+		if (data.empty()) {
+			return true;
+		}
+		std::ifstream in(pathFor(scenePath_), std::ios::binary);
+		in.seekg(begin);
+		return (bool)in.read((char*)data.data(), data.size());
+	}
+
+	void cancelCompaction() {
+		if (!compacting_) {
+			return;
+		}
+		cancel_ = true;
+#if !defined(TESS_NO_THREADS)
+		compactThread_.join();
+#endif
+		compacting_ = false;
+		std::error_code ec;
+		std::filesystem::remove(compactPath(scenePath_), ec);
+		std::filesystem::remove(pathFor(scenePath_) + ".tmp", ec);
+	}
+
+	// ***************************
+	// File access
+	// ***************************
+
+#if !defined(TESS_NO_THREADS)
+	// Sync the file whenever update() asks, swap in a saved scene, and sync
+	// and close retired handles, off the main thread. The lock is only held
+	// to pick up the work, so appends and update() never wait for the disk.
+	void runSync() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true) {
+			wake_.wait(lock, [this]() { return stop_ || syncRequested_ || swapRequested_ || !retired_.empty(); });
+			bool sync = syncRequested_ && !stop_;
+			bool swap = swapRequested_;
+			syncRequested_ = false;
+			swapRequested_ = false;
+			FileHandle file = file_;
+			std::vector<FileHandle> retired;
+			retired.swap(retired_);
+			bool stop = stop_;
+			lock.unlock();
+			if (swap) {
+				swapFiles();
+			}
+			if (sync) {
+				syncHandle(file);
+			}
+			for (FileHandle handle : retired) {
+				syncHandle(handle);
+				closeHandle(handle);
+			}
+			if (stop) {
+				return;
+			}
+			lock.lock();
+		}
+	}
+#endif
+
+	// Open a journal for appending, cut to length bytes
+	static bool openFile(const std::string& path, uint64_t length, FileHandle& file) {
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER position;
+		position.QuadPart = (LONGLONG)length;
+		if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+			CloseHandle(file);
+			file = NO_FILE;
+			return false;
+		}
+#else
+		file = ::open(path.c_str(), O_WRONLY);
+		if (file < 0) {
+			return false;
+		}
+		if (ftruncate(file, (off_t)length) != 0 || lseek(file, 0, SEEK_END) < 0) {
+			::close(file);
+			file = NO_FILE;
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	// Make file the one appended to, returning the one it replaces
+	FileHandle setFile(FileHandle file) {
+#if !defined(TESS_NO_THREADS)
+		std::lock_guard<std::mutex> lock(mutex_);
+#endif
+		std::swap(file, file_);
+		return file;
+	}
+
+	static bool writeFile(FileHandle file, const uint8_t* pData, size_t size) {
+#if defined(_WIN32)
+		while (size > 0) {
+			DWORD written = 0;
+			if (!WriteFile(file, pData, (DWORD)std::min<size_t>(size, 1u << 30), &written, nullptr)) {
+				return false;
+			}
+			pData += written;
+			size -= written;
+		}
+#else
+		while (size > 0) {
+			ssize_t written = ::write(file, pData, size);
+			if (written < 0) {
+				return false;
+			}
+			pData += written;
+			size -= (size_t)written;
+		}
+#endif
+		return true;
+	}
+
+	static void syncHandle(FileHandle file) {
+		if (file == NO_FILE) {
+			return;
+		}
+#if defined(_WIN32)
+		FlushFileBuffers(file);
+#else
+		fsync(file);
+#endif
+	}
+
+	// Sync on the calling thread, when there is no sync thread
+	void syncFile() {
+		syncHandle(file_);
+	}
+
+	// Let go of a handle that is no longer appended to. The sync thread
+	// syncs and closes it, so the main thread neither waits for the disk nor
+	// pays for freeing a replaced file, which happens on its last close.
+	void retire(FileHandle file) {
+#if defined(TESS_NO_THREADS)
+		syncHandle(file);
+		closeHandle(file);
+#else
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			retired_.push_back(file);
+		}
+		wake_.notify_all();
+#endif
+	}
+
+	static void closeHandle(FileHandle file) {
+		if (file == NO_FILE) {
+			return;
+		}
+#if defined(_WIN32)
+		CloseHandle(file);
+#else
+		::close(file);
+#endif
+	}
+
+	// Sync a file that was written through a stream
+	static void syncPath(const std::string& path) {
+#if defined(_WIN32)
+		HANDLE hFile = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hFile != INVALID_HANDLE_VALUE) {
+			FlushFileBuffers(hFile);
+			CloseHandle(hFile);
+		}
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd >= 0) {
+			fsync(fd);
+			::close(fd);
+		}
+#endif
+	}
+};
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_parallel.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A minimal parallel for loop. The index range is split into contiguous
+	chunks, one per hardware thread, and each chunk runs on its own
+	std::thread. Small ranges, and builds without thread support (the
+	Emscripten build unless it is compiled with pthreads), run inline on the
+	calling thread.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define TESS_NO_THREADS
+#endif
+
+// Number of worker threads tessParallelFor() uses
+inline unsigned tessThreadCount() {
+#ifdef TESS_NO_THREADS
+	return 1;
+#else
+	return std::max(1u, std::thread::hardware_concurrency());
+#endif
+}
+
+// Call fn(begin, end) over [0, count), split into contiguous chunks that run in
+// parallel. Ranges shorter than minChunk per thread aren't worth a thread and
+// run inline. fn must be safe to call concurrently on disjoint ranges.
+template <typename Fn>
+void tessParallelFor(size_t count, size_t minChunk, Fn fn) {
+	size_t threads = std::min<size_t>(tessThreadCount(), (count + minChunk - 1) / std::max<size_t>(minChunk, 1));
+	if (threads <= 1) {
+		if (count > 0) {
+			fn((size_t)0, count);
+		}
+		return;
+	}
+
+#ifndef TESS_NO_THREADS
+	size_t chunk = (count + threads - 1) / threads;
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t t = 1; t < threads; ++t) {
+		size_t begin = t * chunk;
+		size_t end = std::min(count, begin + chunk);
+		if (begin < end) {
+			workers.emplace_back([=, &fn]() { fn(begin, end); });
+		}
+	}
+	fn((size_t)0, std::min(count, chunk));
+	for (auto& worker : workers) {
+		worker.join();
+	}
+#endif
+}
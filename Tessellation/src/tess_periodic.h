@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_periodic.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A periodic tiling engine. A patch of shapes (the unit cell) is repeated
+	on the lattice spanned by two translation vectors a and b. Copies are
+	only generated for the lattice cells that intersect the visible part of
+	the world, and are evicted again once they scroll out of view, so the
+	canvas is effectively infinite while memory stays proportional to what
+	is on screen.
+
+	The repeat can also be bounded to a block of countA x countB copies,
+	for a finite periodic patch that is kept as its unit cell (see
+	tess_periodicity.h). Only the copies on screen are generated either way.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class TessPeriodicTiling {
+public:
+	// Upper bound on the number of live cells, so zooming far out can't
+	// generate an unbounded number of shapes
+	static constexpr int64_t MAX_LIVE_CELLS = 4096;
+
+	// Use the given shapes as the unit cell of the lattice spanned by a and b,
+	// repeated countA x countB times from the cell at the origin, or without
+	// bound if either count is 0. Returns false (and leaves the tiling
+	// unchanged) if a and b are parallel.
+	bool setUnitCell(std::vector<std::unique_ptr<TessShape>>&& upCell, const olc::vf2d& a, const olc::vf2d& b,
+		uint32_t countA = 0, uint32_t countB = 0) {
+		if (upCell.empty() || std::abs(a.cross(b)) < 1.0f) {
+			return false;
+		}
+
+		clear();
+		upCell_ = std::move(upCell);
+		lattice_.a = a;
+		lattice_.b = b;
+		countA_ = countA;
+		countB_ = countB;
+		if (countA_ == 0 || countB_ == 0) {
+			countA_ = countB_ = 0;
+		}
+
+		// Bounds of the unit cell, used to decide which cells are visible
+		cellMin_ = cellMax_ = upCell_.front()->getCentroid();
+		for (const auto& upShape : upCell_) {
+			for (const auto& point : upShape->getDrawPoints()) {
+				cellMin_ = cellMin_.min(point);
+				cellMax_ = cellMax_.max(point);
+			}
+		}
+		return true;
+	}
+
+	// Remove the unit cell and every generated cell, handing the unit cell back to the caller
+	std::vector<std::unique_ptr<TessShape>> takeUnitCell() {
+		std::vector<std::unique_ptr<TessShape>> upCell = std::move(upCell_);
+		clear();
+		return upCell;
+	}
+
+	// Remove the tiling, handing every copy of a bounded unit cell back to the
+	// caller, row by row. Empty if the tiling is unbounded.
+	std::vector<std::unique_ptr<TessShape>> takeBlock() {
+		std::vector<std::unique_ptr<TessShape>> upShapes;
+		if (isBounded()) {
+			upShapes.reserve(upCell_.size() * countA_ * countB_);
+			for (uint32_t j = 0; j < countB_; ++j) {
+				for (uint32_t i = 0; i < countA_; ++i) {
+					generateCell(lattice_.offset((int32_t)i, (int32_t)j), upShapes);
+				}
+			}
+			clear();
+		}
+		return upShapes;
+	}
+
+	void clear() {
+		upCell_.clear();
+		cells_.clear();
+		countA_ = countB_ = 0;
+	}
+
+	bool isActive() const {
+		return !upCell_.empty();
+	}
+
+	bool isBounded() const {
+		return isActive() && countA_ > 0;
+	}
+
+	// Generate the cells that intersect the world rectangle [worldTL, worldBR]
+	// (grown by one cell as a margin) and evict cells that are well outside it.
+	void update(const olc::vf2d& worldTL, const olc::vf2d& worldBR) {
+		if (!isActive()) {
+			return;
+		}
+
+		olc::vf2d cellSize = cellMax_ - cellMin_;
+		TessLattice::CellRange keep = lattice_.cellRange(cellMin_, cellMax_, worldTL - cellSize * 2.0f, worldBR + cellSize * 2.0f, MAX_LIVE_CELLS);
+		TessLattice::CellRange make = lattice_.cellRange(cellMin_, cellMax_, worldTL - cellSize, worldBR + cellSize, MAX_LIVE_CELLS);
+		if (isBounded()) {
+			make.iMin = std::max(make.iMin, 0);
+			make.jMin = std::max(make.jMin, 0);
+			make.iMax = (int32_t)std::min<int64_t>(make.iMax, (int64_t)countA_ - 1);
+			make.jMax = (int32_t)std::min<int64_t>(make.jMax, (int64_t)countB_ - 1);
+		}
+
+		// Evict cells outside the (larger) keep range. Using a larger range for
+		// eviction than for generation stops cells thrashing at the edges.
+		for (auto it = cells_.begin(); it != cells_.end(); ) {
+			int32_t i = (int32_t)(it->first >> 32);
+			int32_t j = (int32_t)(it->first & 0xFFFFFFFF);
+			if (!keep.contains(i, j)) {
+				it = cells_.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		olc::vf2d viewMin = worldTL - cellSize;
+		olc::vf2d viewMax = worldBR + cellSize;
+		for (int32_t i = make.iMin; i <= make.iMax; ++i) {
+			for (int32_t j = make.jMin; j <= make.jMax; ++j) {
+				// The lattice range is a parallelogram, skip cells that miss the rectangle
+				olc::vf2d offset = lattice_.offset(i, j);
+				olc::vf2d vMin = cellMin_ + offset;
+				olc::vf2d vMax = cellMax_ + offset;
+				if (vMax.x < viewMin.x || vMin.x > viewMax.x || vMax.y < viewMin.y || vMin.y > viewMax.y) {
+					continue;
+				}
+
+				auto& upShapes = cells_[cellKey(i, j)];
+				if (upShapes.empty()) {
+					generateCell(offset, upShapes);
+				}
+			}
+		}
+	}
+
+	// Call fn(TessShape&) for every shape in the generated cells
+	template <typename Fn>
+	void forEachShape(Fn fn) {
+		for (auto& cell : cells_) {
+			for (auto& upShape : cell.second) {
+				fn(*upShape);
+			}
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<TessShape>> upCell_;  // Unit cell, the template for every generated cell
+	TessLattice lattice_;                             // Lattice the unit cell is repeated on
+	olc::vf2d cellMin_;                               // Bounds of the unit cell
+	olc::vf2d cellMax_;
+	uint32_t countA_ = 0;                             // Copies along a and b, 0 if unbounded
+	uint32_t countB_ = 0;
+	std::unordered_map<int64_t, std::vector<std::unique_ptr<TessShape>>> cells_; // Generated cells by lattice position
+
+	static int64_t cellKey(int32_t i, int32_t j) {
+		return ((int64_t)i << 32) | (uint32_t)j;
+	}
+
+	// Copy the unit cell, translated by offset
+	void generateCell(const olc::vf2d& offset, std::vector<std::unique_ptr<TessShape>>& upShapes) const {
+		upShapes.reserve(upCell_.size());
+		for (const auto& upShape : upCell_) {
+			auto upCopy = std::make_unique<TessShape>(*upShape);
+			upCopy->moveTo(upShape->getCentroid() + offset);
+			upShapes.push_back(std::move(upCopy));
+		}
+	}
+};
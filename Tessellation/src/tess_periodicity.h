@@ -0,0 +1,747 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_periodicity.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Finds the translation symmetry of a set of placed tiles: a unit cell and
+	the two lattice vectors it repeats along, and the block of copies that
+	covers the tiles. A scene that is a periodic patch can then be stored as
+	the unit cell and its repeat extents rather than tile by tile.
+
+	Tiles are given in the stored units of TessSceneFile. Two tiles are of
+	the same kind if they have the same prototype, rotation and color.
+
+	1. Tiles are hashed by position, so a tile near a given place is found
+	   in a few lookups.
+	2. The candidate translations are the shortest differences between
+	   tiles of the most common kind. Each is tested on a sample of the
+	   tiles, and the shortest few that carry most of them onto tiles of
+	   the same kind are the symmetries. A translation that carries few of
+	   the first sample tiles is dropped early, so a set that doesn't
+	   repeat is turned down quickly. Pairs of them are tried as lattice
+	   bases, smallest cell first, keeping the one that stores the tiles in
+	   the fewest records.
+	3. For a basis, every tile is reduced into the cell at the origin.
+	   Tiles of a kind that reduce to the same place form an orbit, and the
+	   orbits with the most tiles make up the unit cell.
+	4. The lattice vectors and cell positions are fitted to the tiles by
+	   least squares, to 1/FINE of a stored unit. The sides of triangles and
+	   hexagons are irrational, so their positions are rounded and no whole
+	   number vector repeats them exactly; the fitted one, rounded the same
+	   way, does.
+
+	mayRepeat() searches a few patches of a large set on their own first,
+	so a scene that doesn't repeat is saved without the full search.
+
+	Every copy is checked against the tile it stands for. Tiles the repeat
+	doesn't give back exactly are left over as residual tiles, and copies
+	with no tile are gaps, so the repeat always reproduces the same tiles.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_flat_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class TessPeriodicity {
+public:
+	static constexpr int64_t FINE = 1 << 16;        // Lattice positions are in 1/FINE of a stored unit
+	static constexpr size_t SAMPLE_TILES = 4096;    // Tiles a candidate translation is tested on
+	static constexpr size_t MAX_CANDIDATES = 64;    // Shortest translations tested, from each reference tile
+	static constexpr size_t REFERENCE_TILES = 4;    // Tiles the candidates are measured from
+	static constexpr size_t MAX_SYMMETRIES = 6;     // Shortest symmetries the bases are made from
+	static constexpr int64_t TOLERANCE = 2;         // Stored units a rounded position may be off by
+	static constexpr size_t PROBE_TILES = 16384;    // Neighbouring tiles each probe of mayRepeat() searches
+	static constexpr size_t PROBES = 3;             // Probes mayRepeat() makes
+
+	// A cell tile: a tile of its kind, and its position in the first copy
+	struct CellTile {
+		uint32_t tile;
+		int64_t x;                       // In 1/FINE of a stored unit
+		int64_t y;
+	};
+
+	// A unit cell repeated on a countA x countB block of the lattice spanned
+	// by a and b. The sequence of copies runs row by row (b outer, a inner),
+	// listing the cell tiles in order in each, and is followed by the
+	// residual tiles. order gives each tile's place in that sequence; places
+	// no tile takes are gaps.
+	struct Repeat {
+		int64_t ax = 0, ay = 0;          // Lattice vectors, in 1/FINE of a stored unit
+		int64_t bx = 0, by = 0;
+		uint32_t countA = 0;
+		uint32_t countB = 0;
+		std::vector<CellTile> cell;
+		std::vector<uint32_t> residual;  // Tiles outside every copy, in order
+		std::vector<uint64_t> order;     // Place of each tile in the sequence
+
+		uint64_t repeatedCount() const {
+			return (uint64_t)cell.size() * countA * countB;
+		}
+
+		// Ranges of consecutive places that list the tiles in order
+		uint64_t runCount() const {
+			uint64_t runs = 0;
+			for (size_t t = 0; t < order.size(); ++t) {
+				runs += t == 0 || order[t] != order[t - 1] + 1;
+			}
+			return runs;
+		}
+	};
+
+	// The stored coordinate of the cell tile at cell in copy (i, j) of the
+	// lattice with vectors a and b, all but i and j in 1/FINE units
+	static int64_t position(int64_t cell, int64_t i, int64_t a, int64_t j, int64_t b) {
+		return floorDiv(cell + i * a + j * b + FINE / 2, FINE);
+	}
+
+	// Find the repeat of count tiles. Tile is any record with int32_t x, y
+	// and rotation, and integer prototype and color fields. False if no cell
+	// repeats twice or more.
+	//
+	// If approximate, a copy within TOLERANCE of a tile stands for it, and
+	// only a block with a tile for every copy is accepted. The repeat then
+	// gives back the tiles to within TOLERANCE and out of order, which is
+	// enough to draw them.
+	template <typename Tile>
+	static bool find(const Tile* pTiles, size_t count, Repeat& repeat, bool approximate = false) {
+		repeat = Repeat();
+		if (count < 4 || count >= NONE) {
+			return false;
+		}
+		Places<Tile> places(pTiles, count);
+
+		// Of the bases made from pairs of the shortest symmetries, the one
+		// that stores the tiles in the fewest records. The shortest pair
+		// gives the smallest cell, but a longer one may fit the outline of
+		// the patch better.
+		std::vector<Vector> symmetries = findSymmetries(places);
+		std::vector<std::pair<Vector, Vector>> bases;
+		for (size_t u = 0; u < symmetries.size(); ++u) {
+			for (size_t w = u + 1; w < symmetries.size(); ++w) {
+				if (!nearlyParallel(symmetries[u], symmetries[w])) {
+					bases.push_back({ symmetries[u], symmetries[w] });
+				}
+			}
+		}
+		if (bases.empty() && !symmetries.empty()) {
+			// A single row repeats along one vector alone
+			bases.push_back({ symmetries[0], { -symmetries[0].y, symmetries[0].x } });
+		}
+		std::stable_sort(bases.begin(), bases.end(), [](const auto& p, const auto& q) {
+			return std::abs(cross(p.first, p.second)) < std::abs(cross(q.first, q.second));
+		});
+
+		uint64_t bestCost = count;
+		for (const auto& basis : bases) {
+			Repeat tried;
+			uint64_t cost = 0;
+			if (tryBasis(places, basis.first, basis.second, approximate, tried, cost) && cost < bestCost) {
+				repeat = std::move(tried);
+				bestCost = cost;
+				if (cost * GOOD_ENOUGH <= count) {
+					break;
+				}
+			}
+		}
+		return repeat.countA > 0;
+	}
+
+	// A quick test for whether find() is worth running on many tiles, for
+	// a repeat that at least halves the records they are stored in. The
+	// PROBE_TILES tiles nearest each of a few tiles spread through the list
+	// are searched on their own; if none of them repeats like that, the
+	// whole set is taken not to either. Sets too small to probe pass.
+	template <typename Tile>
+	static bool mayRepeat(const Tile* pTiles, size_t count) {
+		if (count <= PROBE_TILES * PROBES * 4) {
+			return true;
+		}
+		std::vector<std::pair<int64_t, uint32_t>> distances(count);
+		std::vector<Tile> patch(PROBE_TILES);
+		for (size_t p = 0; p < PROBES; ++p) {
+			const Tile& centre = pTiles[(2 * p + 1) * count / (2 * PROBES)];
+			for (size_t t = 0; t < count; ++t) {
+				int64_t dx = (int64_t)pTiles[t].x - centre.x;
+				int64_t dy = (int64_t)pTiles[t].y - centre.y;
+				distances[t] = { dx * dx + dy * dy, (uint32_t)t };
+			}
+			std::nth_element(distances.begin(), distances.begin() + PROBE_TILES, distances.end());
+			// In their order in the list, as find() would see them
+			std::sort(distances.begin(), distances.begin() + PROBE_TILES, [](const auto& u, const auto& v) {
+				return u.second < v.second;
+			});
+			for (size_t k = 0; k < PROBE_TILES; ++k) {
+				patch[k] = pTiles[distances[k].second];
+			}
+			Repeat repeat;
+			if (find(patch.data(), patch.size(), repeat) &&
+				(repeat.cell.size() + repeat.residual.size() + repeat.runCount()) * 2 <= PROBE_TILES) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	static constexpr uint32_t NONE = UINT32_MAX;
+	static constexpr int64_t MAX_OFFSET = 1 << 30;  // Longest translation tried, so squared lengths fit
+	static constexpr uint64_t GOOD_ENOUGH = 64;     // A basis storing this small a fraction of the records is kept
+	static constexpr double ORBIT_TOLERANCE = 4.0;  // Stored units apart two tiles may reduce to and share an orbit
+	static constexpr double ORBIT_BIN = 16.0;       // Stored units per side of the bins orbits are hashed in
+	static constexpr size_t MAX_BOUNDARIES = 8;     // Gaps tried as the cell boundary along each vector
+	static constexpr size_t EARLY_TILES = 128;      // Sample tiles after which a translation matching under a third is dropped
+	static constexpr size_t SAMPLE_STEP = 10007;    // A prime above any sample size (under 2 * SAMPLE_TILES), so stepping by it visits every sample tile
+
+	struct Vector {
+		int64_t x;
+		int64_t y;
+	};
+
+	// The tiles hashed by position, each chain listing the tiles at one
+	// place. A tile that matches one listed before it is a duplicate.
+	template <typename Tile>
+	struct Places {
+		const Tile* pTiles;
+		size_t count;
+		TessFlatMap<uint64_t, uint32_t> heads;
+		std::vector<uint32_t> next;
+		std::vector<uint8_t> duplicate;
+
+		Places(const Tile* pTiles, size_t count) : pTiles(pTiles), count(count), next(count, NONE), duplicate(count, 0) {
+			heads.reserve(count);
+			for (size_t t = 0; t < count; ++t) {
+				const Tile& tile = pTiles[t];
+				auto head = heads.try_emplace(placeKey(tile.x, tile.y), (uint32_t)t);
+				if (!head.second) {
+					duplicate[t] = find(kindOf(tile), tile.x, tile.y) != NONE;
+					next[t] = head.first->second;
+					head.first->second = (uint32_t)t;
+				}
+			}
+		}
+
+		// A tile of the kind at (x, y), or NONE
+		uint32_t find(uint64_t kind, int64_t x, int64_t y) const {
+			if (x < INT32_MIN || x > INT32_MAX || y < INT32_MIN || y > INT32_MAX) {
+				return NONE;
+			}
+			auto head = heads.find(placeKey(x, y));
+			if (head == heads.end()) {
+				return NONE;
+			}
+			for (uint32_t t = head->second; t != NONE; t = next[t]) {
+				if (kindOf(pTiles[t]) == kind) {
+					return t;
+				}
+			}
+			return NONE;
+		}
+
+		// A tile of the kind within TOLERANCE of (x, y), or NONE
+		uint32_t findNear(uint64_t kind, int64_t x, int64_t y) const {
+			uint32_t t = find(kind, x, y);
+			for (int64_t dy = -TOLERANCE; dy <= TOLERANCE && t == NONE; ++dy) {
+				for (int64_t dx = -TOLERANCE; dx <= TOLERANCE && t == NONE; ++dx) {
+					t = find(kind, x + dx, y + dy);
+				}
+			}
+			return t;
+		}
+	};
+
+	// The tiles of one kind that reduce to one place in the cell
+	struct Orbit {
+		uint64_t kind = 0;
+		double rx = 0.0;              // Reduced position of its first tile
+		double ry = 0.0;
+		uint64_t size = 0;
+		uint32_t nextInBin = NONE;    // Another orbit hashed to the same bin
+		int64_t minI = INT64_MAX;     // Lowest copy of any of its tiles
+		int64_t minJ = INT64_MAX;
+		double sumI = 0.0, sumJ = 0.0, sumX = 0.0, sumY = 0.0;  // For the fit
+		int64_t cellX = 0;            // Fitted position in the first copy, in 1/FINE units
+		int64_t cellY = 0;
+		uint32_t cellIndex = NONE;    // Place in the cell, NONE if it isn't part of it
+	};
+
+	// The shortest translations that carry most tiles onto tiles of the
+	// same kind. The candidates are differences between a few tiles of the
+	// most common kind and the rest of that kind, and each is tested on a
+	// sample. A tile at the edge of the patch has no copy on one side, so
+	// either side counts.
+	template <typename Tile>
+	static std::vector<Vector> findSymmetries(const Places<Tile>& places) {
+		const Tile* pTiles = places.pTiles;
+		size_t count = places.count;
+		TessFlatMap<uint64_t, uint32_t> kinds;   // Kind to tile count
+		for (size_t t = 0; t < count; ++t) {
+			kinds[kindOf(pTiles[t])] += 1;
+		}
+		uint64_t commonKind = 0;
+		uint32_t commonCount = 0;
+		for (const auto& kind : kinds) {
+			if (kind.second > commonCount) {
+				commonKind = kind.first;
+				commonCount = kind.second;
+			}
+		}
+		if (commonCount < 2) {
+			return {};
+		}
+		std::vector<uint32_t> common;
+		common.reserve(commonCount);
+		for (size_t t = 0; t < count; ++t) {
+			if (kindOf(pTiles[t]) == commonKind) {
+				common.push_back((uint32_t)t);
+			}
+		}
+
+		std::vector<Vector> candidates;
+		for (size_t r = 0; r < REFERENCE_TILES; ++r) {
+			const Tile& reference = pTiles[common[r * (common.size() - 1) / (REFERENCE_TILES - 1)]];
+			std::vector<Vector> differences;
+			differences.reserve(common.size());
+			for (uint32_t t : common) {
+				Vector d = canonical({ (int64_t)pTiles[t].x - reference.x, (int64_t)pTiles[t].y - reference.y });
+				if (d.x * d.x + d.y * d.y > 4 * TOLERANCE * TOLERANCE && d.x <= MAX_OFFSET && std::abs(d.y) <= MAX_OFFSET) {
+					differences.push_back(d);
+				}
+			}
+			size_t keep = std::min(differences.size(), MAX_CANDIDATES);
+			std::nth_element(differences.begin(), differences.begin() + keep, differences.end(), shorter);
+			candidates.insert(candidates.end(), differences.begin(), differences.begin() + keep);
+		}
+		std::sort(candidates.begin(), candidates.end(), shorter);
+
+		size_t stride = std::max<size_t>(1, count / SAMPLE_TILES);
+		size_t sampled = (count + stride - 1) / stride;
+		std::vector<Vector> symmetries;
+		for (const Vector& d : candidates) {
+			// Rounding gives the same translation several nearby values
+			bool known = false;
+			for (const Vector& s : symmetries) {
+				known = known || (std::abs(s.x - d.x) <= 2 * TOLERANCE && std::abs(s.y - d.y) <= 2 * TOLERANCE);
+			}
+			if (known) {
+				continue;
+			}
+			// The sample is visited in a scrambled order, SAMPLE_STEP places
+			// apart, so its first tiles are spread over the whole set, and a
+			// translation that misses most of them is dropped there
+			size_t matches = 0;
+			size_t misses = 0;
+			for (size_t k = 0; k < sampled && misses * 2 <= sampled; ++k) {
+				if (k == EARLY_TILES && matches * 3 < k) {
+					break;
+				}
+				const Tile& tile = pTiles[(k * SAMPLE_STEP % sampled) * stride];
+				uint64_t kind = kindOf(tile);
+				if (places.findNear(kind, tile.x + d.x, tile.y + d.y) != NONE || places.findNear(kind, tile.x - d.x, tile.y - d.y) != NONE) {
+					matches += 1;
+				}
+				else {
+					misses += 1;
+				}
+			}
+			if (matches * 2 >= sampled) {
+				symmetries.push_back(d);
+				if (symmetries.size() == MAX_SYMMETRIES) {
+					break;
+				}
+			}
+		}
+		return symmetries;
+	}
+
+	// The translation d to a fraction of a stored unit, measured by
+	// following it from tile to tile as far as it goes from a few tiles
+	template <typename Tile>
+	static void refine(const Places<Tile>& places, const Vector& d, double& x, double& y) {
+		const Tile* pTiles = places.pTiles;
+		size_t count = places.count;
+		x = (double)d.x;
+		y = (double)d.y;
+		int64_t bestSteps = 0;
+		for (size_t r = 0; r < REFERENCE_TILES; ++r) {
+			uint32_t first = (uint32_t)(r * (count - 1) / (REFERENCE_TILES - 1));
+			uint64_t kind = kindOf(pTiles[first]);
+			uint32_t ends[2] = { first, first };
+			int64_t steps = 0;
+			for (int side = 0; side < 2; ++side) {
+				int64_t sign = side == 0 ? 1 : -1;
+				for (size_t step = 0; step < count; ++step) {
+					const Tile& tile = pTiles[ends[side]];
+					uint32_t t = places.findNear(kind, tile.x + sign * d.x, tile.y + sign * d.y);
+					if (t == NONE) {
+						break;
+					}
+					ends[side] = t;
+					steps += 1;
+				}
+			}
+			if (steps > bestSteps) {
+				bestSteps = steps;
+				x = (double)((int64_t)pTiles[ends[0]].x - pTiles[ends[1]].x) / (double)steps;
+				y = (double)((int64_t)pTiles[ends[0]].y - pTiles[ends[1]].y) / (double)steps;
+			}
+		}
+	}
+
+	// The repeat on the lattice spanned by a and b, and its cost: the cell
+	// and residual tiles plus the runs the order needs. False if no cell
+	// repeats, or an approximate block has gaps.
+	template <typename Tile>
+	static bool tryBasis(const Places<Tile>& places, Vector va, Vector vb, bool approximate, Repeat& repeat, uint64_t& cost) {
+		const Tile* pTiles = places.pTiles;
+		size_t count = places.count;
+		if (cross(va, vb) < 0) {
+			vb = { -vb.x, -vb.y };
+		}
+		double ax, ay, bx, by;
+		refine(places, va, ax, ay);
+		refine(places, vb, bx, by);
+		double det = ax * by - ay * bx;
+		if (!(det > 0.0)) {
+			return false;
+		}
+
+		// Lattice coordinates, with the cell boundaries moved into wide gaps
+		// between the tiles, so rounding can't put a tile on either side
+		std::vector<double> u(count);
+		std::vector<double> v(count);
+		for (size_t t = 0; t < count; ++t) {
+			u[t] = ((double)pTiles[t].x * by - (double)pTiles[t].y * bx) / det;
+			v[t] = (ax * (double)pTiles[t].y - ay * (double)pTiles[t].x) / det;
+		}
+		double u0 = cellBoundary(u);
+		double v0 = cellBoundary(v);
+
+		// Reduce the tiles into the cell and group them into orbits
+		std::vector<Orbit> orbits;
+		TessFlatMap<uint64_t, uint32_t> bins;       // Bin of a reduced position to its last orbit
+		std::vector<uint32_t> orbitOf(count, NONE);
+		std::vector<int64_t> cellI(count);
+		std::vector<int64_t> cellJ(count);
+		for (size_t t = 0; t < count; ++t) {
+			if (places.duplicate[t] || !(std::abs(u[t]) < INT32_MAX) || !(std::abs(v[t]) < INT32_MAX)) {
+				continue;
+			}
+			int64_t i = (int64_t)std::floor(u[t] - u0);
+			int64_t j = (int64_t)std::floor(v[t] - v0);
+			double rx = pTiles[t].x - i * ax - j * bx;
+			double ry = pTiles[t].y - i * ay - j * by;
+			uint64_t kind = kindOf(pTiles[t]);
+			int64_t qx = (int64_t)std::floor(rx / ORBIT_BIN);
+			int64_t qy = (int64_t)std::floor(ry / ORBIT_BIN);
+			uint32_t o = NONE;
+			for (int64_t y = qy - 1; y <= qy + 1 && o == NONE; ++y) {
+				for (int64_t x = qx - 1; x <= qx + 1 && o == NONE; ++x) {
+					auto bin = bins.find(placeKey(x, y));
+					for (uint32_t p = bin != bins.end() ? bin->second : NONE; p != NONE; p = orbits[p].nextInBin) {
+						if (orbits[p].kind == kind && std::abs(orbits[p].rx - rx) <= ORBIT_TOLERANCE && std::abs(orbits[p].ry - ry) <= ORBIT_TOLERANCE) {
+							o = p;
+							break;
+						}
+					}
+				}
+			}
+			if (o == NONE) {
+				o = (uint32_t)orbits.size();
+				auto bin = bins.try_emplace(placeKey(qx, qy), NONE).first;
+				Orbit orbit;
+				orbit.kind = kind;
+				orbit.rx = rx;
+				orbit.ry = ry;
+				orbit.nextInBin = bin->second;
+				bin->second = o;
+				orbits.push_back(orbit);
+			}
+			Orbit& orbit = orbits[o];
+			orbit.size += 1;
+			orbit.sumI += (double)i;
+			orbit.sumJ += (double)j;
+			orbit.sumX += pTiles[t].x;
+			orbit.sumY += pTiles[t].y;
+			orbitOf[t] = o;
+			cellI[t] = i;
+			cellJ[t] = j;
+			orbit.minI = std::min(orbit.minI, i);
+			orbit.minJ = std::min(orbit.minJ, j);
+		}
+
+		// A cell boundary can't follow every orbit: in a row of triangles
+		// offset by half a side from the row below, one row's triangles are
+		// split across it. Count each orbit's copies from its own first one,
+		// so the cell is the tiles in the first copy of each.
+		for (size_t t = 0; t < count; ++t) {
+			if (orbitOf[t] != NONE) {
+				cellI[t] -= orbits[orbitOf[t]].minI;
+				cellJ[t] -= orbits[orbitOf[t]].minJ;
+			}
+		}
+		for (Orbit& orbit : orbits) {
+			orbit.sumI -= (double)orbit.minI * orbit.size;
+			orbit.sumJ -= (double)orbit.minJ * orbit.size;
+		}
+
+		// The cell is made of the orbits with at least half as many tiles as
+		// the largest, in the order of their first tiles
+		uint64_t largest = 0;
+		for (const Orbit& orbit : orbits) {
+			largest = std::max(largest, orbit.size);
+		}
+		if (largest < 2) {
+			return false;
+		}
+		uint32_t cellSize = 0;
+		for (size_t t = 0; t < count; ++t) {
+			uint32_t o = orbitOf[t];
+			if (o != NONE && orbits[o].cellIndex == NONE && orbits[o].size * 2 >= largest) {
+				orbits[o].cellIndex = cellSize++;
+			}
+		}
+
+		// Fit the lattice vectors and each orbit's place in the cell to the
+		// tiles, by least squares about each orbit's mean
+		double sii = 0.0, sij = 0.0, sjj = 0.0, six = 0.0, siy = 0.0, sjx = 0.0, sjy = 0.0;
+		for (size_t t = 0; t < count; ++t) {
+			uint32_t o = orbitOf[t];
+			if (o == NONE || orbits[o].cellIndex == NONE) {
+				continue;
+			}
+			const Orbit& orbit = orbits[o];
+			double di = cellI[t] - orbit.sumI / orbit.size;
+			double dj = cellJ[t] - orbit.sumJ / orbit.size;
+			double dx = pTiles[t].x - orbit.sumX / orbit.size;
+			double dy = pTiles[t].y - orbit.sumY / orbit.size;
+			sii += di * di;
+			sij += di * dj;
+			sjj += dj * dj;
+			six += di * dx;
+			siy += di * dy;
+			sjx += dj * dx;
+			sjy += dj * dy;
+		}
+		double normal = sii * sjj - sij * sij;
+		if (normal > 1e-9 * sii * sjj && normal > 0.0) {
+			ax = (six * sjj - sjx * sij) / normal;
+			ay = (siy * sjj - sjy * sij) / normal;
+			bx = (sjx * sii - six * sij) / normal;
+			by = (sjy * sii - siy * sij) / normal;
+		}
+		else if (sii > 0.0) {
+			ax = six / sii;   // A single row along a
+			ay = siy / sii;
+		}
+		Vector a = { (int64_t)std::llround(ax * FINE), (int64_t)std::llround(ay * FINE) };
+		Vector b = { (int64_t)std::llround(bx * FINE), (int64_t)std::llround(by * FINE) };
+
+		// The block of copies the cell tiles cover
+		int64_t iMin = INT64_MAX, iMax = INT64_MIN, jMin = INT64_MAX, jMax = INT64_MIN;
+		for (size_t t = 0; t < count; ++t) {
+			uint32_t o = orbitOf[t];
+			if (o != NONE && orbits[o].cellIndex != NONE) {
+				iMin = std::min(iMin, cellI[t]);
+				iMax = std::max(iMax, cellI[t]);
+				jMin = std::min(jMin, cellJ[t]);
+				jMax = std::max(jMax, cellJ[t]);
+			}
+		}
+		uint64_t countA = (uint64_t)(iMax - iMin + 1);
+		uint64_t countB = (uint64_t)(jMax - jMin + 1);
+		if (countA > UINT32_MAX || countB > UINT32_MAX || countA * countB < 2 || countA * countB > (1ull << 62) / cellSize) {
+			return false;
+		}
+		for (Orbit& orbit : orbits) {
+			if (orbit.cellIndex != NONE) {
+				double di = orbit.sumI / orbit.size - iMin;
+				double dj = orbit.sumJ / orbit.size - jMin;
+				orbit.cellX = std::llround((orbit.sumX / orbit.size - di * ax - dj * bx) * FINE);
+				orbit.cellY = std::llround((orbit.sumY / orbit.size - di * ay - dj * by) * FINE);
+			}
+		}
+
+		// Each tile's copy, if the repeat gives back that tile
+		std::vector<uint32_t> copyI(count, NONE);
+		std::vector<uint32_t> copyJ(count, NONE);
+		uint64_t residual = 0;
+		for (size_t t = 0; t < count; ++t) {
+			uint32_t o = orbitOf[t];
+			if (o != NONE && orbits[o].cellIndex != NONE) {
+				int64_t i = cellI[t] - iMin;
+				int64_t j = cellJ[t] - jMin;
+				int64_t offBy = approximate ? TOLERANCE : 0;
+				if (std::abs(position(orbits[o].cellX, i, a.x, j, b.x) - pTiles[t].x) <= offBy &&
+					std::abs(position(orbits[o].cellY, i, a.y, j, b.y) - pTiles[t].y) <= offBy) {
+					copyI[t] = (uint32_t)i;
+					copyJ[t] = (uint32_t)j;
+					continue;
+				}
+			}
+			residual += 1;
+		}
+		uint64_t repeated = (uint64_t)cellSize * countA * countB;
+		if (approximate && count - residual != repeated) {
+			return false;
+		}
+
+		// The copies may be listed from any corner of the block, either way
+		// round. Use the order that keeps the most tiles in sequence.
+		auto placeOf = [&](int variant, size_t t, uint64_t& residualIndex) {
+			if (copyI[t] == NONE) {
+				return repeated + residualIndex++;
+			}
+			uint64_t i = variant & 1 ? countA - 1 - copyI[t] : copyI[t];
+			uint64_t j = variant & 2 ? countB - 1 - copyJ[t] : copyJ[t];
+			uint64_t copy = variant & 4 ? i * countB + j : j * countA + i;
+			return copy * cellSize + orbits[orbitOf[t]].cellIndex;
+		};
+		int bestVariant = 0;
+		uint64_t bestRuns = UINT64_MAX;
+		for (int variant = 0; variant < 8; ++variant) {
+			uint64_t runs = 0;
+			uint64_t residualIndex = 0;
+			uint64_t previous = UINT64_MAX;
+			for (size_t t = 0; t < count; ++t) {
+				uint64_t place = placeOf(variant, t, residualIndex);
+				runs += place != previous + 1 ? 1 : 0;
+				previous = place;
+			}
+			if (runs < bestRuns) {
+				bestVariant = variant;
+				bestRuns = runs;
+			}
+		}
+
+		// The lattice vectors and cell tiles as seen from that corner
+		repeat.order.resize(count);
+		uint64_t residualIndex = 0;
+		for (size_t t = 0; t < count; ++t) {
+			repeat.order[t] = placeOf(bestVariant, t, residualIndex);
+			if (copyI[t] == NONE) {
+				repeat.residual.push_back((uint32_t)t);
+			}
+		}
+		int64_t cornerI = bestVariant & 1 ? (int64_t)countA - 1 : 0;
+		int64_t cornerJ = bestVariant & 2 ? (int64_t)countB - 1 : 0;
+		repeat.cell.resize(cellSize);
+		for (size_t t = 0; t < count; ++t) {
+			uint32_t o = orbitOf[t];
+			if (o != NONE && orbits[o].cellIndex != NONE) {
+				const Orbit& orbit = orbits[o];
+				repeat.cell[orbit.cellIndex] = { (uint32_t)t, orbit.cellX + cornerI * a.x + cornerJ * b.x, orbit.cellY + cornerI * a.y + cornerJ * b.y };
+			}
+		}
+		if (bestVariant & 1) {
+			a = { -a.x, -a.y };
+		}
+		if (bestVariant & 2) {
+			b = { -b.x, -b.y };
+		}
+		if (bestVariant & 4) {
+			std::swap(a, b);
+			std::swap(countA, countB);
+		}
+		repeat.ax = a.x;
+		repeat.ay = a.y;
+		repeat.bx = b.x;
+		repeat.by = b.y;
+		repeat.countA = (uint32_t)countA;
+		repeat.countB = (uint32_t)countB;
+		cost = cellSize + residual + (bestRuns > 1 ? bestRuns : 0);
+		return true;
+	}
+
+	// An offset in [0, 1) that falls in a wide gap between the fractional
+	// parts of the values. Of the gaps at least half as wide as the widest,
+	// the one that splits the values into the fewest whole steps, so the
+	// block of copies has no partly filled row at either end.
+	static double cellBoundary(const std::vector<double>& values) {
+		std::vector<double> fractions;
+		size_t stride = std::max<size_t>(1, values.size() / SAMPLE_TILES);
+		for (size_t t = 0; t < values.size(); t += stride) {
+			fractions.push_back(values[t] - std::floor(values[t]));
+		}
+		std::sort(fractions.begin(), fractions.end());
+		std::vector<std::pair<double, double>> gaps = { { fractions.front() + 1.0 - fractions.back(), fractions.back() } };
+		for (size_t k = 1; k < fractions.size(); ++k) {
+			gaps.push_back({ fractions[k] - fractions[k - 1], fractions[k - 1] });
+		}
+		std::sort(gaps.begin(), gaps.end(), [](const auto& p, const auto& q) { return p.first > q.first; });
+
+		double best = 0.0;
+		int64_t bestSteps = INT64_MAX;
+		for (size_t g = 0; g < gaps.size() && g < MAX_BOUNDARIES && gaps[g].first * 2.0 >= gaps[0].first; ++g) {
+			double offset = gaps[g].second + gaps[g].first / 2.0;
+			offset -= std::floor(offset);
+			int64_t low = INT64_MAX;
+			int64_t high = INT64_MIN;
+			for (double value : values) {
+				int64_t step = (int64_t)std::floor(value - offset);
+				low = std::min(low, step);
+				high = std::max(high, step);
+			}
+			if (high - low < bestSteps) {
+				best = offset;
+				bestSteps = high - low;
+			}
+		}
+		return best;
+	}
+
+	static uint64_t placeKey(int64_t x, int64_t y) {
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+	}
+
+	template <typename Tile>
+	static uint64_t kindOf(const Tile& tile) {
+		return (uint64_t)tile.prototype | ((uint64_t)tile.color << 16) | ((uint64_t)(uint32_t)tile.rotation << 24);
+	}
+
+	static int64_t cross(const Vector& u, const Vector& v) {
+		return u.x * v.y - u.y * v.x;
+	}
+
+	// True if u and v are less than about 6 degrees apart
+	static bool nearlyParallel(const Vector& u, const Vector& v) {
+		double c = (double)cross(u, v);
+		return c * c * 100.0 < (double)(u.x * u.x + u.y * u.y) * (double)(v.x * v.x + v.y * v.y);
+	}
+
+	// d or -d, whichever points right (or up, if vertical)
+	static Vector canonical(const Vector& d) {
+		return d.x > 0 || (d.x == 0 && d.y > 0) ? d : Vector{ -d.x, -d.y };
+	}
+
+	static bool shorter(const Vector& u, const Vector& v) {
+		int64_t lu = u.x * u.x + u.y * u.y;
+		int64_t lv = v.x * v.x + v.y * v.y;
+		if (lu != lv) {
+			return lu < lv;
+		}
+		return u.x != v.x ? u.x < v.x : u.y < v.y;
+	}
+
+	static int64_t floorDiv(int64_t n, int64_t d) {
+		int64_t q = n / d;
+		return (n % d != 0 && (n < 0) != (d < 0)) ? q - 1 : q;
+	}
+};
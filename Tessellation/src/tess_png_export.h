@@ -0,0 +1,479 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_png_export.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Renders the placed shapes into a PNG image of any size, for printing.
+
+	The image is cut into bands one tile high. The tiles of a band are
+	rendered in parallel, each into its own olc::Sprite, by a scanline
+	rasterizer that writes the sprite's pixels directly rather than going
+	through the engine's draw target, so no window or display is needed.
+	The band's rows are then passed to the PNG encoder one by one, so only
+	one band of the image is ever in memory.
+
+	TessPngWriter is a small streaming PNG encoder. It writes 8 bit RGBA,
+	picks the Sub or Up filter for each row, and deflates with the fixed
+	Huffman codes, coding runs of equal bytes as distance 1 matches. The
+	flat colors of a tiling filter to long runs of zeros, which this
+	compresses well.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_spatial_index.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Writes a PNG file a row at a time
+class TessPngWriter {
+public:
+	static constexpr size_t IDAT_SIZE = 64 * 1024;   // Compressed bytes per IDAT chunk
+
+	bool open(const std::string& path, uint32_t width, uint32_t height) {
+		out_.open(path, std::ios::binary | std::ios::trunc);
+		width_ = width;
+		rowsLeft_ = height;
+		previous_.assign((size_t)width * 4, 0);
+		sub_.resize((size_t)width * 4 + 1);
+		up_.resize((size_t)width * 4 + 1);
+		idat_.clear();
+		bits_ = 0;
+		bitCount_ = 0;
+		adlerA_ = 1;
+		adlerB_ = 0;
+		haveLast_ = false;
+
+		static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out_.write((const char*)SIGNATURE, sizeof(SIGNATURE));
+		uint8_t header[13] = {};
+		putBigEndian(header, width);
+		putBigEndian(header + 4, height);
+		header[8] = 8;    // Bits per channel
+		header[9] = 6;    // RGBA
+		writeChunk("IHDR", header, sizeof(header));
+
+		// zlib header, then a single final deflate block with fixed codes
+		idat_.push_back(0x78);
+		idat_.push_back(0x01);
+		putBits(1, 1);
+		putBits(1, 2);
+		return (bool)out_;
+	}
+
+	// Add the next row of width RGBA pixels
+	void writeRow(const uint8_t* pRow) {
+		if (rowsLeft_ == 0) {
+			return;
+		}
+		--rowsLeft_;
+
+		// Filter the row both ways and keep the one with the smaller sum of
+		// absolute values, the usual heuristic
+		size_t size = (size_t)width_ * 4;
+		sub_[0] = 1;
+		up_[0] = 2;
+		uint64_t subSum = 0, upSum = 0;
+		for (size_t i = 0; i < size; ++i) {
+			uint8_t left = i >= 4 ? pRow[i - 4] : 0;
+			sub_[i + 1] = (uint8_t)(pRow[i] - left);
+			up_[i + 1] = (uint8_t)(pRow[i] - previous_[i]);
+			subSum += std::abs((int8_t)sub_[i + 1]);
+			upSum += std::abs((int8_t)up_[i + 1]);
+		}
+		std::memcpy(previous_.data(), pRow, size);
+		deflate(upSum < subSum ? up_.data() : sub_.data(), size + 1);
+	}
+
+	// Finish the stream and close the file. False if any write failed or
+	// rows are missing.
+	bool close() {
+		putSymbol(256);
+		if (bitCount_ > 0) {
+			putByte((uint8_t)bits_);
+		}
+		bits_ = 0;
+		bitCount_ = 0;
+		uint8_t adler[4];
+		putBigEndian(adler, (adlerB_ << 16) | adlerA_);
+		idat_.insert(idat_.end(), adler, adler + 4);
+		writeChunk("IDAT", idat_.data(), idat_.size());
+		idat_.clear();
+		writeChunk("IEND", nullptr, 0);
+		out_.close();
+		return !out_.fail() && rowsLeft_ == 0;
+	}
+
+private:
+	std::ofstream out_;
+	uint32_t width_ = 0;
+	uint32_t rowsLeft_ = 0;
+	std::vector<uint8_t> previous_;   // Unfiltered previous row, for the Up filter
+	std::vector<uint8_t> sub_;        // Filter type byte and the filtered row
+	std::vector<uint8_t> up_;
+	std::vector<uint8_t> idat_;       // Compressed bytes not yet written
+	uint64_t bits_ = 0;
+	int bitCount_ = 0;
+	uint32_t adlerA_ = 1;
+	uint32_t adlerB_ = 0;
+	uint8_t last_ = 0;                // Last byte coded, the source of a distance 1 match
+	bool haveLast_ = false;
+
+	struct Code {
+		uint16_t bits;    // Bit reversed, ready to write least significant bit first
+		uint8_t length;
+	};
+
+	struct LengthCode {
+		uint16_t symbol;
+		uint8_t extraBits;
+		uint16_t extra;
+	};
+
+	static uint16_t reverse(uint16_t code, int length) {
+		uint16_t reversed = 0;
+		for (int i = 0; i < length; ++i) {
+			reversed = (uint16_t)((reversed << 1) | ((code >> i) & 1));
+		}
+		return reversed;
+	}
+
+	// The fixed literal/length codes of RFC 1951 section 3.2.6
+	static const std::array<Code, 288>& fixedCodes() {
+		static const std::array<Code, 288> codes = [] {
+			std::array<Code, 288> table = {};
+			for (int symbol = 0; symbol < 288; ++symbol) {
+				if (symbol < 144) {
+					table[symbol] = { reverse((uint16_t)(0x30 + symbol), 8), 8 };
+				}
+				else if (symbol < 256) {
+					table[symbol] = { reverse((uint16_t)(0x190 + symbol - 144), 9), 9 };
+				}
+				else if (symbol < 280) {
+					table[symbol] = { reverse((uint16_t)(symbol - 256), 7), 7 };
+				}
+				else {
+					table[symbol] = { reverse((uint16_t)(0xC0 + symbol - 280), 8), 8 };
+				}
+			}
+			return table;
+		}();
+		return codes;
+	}
+
+	// Length symbol and extra bits of each match length 3 to 258
+	static const std::array<LengthCode, 259>& lengthCodes() {
+		static const std::array<LengthCode, 259> codes = [] {
+			static const uint16_t BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+				35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static const uint8_t EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+				3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			std::array<LengthCode, 259> table = {};
+			for (int i = 0; i < 29; ++i) {
+				int end = i + 1 < 29 ? BASE[i + 1] : 259;
+				for (int length = BASE[i]; length < end; ++length) {
+					table[length] = { (uint16_t)(257 + i), EXTRA[i], (uint16_t)(length - BASE[i]) };
+				}
+			}
+			return table;
+		}();
+		return codes;
+	}
+
+	void deflate(const uint8_t* pData, size_t size) {
+		// Adler-32 of the uncompressed bytes, reduced often enough not to overflow
+		for (size_t i = 0; i < size; ) {
+			size_t end = std::min(size, i + 5552);
+			for (; i < end; ++i) {
+				adlerA_ += pData[i];
+				adlerB_ += adlerA_;
+			}
+			adlerA_ %= 65521;
+			adlerB_ %= 65521;
+		}
+
+		const std::array<LengthCode, 259>& lengths = lengthCodes();
+		size_t i = 0;
+		while (i < size) {
+			size_t run = 0;
+			if (haveLast_) {
+				size_t limit = std::min<size_t>(258, size - i);
+				while (run < limit && pData[i + run] == last_) {
+					++run;
+				}
+			}
+			if (run >= 3) {
+				const LengthCode& code = lengths[run];
+				putSymbol(code.symbol);
+				putBits(code.extra, code.extraBits);
+				putBits(0, 5);    // Distance code 0, a distance of 1
+				i += run;
+			}
+			else {
+				putSymbol(pData[i]);
+				last_ = pData[i];
+				haveLast_ = true;
+				++i;
+			}
+		}
+	}
+
+	void putSymbol(int symbol) {
+		const Code& code = fixedCodes()[symbol];
+		putBits(code.bits, code.length);
+	}
+
+	void putBits(uint32_t value, int count) {
+		bits_ |= (uint64_t)value << bitCount_;
+		bitCount_ += count;
+		while (bitCount_ >= 8) {
+			putByte((uint8_t)bits_);
+			bits_ >>= 8;
+			bitCount_ -= 8;
+		}
+	}
+
+	void putByte(uint8_t byte) {
+		idat_.push_back(byte);
+		if (idat_.size() == IDAT_SIZE) {
+			writeChunk("IDAT", idat_.data(), idat_.size());
+			idat_.clear();
+		}
+	}
+
+	void writeChunk(const char* pType, const uint8_t* pData, size_t size) {
+		uint8_t length[4];
+		putBigEndian(length, (uint32_t)size);
+		out_.write((const char*)length, 4);
+		out_.write(pType, 4);
+		if (size > 0) {
+			out_.write((const char*)pData, size);
+		}
+		uint32_t crc = crc32(0xFFFFFFFFu, (const uint8_t*)pType, 4);
+		crc = crc32(crc, pData, size) ^ 0xFFFFFFFFu;
+		uint8_t crcBytes[4];
+		putBigEndian(crcBytes, crc);
+		out_.write((const char*)crcBytes, 4);
+	}
+
+	static uint32_t crc32(uint32_t crc, const uint8_t* pData, size_t size) {
+		static const std::array<uint32_t, 256> table = [] {
+			std::array<uint32_t, 256> entries = {};
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				entries[n] = c;
+			}
+			return entries;
+		}();
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	static void putBigEndian(uint8_t* pBytes, uint32_t value) {
+		pBytes[0] = (uint8_t)(value >> 24);
+		pBytes[1] = (uint8_t)(value >> 16);
+		pBytes[2] = (uint8_t)(value >> 8);
+		pBytes[3] = (uint8_t)value;
+	}
+};
+
+class TessPngExport {
+public:
+	static constexpr int32_t TILE_SIZE = 256;           // Pixels per tile side
+	static constexpr uint32_t MAX_SIZE = 1u << 17;      // Largest image side in pixels
+	static constexpr float STROKE_WIDTH = 0.5f;         // World units, never thinner than a pixel
+	static inline const olc::Pixel STROKE_COLOR = olc::Pixel(0, 0, 0);
+
+	// Render the shapes to a PNG width pixels wide, as tall as their bounds
+	// need. index must hold exactly the shapes. The background is
+	// transparent. The file is written next to path and renamed over it.
+	static bool write(const std::string& path, const std::vector<std::unique_ptr<TessShape>>& upShapes,
+		const TessSpatialIndex& index, uint32_t width, std::string& error) {
+		// Bounds of the shapes. This also brings every shape's draw points up
+		// to date, so the tile workers only read them.
+		olc::vf2d vMin = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		olc::vf2d vMax = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+		for (const auto& upShape : upShapes) {
+			for (const auto& point : upShape->getDrawPoints()) {
+				vMin = vMin.min(point);
+				vMax = vMax.max(point);
+			}
+		}
+		if (upShapes.empty()) {
+			error = "There are no shapes to export";
+			return false;
+		}
+		vMin -= olc::vf2d(STROKE_WIDTH, STROKE_WIDTH);
+		vMax += olc::vf2d(STROKE_WIDTH, STROKE_WIDTH);
+
+		float scale = width / (vMax.x - vMin.x);   // Pixels per world unit
+		double exactHeight = std::ceil((double)(vMax.y - vMin.y) * scale - 0.01); // Not a row more for rounding
+		if (width == 0 || width > MAX_SIZE || exactHeight > MAX_SIZE) {
+			error = "The image must be 1 to " + std::to_string(MAX_SIZE) + " pixels on each side";
+			return false;
+		}
+		uint32_t height = std::max(1u, (uint32_t)exactHeight);
+		float strokeHalfWidth = std::max(0.5f, 0.5f * STROKE_WIDTH * scale);
+
+		std::string tempPath = path + ".tmp";
+		auto upWriter = std::make_unique<TessPngWriter>();
+		if (!upWriter->open(tempPath, width, height)) {
+			error = "Could not create " + tempPath;
+			return false;
+		}
+
+		size_t tilesAcross = (width + TILE_SIZE - 1) / TILE_SIZE;
+		std::vector<std::unique_ptr<olc::Sprite>> upTiles(tilesAcross);
+		for (auto& upTile : upTiles) {
+			upTile = std::make_unique<olc::Sprite>(TILE_SIZE, TILE_SIZE);
+		}
+		std::vector<uint8_t> row((size_t)width * 4);
+
+		for (uint32_t bandTop = 0; bandTop < height; bandTop += TILE_SIZE) {
+			tessParallelFor(tilesAcross, 1, [&](size_t begin, size_t end) {
+				Scratch scratch;
+				for (size_t t = begin; t < end; ++t) {
+					olc::vf2d tileOrigin = { (float)(t * TILE_SIZE), (float)bandTop };
+					renderTile(*upTiles[t], index, vMin + tileOrigin / scale, scale, strokeHalfWidth, scratch);
+				}
+			});
+
+			uint32_t bandRows = std::min<uint32_t>(TILE_SIZE, height - bandTop);
+			for (uint32_t y = 0; y < bandRows; ++y) {
+				for (size_t t = 0; t < tilesAcross; ++t) {
+					size_t x = t * TILE_SIZE;
+					size_t columns = std::min<size_t>(TILE_SIZE, width - x);
+					std::memcpy(&row[x * 4], upTiles[t]->GetData() + (size_t)y * TILE_SIZE, columns * 4);
+				}
+				upWriter->writeRow(row.data());
+			}
+		}
+
+		if (!upWriter->close()) {
+			error = "Could not write " + tempPath;
+			return false;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			error = "Could not replace " + path + ": " + ec.message();
+			return false;
+		}
+		return true;
+	}
+
+private:
+	// Buffers a tile worker reuses from tile to tile
+	struct Scratch {
+		std::vector<TessShape*> shapes;
+		std::vector<olc::vf2d> points;
+		std::vector<float> crossings;
+	};
+
+	// Clear the tile and draw every shape that reaches it, fills first so the
+	// outlines of neighbours are not painted over
+	static void renderTile(olc::Sprite& tile, const TessSpatialIndex& index, const olc::vf2d& origin, float scale,
+		float strokeHalfWidth, Scratch& scratch) {
+		std::fill(tile.GetData(), tile.GetData() + (size_t)TILE_SIZE * TILE_SIZE, olc::BLANK);
+
+		olc::vf2d margin = olc::vf2d(strokeHalfWidth, strokeHalfWidth) * 2.0f / scale;
+		scratch.shapes.clear();
+		index.query(origin - margin, origin + olc::vf2d((float)TILE_SIZE, (float)TILE_SIZE) / scale + margin,
+			[&](const TessSpatialIndex::Entry& entry) { scratch.shapes.push_back(entry.pShape); });
+
+		for (TessShape* pShape : scratch.shapes) {
+			if (pShape->getColor() == olc::BLANK) {
+				continue;
+			}
+			scratch.points.clear();
+			for (const auto& point : pShape->getDrawPoints()) {
+				scratch.points.push_back((point - origin) * scale);
+			}
+			fillPolygon(tile, scratch.points.data(), scratch.points.size(), pShape->getColor(), scratch.crossings);
+		}
+
+		for (TessShape* pShape : scratch.shapes) {
+			const std::vector<olc::vf2d>& points = pShape->getDrawPoints();
+			for (size_t i = 0; i < points.size(); ++i) {
+				olc::vf2d a = (points[i] - origin) * scale;
+				olc::vf2d b = (points[(i + 1) % points.size()] - origin) * scale;
+				float length = (b - a).mag();
+				if (length <= 0.0f) {
+					continue;
+				}
+				// The side as a rectangle, extended by the half width at both
+				// ends so corners are closed
+				olc::vf2d along = (b - a) * (strokeHalfWidth / length);
+				olc::vf2d across = along.perp();
+				olc::vf2d quad[4] = { a - along + across, b + along + across, b + along - across, a - along - across };
+				fillPolygon(tile, quad, 4, STROKE_COLOR, scratch.crossings);
+			}
+		}
+	}
+
+	// The first pixel whose centre is at or after coordinate v, clamped to the tile
+	static int32_t firstCentreAfter(float v) {
+		return (int32_t)std::ceil(std::clamp(v - 0.5f, 0.0f, (float)TILE_SIZE));
+	}
+
+	// Fill the pixels whose centres are inside the polygon (even-odd rule).
+	// Points are in the tile's pixel coordinates.
+	static void fillPolygon(olc::Sprite& tile, const olc::vf2d* pPoints, size_t count, olc::Pixel color, std::vector<float>& crossings) {
+		float top = std::numeric_limits<float>::max(), bottom = std::numeric_limits<float>::lowest();
+		for (size_t i = 0; i < count; ++i) {
+			top = std::min(top, pPoints[i].y);
+			bottom = std::max(bottom, pPoints[i].y);
+		}
+		int32_t yBegin = firstCentreAfter(top);
+		int32_t yEnd = firstCentreAfter(bottom);
+		olc::Pixel* pPixels = tile.GetData();
+
+		for (int32_t y = yBegin; y < yEnd; ++y) {
+			float yCentre = y + 0.5f;
+			crossings.clear();
+			for (size_t i = 0; i < count; ++i) {
+				const olc::vf2d& a = pPoints[i];
+				const olc::vf2d& b = pPoints[(i + 1) % count];
+				if ((a.y <= yCentre) != (b.y <= yCentre)) {
+					crossings.push_back(a.x + (yCentre - a.y) * (b.x - a.x) / (b.y - a.y));
+				}
+			}
+			std::sort(crossings.begin(), crossings.end());
+			for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+				int32_t xBegin = firstCentreAfter(crossings[i]);
+				int32_t xEnd = firstCentreAfter(crossings[i + 1]);
+				if (xBegin < xEnd) {
+					std::fill(pPixels + (size_t)y * TILE_SIZE + xBegin, pPixels + (size_t)y * TILE_SIZE + xEnd, color);
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_region_fill.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Fills a closed region with copies of one tile, snapped edge to edge.
+
+	Starting from a seed tile, the fill grows outward in waves. The neighbour
+	across each edge is the point reflection of the tile about the edge's
+	midpoint (a half turn), which is how triangles, quadrilaterals and
+	hexagons tile the plane; for squares and hexagons it is the same as a
+	translation. Every candidate tile is checked for containment in the
+	region and for overlap with the shapes already on the canvas, found
+	through the spatial index. Those checks run in parallel over each wave.
+	Candidates that pass are then checked against the tiles accepted so
+	far, so shapes that don't tile on their own (octagons, dodecagons) leave
+	gaps instead of overlapping.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_geometry.h"
+#include "tess_parallel.h"
+#include "tess_spatial_index.h"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class TessRegionFill {
+public:
+	// A filled tile: the seed tile moved to centre, turned a half turn if flipped
+	struct Tile {
+		olc::vd2d centre;
+		bool flipped;
+	};
+
+	// Fill region with copies of the tile whose vertices are seed + offsets.
+	// Returns no tiles if the seed tile itself isn't inside the region or
+	// overlaps a shape in existing. Every shape in existing must have up to date
+	// draw points, since they are read from several threads.
+	static std::vector<Tile> fill(const std::vector<olc::vf2d>& region, const std::vector<olc::vf2d>& offsets,
+		const olc::vd2d& seed, const TessSpatialIndex& existing, size_t maxTiles) {
+		std::vector<Tile> tiles;
+		if (region.size() < 3 || offsets.size() < 3) {
+			return tiles;
+		}
+
+		// Tiles are hashed by their centre, on a grid of twice their radius
+		double radius = 0.0;
+		for (const auto& offset : offsets) {
+			radius = std::max(radius, (double)offset.mag());
+		}
+		double quantum = radius * 1e-3;
+		double cellSize = radius * 2.0;
+		auto centreKey = [&](const olc::vd2d& c) {
+			int64_t qx = std::llround(c.x / quantum);
+			int64_t qy = std::llround(c.y / quantum);
+			return ((uint64_t)(uint32_t)qx << 32) | (uint32_t)qy;
+		};
+		auto cellKey = [&](int64_t x, int64_t y) {
+			return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+		};
+
+		std::unordered_set<uint64_t> seen;                                  // Centres already considered
+		std::unordered_map<uint64_t, std::vector<uint32_t>> acceptedCells;  // Accepted tiles by grid cell
+
+		std::vector<Tile> wave = { { seed, false } };
+		seen.insert(centreKey(seed));
+		std::vector<Tile> next;
+		std::vector<uint8_t> valid;
+
+		while (!wave.empty() && tiles.size() < maxTiles) {
+			// Containment and overlap with the existing shapes, in parallel
+			valid.assign(wave.size(), 0);
+			tessParallelFor(wave.size(), 256, [&](size_t begin, size_t end) {
+				std::vector<olc::vf2d> points;
+				for (size_t i = begin; i < end; ++i) {
+					tilePoints(wave[i], offsets, points);
+					valid[i] = insideRegion(region, points) && !existing.overlaps(points);
+				}
+			});
+
+			// Overlap with the tiles accepted so far, in order, then the next wave
+			next.clear();
+			std::vector<olc::vf2d> points;
+			std::vector<olc::vf2d> otherPoints;
+			for (size_t i = 0; i < wave.size() && tiles.size() < maxTiles; ++i) {
+				if (!valid[i]) {
+					continue;
+				}
+
+				const Tile& tile = wave[i];
+				tilePoints(tile, offsets, points);
+				int64_t cx = (int64_t)std::floor(tile.centre.x / cellSize);
+				int64_t cy = (int64_t)std::floor(tile.centre.y / cellSize);
+				bool overlap = false;
+				for (int64_t x = cx - 1; x <= cx + 1 && !overlap; ++x) {
+					for (int64_t y = cy - 1; y <= cy + 1 && !overlap; ++y) {
+						auto cell = acceptedCells.find(cellKey(x, y));
+						if (cell == acceptedCells.end()) {
+							continue;
+						}
+						for (uint32_t other : cell->second) {
+							tilePoints(tiles[other], offsets, otherPoints);
+							if (TessPolygon::overlaps(points.data(), points.size(), otherPoints.data(), otherPoints.size(), TessPolygon::OVERLAP_TOLERANCE)) {
+								overlap = true;
+								break;
+							}
+						}
+					}
+				}
+				if (overlap) {
+					continue;
+				}
+
+				acceptedCells[cellKey(cx, cy)].push_back((uint32_t)tiles.size());
+				tiles.push_back(tile);
+
+				// The neighbour across each edge is the half turn about its midpoint
+				for (size_t k = 0; k < points.size(); ++k) {
+					olc::vd2d midpoint = (olc::vd2d(points[k]) + olc::vd2d(points[(k + 1) % points.size()])) * 0.5;
+					Tile neighbour = { midpoint * 2.0 - tile.centre, !tile.flipped };
+					if (seen.insert(centreKey(neighbour.centre)).second) {
+						next.push_back(neighbour);
+					}
+				}
+			}
+			wave.swap(next);
+		}
+		return tiles;
+	}
+
+private:
+	static void tilePoints(const Tile& tile, const std::vector<olc::vf2d>& offsets, std::vector<olc::vf2d>& points) {
+		points.clear();
+		for (const auto& offset : offsets) {
+			olc::vd2d d = olc::vd2d(offset);
+			points.push_back(olc::vf2d(tile.flipped ? tile.centre - d : tile.centre + d));
+		}
+	}
+
+	// Every vertex inside the region and no edge crossing its boundary
+	static bool insideRegion(const std::vector<olc::vf2d>& region, const std::vector<olc::vf2d>& points) {
+		for (const auto& point : points) {
+			if (!TessPolygon::containsPoint(region.data(), region.size(), point)) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < points.size(); ++i) {
+			const olc::vf2d& a = points[i];
+			const olc::vf2d& b = points[(i + 1) % points.size()];
+			for (size_t j = 0; j < region.size(); ++j) {
+				if (TessPolygon::segmentsCross(a, b, region[j], region[(j + 1) % region.size()])) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+};
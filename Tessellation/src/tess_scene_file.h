@@ -0,0 +1,771 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_scene_file.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Saves the placed shapes to a compact binary .tess file and maps one back
+	into memory.
+
+	A file is a fixed size header followed by a repeat record and arrays of
+	fixed size, little endian records:
+
+		Header
+		RepeatRecord                     A unit cell repeated on a lattice, if any
+		PrototypeRecord[prototypeCount]  One per distinct outline
+		VertexRecord[vertexCount]        The outlines, relative to their centroids
+		uint32_t[paletteCount]           Fill colors, as olc::Pixel values
+		OrderRun[repeat.runCount]        The order of the shapes, when it differs
+		CellOffset[repeat.cellCount]     Fractions of the cell tiles' positions
+		TileRecord[tileCount]            Prototype, rotation, position and color of each shape
+
+	A scene that is largely a periodic patch is stored as its unit cell, the
+	first repeat.cellCount tiles, with the lattice vectors and the number of
+	copies each way (see tess_periodicity.h), followed by the tiles that
+	aren't part of the repeat. The lattice vectors and cell positions are
+	kept to 1/65536 of a stored unit, so a tiling with irrational sides
+	repeats without drift, and each copy is rounded to stored units as it is
+	expanded. The sequence is the copies, row by row, then the other tiles.
+	If the scene held its shapes in a different order, or the block has
+	copies no shape was at, the order runs list the shapes as ranges of that
+	sequence, so reading the file back gives the same shapes in the same
+	order. The repeat is only used when it at least halves the tile records;
+	otherwise every shape has its own tile. Version 1 files, which have no
+	repeat record, are still read.
+
+	Positions and outlines are stored in hundredths of a world unit, the
+	precision TessShape rounds its vertices to, and rotations in hundredths
+	of a degree. The header holds an FNV-1a checksum of everything after it.
+
+	Loading maps the file and validates it once; the records are then read
+	in place through the tiles(), prototypes() ... pointers, with no
+	parsing. The mapping lasts until close() or the destructor.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_periodicity.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+static_assert(std::endian::native == std::endian::little, "The .tess records are read in place, which needs a little endian host");
+
+// ***************************
+// A read only memory mapping of a whole file
+// ***************************
+
+class TessMappedFile {
+public:
+	TessMappedFile() {}
+	TessMappedFile(const TessMappedFile&) = delete;
+	TessMappedFile& operator=(const TessMappedFile&) = delete;
+
+	~TessMappedFile() {
+		close();
+	}
+
+	bool open(const std::string& path) {
+		close();
+#if defined(_WIN32)
+		hFile_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hFile_ == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(hFile_, &size) || size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		size_ = (size_t)size.QuadPart;
+		hMapping_ = CreateFileMappingA(hFile_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		pData_ = hMapping_ ? (const uint8_t*)MapViewOfFile(hMapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+		fd_ = ::open(path.c_str(), O_RDONLY);
+		if (fd_ < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd_, &info) != 0 || info.st_size == 0) {
+			close();
+			return false;
+		}
+		size_ = (size_t)info.st_size;
+		void* pMapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+		pData_ = pMapped == MAP_FAILED ? nullptr : (const uint8_t*)pMapped;
+#endif
+		if (!pData_) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#if defined(_WIN32)
+		if (pData_) {
+			UnmapViewOfFile(pData_);
+		}
+		if (hMapping_) {
+			CloseHandle(hMapping_);
+		}
+		if (hFile_ != INVALID_HANDLE_VALUE) {
+			CloseHandle(hFile_);
+		}
+		hMapping_ = nullptr;
+		hFile_ = INVALID_HANDLE_VALUE;
+#else
+		if (pData_) {
+			munmap((void*)pData_, size_);
+		}
+		if (fd_ >= 0) {
+			::close(fd_);
+		}
+		fd_ = -1;
+#endif
+		pData_ = nullptr;
+		size_ = 0;
+	}
+
+	const uint8_t* data() const { return pData_; }
+	size_t size() const { return size_; }
+
+private:
+	const uint8_t* pData_ = nullptr;
+	size_t size_ = 0;
+#if defined(_WIN32)
+	HANDLE hFile_ = INVALID_HANDLE_VALUE;
+	HANDLE hMapping_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+};
+
+// ***************************
+// The .tess scene file
+// ***************************
+
+class TessSceneFile {
+public:
+	static constexpr uint32_t VERSION = 2;
+	static constexpr float POSITION_SCALE = 100.0f;  // Stored units per world unit
+	static constexpr float ROTATION_SCALE = 100.0f;  // Stored units per degree
+	static constexpr uint8_t NO_COLOR = 0xFF;        // Palette index of an unfilled shape
+	static constexpr int32_t CUSTOM_SHAPE = -1;      // Shape type of an outline that isn't a built in shape
+
+	struct Header {
+		char magic[4];            // "TESS"
+		uint32_t version;
+		uint32_t prototypeCount;
+		uint32_t vertexCount;
+		uint32_t paletteCount;
+		uint32_t reserved;
+		uint64_t tileCount;
+		uint64_t checksum;        // FNV-1a of the bytes after the header
+	};
+
+	struct RepeatRecord {
+		int64_t ax;               // Lattice vectors, in 1/TessPeriodicity::FINE of a stored unit
+		int64_t ay;
+		int64_t bx;
+		int64_t by;
+		uint32_t countA;          // Copies of the cell along a and b
+		uint32_t countB;
+		uint32_t cellCount;       // Tiles in the cell, 0 if there is no repeat
+		uint32_t runCount;        // Order runs, 0 if the shapes are the whole sequence in order
+	};
+
+	// A cell tile is at its tile record's position plus dx, dy in
+	// 1/TessPeriodicity::FINE of a stored unit
+	struct CellOffset {
+		int32_t dx;
+		int32_t dy;
+	};
+
+	// The shapes at positions [first, first + count) of the sequence the
+	// repeat expands to, next in the scene's order
+	struct OrderRun {
+		uint64_t first;
+		uint64_t count;
+	};
+
+	struct PrototypeRecord {
+		int32_t shapeType;        // The prototype id of the shape, or CUSTOM_SHAPE
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t reserved;
+	};
+
+	struct VertexRecord {
+		int32_t x;
+		int32_t y;
+	};
+
+	struct TileRecord {
+		int32_t x;                // Centroid
+		int32_t y;
+		int32_t rotation;         // As the shape holds it, [-360, 360] degrees
+		uint16_t prototype;
+		uint8_t color;            // Palette index or NO_COLOR
+		uint8_t reserved;
+	};
+
+	static_assert(sizeof(Header) == 40 && sizeof(RepeatRecord) == 48 && sizeof(OrderRun) == 16 && sizeof(CellOffset) == 8 && sizeof(PrototypeRecord) == 16 &&
+		sizeof(VertexRecord) == 8 && sizeof(TileRecord) == 16, "The .tess records must match the file layout");
+
+	// FNV-1a, continued from hash
+	static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+	static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+	static uint64_t checksum(uint64_t hash, const void* pData, size_t size) {
+		const uint8_t* p = (const uint8_t*)pData;
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ p[i]) * FNV_PRIME;
+		}
+		return hash;
+	}
+
+	static VertexRecord quantize(const olc::vf2d& point) {
+		return { (int32_t)std::lround(point.x * POSITION_SCALE), (int32_t)std::lround(point.y * POSITION_SCALE) };
+	}
+
+	// Check that every prototype's outline and every tile's prototype and
+	// color index are in range
+	static bool checkRecords(const PrototypeRecord* pPrototypes, size_t prototypeCount, size_t vertexCount, size_t paletteCount,
+		const TileRecord* pTiles, size_t tileCount, std::string& error) {
+		for (size_t i = 0; i < prototypeCount; ++i) {
+			const PrototypeRecord& prototype = pPrototypes[i];
+			if (prototype.vertexCount < 3 || prototype.firstVertex > vertexCount || prototype.vertexCount > vertexCount - prototype.firstVertex) {
+				error = "bad prototype " + std::to_string(i);
+				return false;
+			}
+		}
+		for (size_t i = 0; i < tileCount; ++i) {
+			if (pTiles[i].prototype >= prototypeCount || (pTiles[i].color != NO_COLOR && pTiles[i].color >= paletteCount)) {
+				error = "bad tile " + std::to_string(i);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct VertexLess {
+		bool operator()(const std::vector<VertexRecord>& a, const std::vector<VertexRecord>& b) const {
+			return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](const VertexRecord& p, const VertexRecord& q) {
+				return p.x != q.x ? p.x < q.x : p.y < q.y;
+			});
+		}
+	};
+
+	// The prototype, vertex and palette tables of a scene, built up as shapes
+	// are encoded into tile records
+	class Tables {
+	public:
+		std::vector<PrototypeRecord> prototypes;
+		std::vector<VertexRecord> vertices;
+		std::vector<uint32_t> palette;
+
+		// Start from tables read from a file, so shapes encoded from now on
+		// share their records
+		void assign(const PrototypeRecord* pPrototypes, size_t prototypeCount, const VertexRecord* pVertices, size_t vertexCount,
+			const uint32_t* pPalette, size_t paletteCount) {
+			prototypes.assign(pPrototypes, pPrototypes + prototypeCount);
+			vertices.assign(pVertices, pVertices + vertexCount);
+			palette.assign(pPalette, pPalette + paletteCount);
+			builtInPrototypes_.clear();
+			customPrototypes_.clear();
+			colors_.clear();
+			for (size_t i = 0; i < prototypes.size(); ++i) {
+				const PrototypeRecord& prototype = prototypes[i];
+				if (prototype.shapeType != CUSTOM_SHAPE) {
+					builtInPrototypes_[prototype.shapeType] = (uint16_t)i;
+				}
+				else {
+					customPrototypes_[std::vector<VertexRecord>(vertices.begin() + prototype.firstVertex,
+						vertices.begin() + prototype.firstVertex + prototype.vertexCount)] = (uint16_t)i;
+				}
+			}
+			for (size_t i = 0; i < palette.size(); ++i) {
+				colors_[palette[i]] = (uint8_t)i;
+			}
+		}
+
+		// Fill in the tile record of a shape, adding its prototype and color to
+		// the tables if they are new
+		bool encode(TessShape& shape, TileRecord& tile, std::string& error) {
+			// Built in shapes share one prototype per type. Any other outline is
+			// stored as it is drawn, unrotated.
+			int type = shape.getPrototype();
+			float rotation = shape.getRotation();
+			std::vector<VertexRecord> outline;
+			if (type >= 0) {
+				if (!builtInPrototypes_.count(type)) {
+					for (const auto& point : shape.getOutline()) {
+						outline.push_back(quantize(point));
+					}
+				}
+			}
+			else {
+				olc::vf2d centroid = shape.getCentroid();
+				for (const auto& point : shape.getDrawPoints()) {
+					outline.push_back(quantize(point - centroid));
+				}
+				rotation = 0.0f;
+			}
+			return encode(type >= 0 ? type : CUSTOM_SHAPE, outline.data(), outline.size(), quantize(shape.getCentroid()),
+				(int32_t)std::lround(rotation * ROTATION_SCALE), shape.getColor().n, tile, error);
+		}
+
+		// Fill in a tile record from stored values: the shape type, the outline
+		// (only read for custom shapes and new built in types), the position,
+		// the rotation and the color as an olc::Pixel value
+		bool encode(int32_t shapeType, const VertexRecord* pOutline, size_t outlineSize, const VertexRecord& position, int32_t rotation,
+			uint32_t color, TileRecord& tile, std::string& error) {
+			std::memset(&tile, 0, sizeof(tile));
+			if (shapeType != CUSTOM_SHAPE) {
+				auto it = builtInPrototypes_.find(shapeType);
+				if (it != builtInPrototypes_.end()) {
+					tile.prototype = it->second;
+				}
+				else if (!addPrototype(shapeType, std::vector<VertexRecord>(pOutline, pOutline + outlineSize), tile.prototype, error)) {
+					return false;
+				}
+			}
+			else {
+				std::vector<VertexRecord> outline(pOutline, pOutline + outlineSize);
+				auto it = customPrototypes_.find(outline);
+				if (it != customPrototypes_.end()) {
+					tile.prototype = it->second;
+				}
+				else if (!addPrototype(shapeType, outline, tile.prototype, error)) {
+					return false;
+				}
+			}
+			tile.x = position.x;
+			tile.y = position.y;
+			tile.rotation = rotation;
+			return encodeColor(color, tile.color, error);
+		}
+
+		// The palette index of a color, NO_COLOR for olc::BLANK
+		bool encodeColor(uint32_t color, uint8_t& index, std::string& error) {
+			index = NO_COLOR;
+			if (color == olc::BLANK.n) {
+				return true;
+			}
+			auto it = colors_.find(color);
+			if (it == colors_.end()) {
+				if (palette.size() >= NO_COLOR) {
+					error = "Too many colors";
+					return false;
+				}
+				it = colors_.emplace(color, (uint8_t)palette.size()).first;
+				palette.push_back(color);
+			}
+			index = it->second;
+			return true;
+		}
+
+	private:
+		std::unordered_map<int, uint16_t> builtInPrototypes_;                    // Prototype id to record
+		std::map<std::vector<VertexRecord>, uint16_t, VertexLess> customPrototypes_; // Outline to record
+		std::unordered_map<uint32_t, uint8_t> colors_;                           // Pixel to palette index
+
+		bool addPrototype(int32_t shapeType, const std::vector<VertexRecord>& outline, uint16_t& index, std::string& error) {
+			if (prototypes.size() > UINT16_MAX) {
+				error = "Too many distinct shapes";
+				return false;
+			}
+			if (outline.size() < 3) {
+				error = "Shape with fewer than 3 vertices";
+				return false;
+			}
+			index = (uint16_t)prototypes.size();
+			prototypes.push_back({ shapeType, (uint32_t)vertices.size(), (uint32_t)outline.size(), 0 });
+			vertices.insert(vertices.end(), outline.begin(), outline.end());
+			if (shapeType != CUSTOM_SHAPE) {
+				builtInPrototypes_[shapeType] = index;
+			}
+			else {
+				customPrototypes_[outline] = index;
+			}
+			return true;
+		}
+	};
+
+	// Write the shapes to path. The file is written next to path and renamed
+	// over it, so a failed save leaves the old file intact.
+	// pChecksum, if given, receives the header checksum of the new file.
+	static bool save(const std::string& path, const std::vector<std::unique_ptr<TessShape>>& upShapes, std::string& error,
+		uint64_t* pChecksum = nullptr) {
+		Tables tables;
+		std::vector<TileRecord> tiles(upShapes.size());
+		for (size_t i = 0; i < upShapes.size(); ++i) {
+			if (!tables.encode(*upShapes[i], tiles[i], error)) {
+				return false;
+			}
+		}
+		return write(path, tables, tiles, error, pChecksum);
+	}
+
+	// Write tables and tile records that are already encoded, the same way.
+	// A periodic scene is stored as its unit cell and repeat extents.
+	static bool write(const std::string& path, const Tables& tables, const std::vector<TileRecord>& tiles, std::string& error,
+		uint64_t* pChecksum = nullptr) {
+		const std::vector<PrototypeRecord>& prototypes = tables.prototypes;
+		const std::vector<VertexRecord>& vertices = tables.vertices;
+		const std::vector<uint32_t>& palette = tables.palette;
+
+		RepeatRecord repeat = {};
+		std::vector<OrderRun> runs;
+		std::vector<CellOffset> offsets;
+		std::vector<TileRecord> stored;
+		compress(tiles, repeat, runs, offsets, stored);
+		const std::vector<TileRecord>& written = repeat.cellCount > 0 ? stored : tiles;
+
+		Header header = {};
+		std::memcpy(header.magic, "TESS", 4);
+		header.version = VERSION;
+		header.prototypeCount = (uint32_t)prototypes.size();
+		header.vertexCount = (uint32_t)vertices.size();
+		header.paletteCount = (uint32_t)palette.size();
+		header.tileCount = written.size();
+		header.checksum = FNV_OFFSET;
+		header.checksum = checksum(header.checksum, &repeat, sizeof(repeat));
+		header.checksum = checksum(header.checksum, prototypes.data(), prototypes.size() * sizeof(PrototypeRecord));
+		header.checksum = checksum(header.checksum, vertices.data(), vertices.size() * sizeof(VertexRecord));
+		header.checksum = checksum(header.checksum, palette.data(), palette.size() * sizeof(uint32_t));
+		header.checksum = checksum(header.checksum, runs.data(), runs.size() * sizeof(OrderRun));
+		header.checksum = checksum(header.checksum, offsets.data(), offsets.size() * sizeof(CellOffset));
+		header.checksum = checksum(header.checksum, written.data(), written.size() * sizeof(TileRecord));
+
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			out.write((const char*)&header, sizeof(header));
+			out.write((const char*)&repeat, sizeof(repeat));
+			out.write((const char*)prototypes.data(), prototypes.size() * sizeof(PrototypeRecord));
+			out.write((const char*)vertices.data(), vertices.size() * sizeof(VertexRecord));
+			out.write((const char*)palette.data(), palette.size() * sizeof(uint32_t));
+			out.write((const char*)runs.data(), runs.size() * sizeof(OrderRun));
+			out.write((const char*)offsets.data(), offsets.size() * sizeof(CellOffset));
+			out.write((const char*)written.data(), written.size() * sizeof(TileRecord));
+			if (!out) {
+				error = "Could not write " + tempPath;
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			error = "Could not replace " + path + ": " + ec.message();
+			return false;
+		}
+		if (pChecksum) {
+			*pChecksum = header.checksum;
+		}
+		return true;
+	}
+
+	// Map the file at path and check it. On failure the file is closed and
+	// error says why.
+	bool open(const std::string& path, std::string& error) {
+		close();
+		if (!file_.open(path)) {
+			error = "Could not open " + path;
+			return false;
+		}
+		if (!validate(error)) {
+			error = path + ": " + error;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		file_.close();
+		pHeader_ = nullptr;
+		pRepeat_ = nullptr;
+	}
+
+	bool isOpen() const { return pHeader_ != nullptr; }
+
+	const Header& header() const { return *pHeader_; }
+	const RepeatRecord& repeat() const { return pRepeat_ ? *pRepeat_ : NO_REPEAT; }
+	const PrototypeRecord* prototypes() const { return (const PrototypeRecord*)(pRepeat_ ? (const uint8_t*)(pRepeat_ + 1) : (const uint8_t*)(pHeader_ + 1)); }
+	const VertexRecord* vertices() const { return (const VertexRecord*)(prototypes() + pHeader_->prototypeCount); }
+	const uint32_t* palette() const { return (const uint32_t*)(vertices() + pHeader_->vertexCount); }
+	const OrderRun* orderRuns() const { return (const OrderRun*)(palette() + pHeader_->paletteCount); }
+	const CellOffset* cellOffsets() const { return (const CellOffset*)(orderRuns() + repeat().runCount); }
+	const TileRecord* tiles() const { return (const TileRecord*)(cellOffsets() + repeat().cellCount); }
+
+	// Number of shapes in the scene, counting every copy of the unit cell
+	uint64_t shapeCount() const {
+		const RepeatRecord& r = repeat();
+		if (r.runCount == 0) {
+			return sequenceLength();
+		}
+		uint64_t count = 0;
+		for (uint32_t i = 0; i < r.runCount; ++i) {
+			count += orderRuns()[i].count;
+		}
+		return count;
+	}
+
+	// The tile record of every shape, in the scene's order, with the copies
+	// of the unit cell expanded
+	void expandTiles(std::vector<TileRecord>& expanded) const {
+		const RepeatRecord& r = repeat();
+		expanded.resize(shapeCount());
+		if (r.runCount == 0) {
+			expandRange(0, expanded.size(), expanded.data());
+			return;
+		}
+		TileRecord* pOut = expanded.data();
+		const OrderRun* pRuns = orderRuns();
+		for (uint32_t i = 0; i < r.runCount; ++i) {
+			expandRange(pRuns[i].first, pRuns[i].count, pOut);
+			pOut += pRuns[i].count;
+		}
+	}
+
+	// Stored values to world units and degrees
+	static olc::vf2d position(int32_t x, int32_t y) {
+		return olc::vf2d((float)x / POSITION_SCALE, (float)y / POSITION_SCALE);
+	}
+
+	static float rotation(const TileRecord& tile) {
+		return (float)tile.rotation / ROTATION_SCALE;
+	}
+
+private:
+	static constexpr RepeatRecord NO_REPEAT = {};
+
+	TessMappedFile file_;
+	const Header* pHeader_ = nullptr;
+	const RepeatRecord* pRepeat_ = nullptr;  // nullptr in a version 1 file
+
+	// Length of the sequence the repeat expands to: the copies of the cell,
+	// then the other tiles
+	uint64_t sequenceLength() const {
+		const RepeatRecord& r = repeat();
+		return pHeader_->tileCount - r.cellCount + (uint64_t)r.cellCount * r.countA * r.countB;
+	}
+
+	// Store tiles as a repeated unit cell if that at least halves the tile
+	// records, counting the order runs. Otherwise repeat.cellCount is 0.
+	static void compress(const std::vector<TileRecord>& tiles, RepeatRecord& repeat, std::vector<OrderRun>& runs,
+		std::vector<CellOffset>& offsets, std::vector<TileRecord>& stored) {
+		repeat = {};
+		TessPeriodicity::Repeat found;
+		if (!TessPeriodicity::mayRepeat(tiles.data(), tiles.size()) ||
+			!TessPeriodicity::find(tiles.data(), tiles.size(), found) || found.cell.size() > UINT32_MAX) {
+			return;
+		}
+		for (size_t t = 0; t < found.order.size(); ++t) {
+			if (t > 0 && found.order[t] == found.order[t - 1] + 1) {
+				runs.back().count += 1;
+			}
+			else {
+				runs.push_back({ found.order[t], 1 });
+			}
+		}
+		if (runs.size() == 1 && runs[0].first == 0 && runs[0].count == found.repeatedCount() + found.residual.size()) {
+			runs.clear(); // The whole sequence, in order
+		}
+		if ((found.cell.size() + found.residual.size() + runs.size()) * 2 > tiles.size() || runs.size() > UINT32_MAX) {
+			runs.clear();
+			return;
+		}
+
+		stored.reserve(found.cell.size() + found.residual.size());
+		offsets.reserve(found.cell.size());
+		for (const TessPeriodicity::CellTile& cellTile : found.cell) {
+			TileRecord tile = tiles[cellTile.tile];
+			int64_t x = TessPeriodicity::position(cellTile.x, 0, 0, 0, 0);
+			int64_t y = TessPeriodicity::position(cellTile.y, 0, 0, 0, 0);
+			if (x < INT32_MIN || x > INT32_MAX || y < INT32_MIN || y > INT32_MAX) {
+				runs.clear();
+				offsets.clear();
+				stored.clear();
+				return;
+			}
+			tile.x = (int32_t)x;
+			tile.y = (int32_t)y;
+			stored.push_back(tile);
+			offsets.push_back({ (int32_t)(cellTile.x - x * TessPeriodicity::FINE), (int32_t)(cellTile.y - y * TessPeriodicity::FINE) });
+		}
+		for (uint32_t t : found.residual) {
+			stored.push_back(tiles[t]);
+		}
+		repeat.ax = found.ax;
+		repeat.ay = found.ay;
+		repeat.bx = found.bx;
+		repeat.by = found.by;
+		repeat.countA = found.countA;
+		repeat.countB = found.countB;
+		repeat.cellCount = (uint32_t)found.cell.size();
+		repeat.runCount = (uint32_t)runs.size();
+	}
+
+	// The position of cell tile k in copy (i, j), in 1/FINE units before
+	// rounding to stored units
+	void cellPosition(uint32_t k, int64_t& x, int64_t& y) const {
+		const TileRecord& tile = tiles()[k];
+		const CellOffset& offset = cellOffsets()[k];
+		x = (int64_t)tile.x * TessPeriodicity::FINE + offset.dx;
+		y = (int64_t)tile.y * TessPeriodicity::FINE + offset.dy;
+	}
+
+	// Write the count shapes from position first of the expanded sequence:
+	// the copies of the cell row by row, then the other tiles
+	void expandRange(uint64_t first, uint64_t count, TileRecord* pOut) const {
+		const RepeatRecord& r = repeat();
+		const TileRecord* pTiles = tiles();
+		uint64_t repeated = (uint64_t)r.cellCount * r.countA * r.countB;
+		for (uint64_t s = first; s < first + count; ++s) {
+			if (s >= repeated) {
+				*pOut++ = pTiles[r.cellCount + (s - repeated)];
+				continue;
+			}
+			uint64_t copy = s / r.cellCount;
+			int64_t i = (int64_t)(copy % r.countA);
+			int64_t j = (int64_t)(copy / r.countA);
+			uint32_t k = (uint32_t)(s % r.cellCount);
+			int64_t x, y;
+			cellPosition(k, x, y);
+			TileRecord tile = pTiles[k];
+			tile.x = (int32_t)TessPeriodicity::position(x, i, r.ax, j, r.bx);
+			tile.y = (int32_t)TessPeriodicity::position(y, i, r.ay, j, r.by);
+			*pOut++ = tile;
+		}
+	}
+
+	// Check that the copies of the unit cell stay in range and that the
+	// order runs list shapes of the sequence at most once
+	bool checkRepeat(std::string& error) const {
+		const RepeatRecord& r = repeat();
+		if (r.cellCount == 0) {
+			if (r.runCount != 0) {
+				error = "order runs without a repeat";
+				return false;
+			}
+			return true;
+		}
+		// Longer rows of copies could overflow before the range check
+		const int64_t LONGEST = (int64_t)1 << 60;
+		if (r.cellCount > pHeader_->tileCount || r.countA == 0 || r.countB == 0 ||
+			r.cellCount > UINT64_MAX / ((uint64_t)r.countA * r.countB) / 2 ||
+			std::max(std::abs(r.ax), std::abs(r.ay)) > LONGEST / r.countA || std::max(std::abs(r.bx), std::abs(r.by)) > LONGEST / r.countB) {
+			error = "bad repeat";
+			return false;
+		}
+		int64_t ia = (int64_t)(r.countA - 1);
+		int64_t jb = (int64_t)(r.countB - 1);
+		for (uint32_t k = 0; k < r.cellCount; ++k) {
+			int64_t cellX, cellY;
+			cellPosition(k, cellX, cellY);
+			for (int64_t corner = 0; corner < 4; ++corner) {
+				int64_t i = corner & 1 ? ia : 0;
+				int64_t j = corner & 2 ? jb : 0;
+				int64_t x = TessPeriodicity::position(cellX, i, r.ax, j, r.bx);
+				int64_t y = TessPeriodicity::position(cellY, i, r.ay, j, r.by);
+				if (x < INT32_MIN || x > INT32_MAX || y < INT32_MIN || y > INT32_MAX) {
+					error = "repeat out of range";
+					return false;
+				}
+			}
+		}
+		if (r.runCount > 0) {
+			std::vector<OrderRun> runs(orderRuns(), orderRuns() + r.runCount);
+			std::sort(runs.begin(), runs.end(), [](const OrderRun& p, const OrderRun& q) { return p.first < q.first; });
+			uint64_t length = sequenceLength();
+			uint64_t next = 0;
+			for (const OrderRun& run : runs) {
+				if (run.first < next || run.count == 0 || run.first > length || run.count > length - run.first) {
+					error = "bad order runs";
+					return false;
+				}
+				next = run.first + run.count;
+			}
+		}
+		return true;
+	}
+
+	// Check the header, the section sizes, the checksum and every index
+	bool validate(std::string& error) {
+		const uint8_t* pData = file_.data();
+		size_t size = file_.size();
+		if (size < sizeof(Header) || std::memcmp(pData, "TESS", 4) != 0) {
+			error = "not a .tess file";
+			return false;
+		}
+		const Header* pHeader = (const Header*)pData;
+		if (pHeader->version != 1 && pHeader->version != VERSION) {
+			error = "unsupported version " + std::to_string(pHeader->version);
+			return false;
+		}
+		const RepeatRecord* pRepeat = nullptr;
+		uint64_t expected = sizeof(Header);
+		if (pHeader->version >= 2) {
+			if (size < sizeof(Header) + sizeof(RepeatRecord)) {
+				error = "truncated or oversized file";
+				return false;
+			}
+			pRepeat = (const RepeatRecord*)(pHeader + 1);
+			expected += sizeof(RepeatRecord) + (uint64_t)pRepeat->runCount * sizeof(OrderRun) + (uint64_t)pRepeat->cellCount * sizeof(CellOffset);
+		}
+		expected += (uint64_t)pHeader->prototypeCount * sizeof(PrototypeRecord) +
+			(uint64_t)pHeader->vertexCount * sizeof(VertexRecord) + (uint64_t)pHeader->paletteCount * sizeof(uint32_t);
+		if (pHeader->tileCount > (size - std::min<uint64_t>(expected, size)) / sizeof(TileRecord) ||
+			expected + pHeader->tileCount * sizeof(TileRecord) != size) {
+			error = "truncated or oversized file";
+			return false;
+		}
+		if (checksum(FNV_OFFSET, pData + sizeof(Header), size - sizeof(Header)) != pHeader->checksum) {
+			error = "checksum mismatch";
+			return false;
+		}
+
+		pHeader_ = pHeader;
+		pRepeat_ = pRepeat;
+		if (!checkRecords(prototypes(), pHeader->prototypeCount, pHeader->vertexCount, pHeader->paletteCount, tiles(), pHeader->tileCount, error) ||
+			!checkRepeat(error)) {
+			pHeader_ = nullptr;
+			pRepeat_ = nullptr;
+			return false;
+		}
+		return true;
+	}
+};
@@ -39,8 +39,8 @@
 
 class TessShape {
 public:
-	TessShape(olc::TransformedView* tv, const std::vector<olc::vf2d>& points)
-		: tv_(tv), originalPoints_(points), drawPoints_(points), translation_(0.0f, 0.0f), rotation_(0.0f), dirty_(true) , color_(olc::BLANK), fill_(false)
+	TessShape(olc::TransformedView* tv, const std::vector<olc::vf2d>& points, int prototype = -1)
+		: tv_(tv), originalPoints_(points), drawPoints_(points), translation_(0.0f, 0.0f), rotation_(0.0f), dirty_(true) , color_(olc::BLANK), fill_(false), prototype_(prototype)
 	{
 		originalCentroid_ = computeCentroid(originalPoints_);
 		drawCentroid_ = computeCentroid(originalPoints_);
@@ -82,6 +82,36 @@ public:
 		return rotation_;
 	}
 
+	// Get the prototype id the shape was created from, or -1 if it has none.
+	// Shapes with the same prototype and rotation share the same outline.
+	int getPrototype() const {
+		return prototype_;
+	}
+
+	// Get the vertices relative to the centroid, before rotation and translation
+	std::vector<olc::vf2d> getOutline() const {
+		std::vector<olc::vf2d> outline;
+		for (const auto& point : originalPoints_) {
+			outline.push_back(point - originalCentroid_);
+		}
+		return outline;
+	}
+
+	// Get the fill color, olc::BLANK if the shape is not filled
+	olc::Pixel getColor() const {
+		return color_;
+	}
+
+	// Get the transformed vertices used for drawing
+	const std::vector<olc::vf2d>& getDrawPoints() {
+		if (dirty_) {
+			recalculateDrawPoints();
+			dirty_ = false;
+		}
+
+		return drawPoints_;
+	}
+
 
 	// Draw the shape
 	void draw(olc::Pixel p = olc::WHITE) {
@@ -158,6 +188,7 @@ protected:
 	bool dirty_;                            // Flag to recalculate draw points
 	olc::Pixel color_;                      // Color of the shape
 	bool fill_ = false;                     // Fill the shape with color
+	int prototype_;                         // Prototype id, -1 if none
 
 	// Compute the centroid of the original polygon
 	olc::vf2d computeCentroid(const std::vector<olc::vf2d>& points) const {
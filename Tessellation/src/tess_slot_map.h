@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_slot_map.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A container of owned objects, kept packed in one array so they can be
+	walked and indexed like a std::vector, that also hands out stable
+	handles to them. Any object can be removed in O(1) by moving the last
+	one into its place, and handles to the others keep working, where an
+	index or iterator would now point at the wrong object.
+
+	A handle is a slot and the generation of that slot when the handle was
+	made. Each slot records where its object is in the packed array;
+	removing the object frees the slot and moves it on a generation, so a
+	handle to a removed object is recognised as stale rather than left
+	pointing at whatever the slot or array position holds next.
+
+	Objects are held by std::unique_ptr, so their addresses don't change
+	as the array is reordered, and find() turns an address back into a
+	handle.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_flat_map.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class TessSlotMap {
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+	static constexpr size_t NPOS = SIZE_MAX;
+
+	struct Handle {
+		uint32_t slot = NONE;
+		uint32_t generation = 0;
+
+		bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	using Owned = std::unique_ptr<T>;
+	using const_iterator = typename std::vector<Owned>::const_iterator;
+
+	// ***************************
+	// Packed access, like a std::vector
+	// ***************************
+
+	size_t size() const { return objects_.size(); }
+	bool empty() const { return objects_.empty(); }
+	const Owned& operator[](size_t index) const { return objects_[index]; }
+	const Owned& front() const { return objects_.front(); }
+	const Owned& back() const { return objects_.back(); }
+	const_iterator begin() const { return objects_.begin(); }
+	const_iterator end() const { return objects_.end(); }
+
+	// The objects in packed order, for code that takes a vector of them
+	const std::vector<Owned>& values() const { return objects_; }
+
+	void reserve(size_t count) {
+		objects_.reserve(count);
+		slotOf_.reserve(count);
+		slots_.reserve(count);
+		handles_.reserve(count);
+	}
+
+	// Add an object at the end, returning its handle
+	Handle push_back(Owned upObject) {
+		uint32_t slot;
+		if (!freeSlots_.empty()) {
+			slot = freeSlots_.back();
+			freeSlots_.pop_back();
+		}
+		else {
+			slot = (uint32_t)slots_.size();
+			slots_.push_back({});
+		}
+		slots_[slot].index = objects_.size();
+		handles_[upObject.get()] = slot;
+		slotOf_.push_back(slot);
+		objects_.push_back(std::move(upObject));
+		return { slot, slots_[slot].generation };
+	}
+
+	// Remove the object at index, moving the last object into its place.
+	// Handles to the others stay valid.
+	Owned eraseAt(size_t index) {
+		swap(index, objects_.size() - 1);
+		return popBack();
+	}
+
+	// Exchange the places of two objects. Their handles follow them.
+	void swap(size_t a, size_t b) {
+		if (a == b) {
+			return;
+		}
+		std::swap(objects_[a], objects_[b]);
+		std::swap(slotOf_[a], slotOf_[b]);
+		slots_[slotOf_[a]].index = a;
+		slots_[slotOf_[b]].index = b;
+	}
+
+	// Remove the objects from index begin onward, in order
+	std::vector<Owned> takeFrom(size_t begin) {
+		if (begin == 0) {
+			// Everything goes, so free every slot at once
+			for (uint32_t slot : slotOf_) {
+				slots_[slot].generation += 1;
+				freeSlots_.push_back(slot);
+			}
+			slotOf_.clear();
+			handles_.clear();
+			return std::move(objects_);
+		}
+		std::vector<Owned> upTaken(objects_.size() > begin ? objects_.size() - begin : 0);
+		for (size_t i = upTaken.size(); i > 0; --i) {
+			upTaken[i - 1] = popBack();
+		}
+		return upTaken;
+	}
+
+	void clear() {
+		takeFrom(0);
+	}
+
+	// ***************************
+	// Handles
+	// ***************************
+
+	Handle handleAt(size_t index) const {
+		uint32_t slot = slotOf_[index];
+		return { slot, slots_[slot].generation };
+	}
+
+	// The handle of the object at pObject, or an empty handle if it isn't held
+	Handle find(const T* pObject) const {
+		auto it = handles_.find(pObject);
+		if (it == handles_.end()) {
+			return {};
+		}
+		return { it->second, slots_[it->second].generation };
+	}
+
+	// The object of a handle, or nullptr if it has been removed
+	T* get(Handle handle) const {
+		size_t index = indexOf(handle);
+		return index == NPOS ? nullptr : objects_[index].get();
+	}
+
+	// Where the object of a handle is in packed order, or NPOS if it has
+	// been removed
+	size_t indexOf(Handle handle) const {
+		if (handle.slot >= slots_.size() || slots_[handle.slot].generation != handle.generation) {
+			return NPOS;
+		}
+		return slots_[handle.slot].index;
+	}
+
+private:
+	struct Slot {
+		size_t index = 0;        // Place of the slot's object in objects_, while it has one
+		uint32_t generation = 0; // Moved on each time the slot is freed
+	};
+
+	std::vector<Owned> objects_;
+	std::vector<uint32_t> slotOf_;  // Slot of each object of objects_
+	std::vector<Slot> slots_;
+	std::vector<uint32_t> freeSlots_;
+	TessFlatMap<const T*, uint32_t> handles_; // Slot of each object, by address
+
+	Owned popBack() {
+		uint32_t slot = slotOf_.back();
+		slots_[slot].generation += 1;
+		freeSlots_.push_back(slot);
+		slotOf_.pop_back();
+		Owned upObject = std::move(objects_.back());
+		objects_.pop_back();
+		handles_.erase(upObject.get());
+		return upObject;
+	}
+};
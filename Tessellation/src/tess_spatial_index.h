@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_spatial_index.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A uniform grid hash over the bounding boxes of placed shapes. Each shape
+	is listed in every grid cell its bounds touch, so finding the shapes near
+	a point or a candidate tile only looks at a few cells instead of every
+	shape on the canvas.
+
+	Overlap checks use the grid as the broad phase and a separating axis
+	test on the candidates as the narrow phase.
+
+	A shape that spans several cells is reported once per query: only the
+	cell holding the top left corner of the overlap between the shape's
+	bounds and the query bounds reports it. Queries don't modify the index,
+	so any number of threads may query it at once.
+
+	A batch is bulk loaded: its (cell, shape) pairs are sorted by cell with
+	a counting sort, and each cell's list is then grown once.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_geometry.h"
+#include "tess_flat_map.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class TessSpatialIndex {
+public:
+	// Queries covering more cells than this walk every entry instead
+	static constexpr int64_t MAX_QUERY_CELLS = 4096;
+
+	struct Entry {
+		TessShape* pShape;
+		olc::vf2d vMin;   // Bounds of the shape when it was inserted
+		olc::vf2d vMax;
+	};
+
+	TessSpatialIndex(float cellSize) : cellSize_(cellSize) {}
+
+	void insert(TessShape& shape) {
+		Entry entry = { &shape, {}, {} };
+		bounds(shape.getDrawPoints(), entry.vMin, entry.vMax);
+		insert(entry);
+	}
+
+	// Insert a batch of shapes in one update. Their bounds are found in
+	// parallel, then every (cell, shape) pair is sorted by cell, so each
+	// cell is looked up and grown once for the whole batch.
+	void insert(const std::vector<std::unique_ptr<TessShape>>& upBatch) {
+		std::vector<Entry> entries(upBatch.size());
+		tessParallelFor(upBatch.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				entries[i].pShape = upBatch[i].get();
+				bounds(upBatch[i]->getDrawPoints(), entries[i].vMin, entries[i].vMax);
+			}
+		});
+
+		std::vector<int64_t> cellKeys;
+		std::vector<uint32_t> sortKeys;
+		std::vector<uint32_t> owners;
+		cellKeys.reserve(entries.size() * 2);
+		sortKeys.reserve(entries.size() * 2);
+		owners.reserve(entries.size() * 2);
+		for (size_t i = 0; i < entries.size(); ++i) {
+			forEachCell(entries[i].vMin, entries[i].vMax, [&](int64_t x, int64_t y) {
+				cellKeys.push_back(cellKey(x, y));
+				sortKeys.push_back(TessSpatialOrder::key(x, y));
+				owners.push_back((uint32_t)i);
+			});
+		}
+		std::vector<uint32_t> order = TessSpatialOrder::byKey(sortKeys);
+
+		cells_.reserve(cells_.size() + entries.size());
+		for (size_t k = 0; k < order.size();) {
+			// The pairs of one cell, unless a far away cell shares its sort key
+			int64_t key = cellKeys[order[k]];
+			size_t end = k + 1;
+			while (end < order.size() && cellKeys[order[end]] == key) {
+				++end;
+			}
+			std::vector<Entry>& cell = cells_[key];
+			cell.reserve(cell.size() + (end - k));
+			for (; k < end; ++k) {
+				cell.push_back(entries[owners[order[k]]]);
+			}
+		}
+		shapes_.reserve(shapes_.size() + entries.size());
+		for (const Entry& entry : entries) {
+			shapes_[entry.pShape] = entry;
+		}
+	}
+
+	// Insert a shape with known bounds
+	void insert(const Entry& entry) {
+		forEachCell(entry.vMin, entry.vMax, [&](int64_t x, int64_t y) {
+			cells_[cellKey(x, y)].push_back(entry);
+		});
+		shapes_[entry.pShape] = entry;
+	}
+
+	// Remove a shape. Uses the bounds it was inserted with, so it is safe to call
+	// after the shape has moved.
+	void remove(TessShape* pShape) {
+		auto it = shapes_.find(pShape);
+		if (it == shapes_.end()) {
+			return;
+		}
+		forEachCell(it->second.vMin, it->second.vMax, [&](int64_t x, int64_t y) {
+			auto cell = cells_.find(cellKey(x, y));
+			if (cell == cells_.end()) {
+				return;
+			}
+			auto& entries = cell->second;
+			entries.erase(std::remove_if(entries.begin(), entries.end(),
+				[&](const Entry& e) { return e.pShape == pShape; }), entries.end());
+			if (entries.empty()) {
+				cells_.erase(cell);
+			}
+		});
+		shapes_.erase(it);
+	}
+
+	void clear() {
+		cells_.clear();
+		shapes_.clear();
+	}
+
+	size_t size() const {
+		return shapes_.size();
+	}
+
+	bool contains(TessShape* pShape) const {
+		return shapes_.count(pShape) != 0;
+	}
+
+	// Call fn(const Entry&) once for every shape whose bounds intersect [vMin, vMax]
+	template <typename Fn>
+	void query(const olc::vf2d& vMin, const olc::vf2d& vMax, Fn fn) const {
+		int64_t x0 = cellCoord(vMin.x), x1 = cellCoord(vMax.x);
+		int64_t y0 = cellCoord(vMin.y), y1 = cellCoord(vMax.y);
+		if ((x1 - x0 + 1) * (y1 - y0 + 1) > MAX_QUERY_CELLS) {
+			for (const auto& shape : shapes_) {
+				if (intersects(shape.second, vMin, vMax)) {
+					fn(shape.second);
+				}
+			}
+			return;
+		}
+
+		for (int64_t x = x0; x <= x1; ++x) {
+			for (int64_t y = y0; y <= y1; ++y) {
+				auto cell = cells_.find(cellKey(x, y));
+				if (cell == cells_.end()) {
+					continue;
+				}
+				for (const Entry& entry : cell->second) {
+					if (!intersects(entry, vMin, vMax)) {
+						continue;
+					}
+					// Report the shape from one cell only
+					if (cellCoord(std::max(entry.vMin.x, vMin.x)) == x && cellCoord(std::max(entry.vMin.y, vMin.y)) == y) {
+						fn(entry);
+					}
+				}
+			}
+		}
+	}
+
+	// True if the convex polygon overlaps any indexed shape by more than tolerance.
+	// The grid finds the candidates, a separating axis test decides.
+	bool overlaps(const std::vector<olc::vf2d>& points, float tolerance = TessPolygon::OVERLAP_TOLERANCE, const TessShape* pIgnore = nullptr) const {
+		olc::vf2d vMin, vMax;
+		bounds(points, vMin, vMax);
+		bool overlap = false;
+		query(vMin, vMax, [&](const Entry& entry) {
+			if (!overlap && entry.pShape != pIgnore) {
+				const std::vector<olc::vf2d>& other = entry.pShape->getDrawPoints();
+				overlap = TessPolygon::overlaps(points.data(), points.size(), other.data(), other.size(), tolerance);
+			}
+		});
+		return overlap;
+	}
+
+	// Bounds of a polygon
+	static void bounds(const std::vector<olc::vf2d>& points, olc::vf2d& vMin, olc::vf2d& vMax) {
+		vMin = vMax = points.front();
+		for (const auto& point : points) {
+			vMin = vMin.min(point);
+			vMax = vMax.max(point);
+		}
+	}
+
+private:
+	float cellSize_;
+	TessFlatMap<int64_t, std::vector<Entry>> cells_;
+	TessFlatMap<TessShape*, Entry> shapes_;
+
+	int64_t cellCoord(float v) const {
+		return (int64_t)std::floor(v / cellSize_);
+	}
+
+	static int64_t cellKey(int64_t x, int64_t y) {
+		return (int64_t)((uint64_t)(uint32_t)x << 32 | (uint32_t)y);
+	}
+
+	static bool intersects(const Entry& entry, const olc::vf2d& vMin, const olc::vf2d& vMax) {
+		return entry.vMax.x >= vMin.x && entry.vMin.x <= vMax.x && entry.vMax.y >= vMin.y && entry.vMin.y <= vMax.y;
+	}
+
+	template <typename Fn>
+	void forEachCell(const olc::vf2d& vMin, const olc::vf2d& vMax, Fn fn) const {
+		for (int64_t x = cellCoord(vMin.x); x <= cellCoord(vMax.x); ++x) {
+			for (int64_t y = cellCoord(vMin.y); y <= cellCoord(vMax.y); ++y) {
+				fn(x, y);
+			}
+		}
+	}
+};
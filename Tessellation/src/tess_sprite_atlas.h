@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_sprite_atlas.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A cache of pre-rasterized shape sprites. At a given zoom level every
+	placed shape with the same prototype, rotation and colors rasterizes to
+	the same pixels (up to a subpixel offset), so each combination is drawn
+	once into a sprite and then blitted for every tile that uses it. The
+	least recently drawn sprites are dropped once the cache passes its byte
+	budget.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class TessSpriteAtlas {
+public:
+	// Sprites larger than this (in screen pixels) are not cached. At that zoom
+	// level only a handful of shapes are visible, so drawing them directly is cheap.
+	static constexpr int32_t MAX_SPRITE_SIZE = 256;
+
+	// Memory the cached sprites may use before the least recently drawn are
+	// dropped. Many colors and rotations of many prototypes would otherwise
+	// grow the cache until the next zoom change.
+	static constexpr size_t MAX_BYTES = 32 * 1024 * 1024;
+
+	TessSpriteAtlas(olc::PixelGameEngine* pge) : pge_(pge) {}
+
+	// Set the zoom level the sprites are rasterized at.
+	// Changing it invalidates every cached sprite.
+	void setZoom(float zoom) {
+		if (zoom != zoom_) {
+			clear();
+			zoom_ = zoom;
+		}
+	}
+
+	// Drop every cached sprite
+	void clear() {
+		entries_.clear();
+		lru_.clear();
+		bytes_ = 0;
+	}
+
+	// Draw the shape by blitting its cached sprite, rasterizing it first on a miss.
+	// Returns false if the shape can't be drawn from the atlas (it has no prototype
+	// or is too large on screen), in which case the caller should use TessShape::draw().
+	bool draw(TessShape& shape, const olc::TransformedView& tv, olc::Pixel outline) {
+		if (shape.getPrototype() < 0) {
+			return false;
+		}
+
+		olc::vf2d centroid = shape.getCentroid();
+		return draw(shape.getPrototype(), rotationKey(shape.getRotation()), shape.getDrawPoints(), centroid, centroid, shape.getColor(), outline, tv);
+	}
+
+	// Draw any polygon whose outline is identified by (geometry, rotation).
+	// On a miss the sprite is rasterized from points, relative to origin; the
+	// sprite is then drawn with origin moved to the world position.
+	bool draw(int geometry, int rotation, const std::vector<olc::vf2d>& points, const olc::vf2d& origin,
+		const olc::vf2d& position, olc::Pixel fill, olc::Pixel outline, const olc::TransformedView& tv) {
+		AtlasKey key = { geometry, rotation, fill.n, outline.n };
+		auto it = entries_.find(key);
+		if (it == entries_.end()) {
+			it = entries_.emplace(key, rasterize(points, origin, fill, outline)).first;
+			lru_.push_front(key);
+			it->second.lruPos = lru_.begin();
+			bytes_ += entryBytes(it->second);
+			evict();
+		}
+		else if (it->second.lruPos != lru_.begin()) {
+			lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+		}
+
+		const AtlasEntry& entry = it->second;
+		if (!entry.upSprite) {
+			return false;
+		}
+
+		olc::vf2d screenPos = tv.WorldToScreen(position);
+		olc::vi2d pos = olc::vi2d((int32_t)std::floor(screenPos.x), (int32_t)std::floor(screenPos.y)) - entry.anchor;
+
+		// Nothing to do if the sprite is entirely off screen
+		if (pos.x >= pge_->ScreenWidth() || pos.y >= pge_->ScreenHeight() ||
+			pos.x + entry.upSprite->width <= 0 || pos.y + entry.upSprite->height <= 0) {
+			return true;
+		}
+
+		// Blit with masking so the transparent corners of the sprite are skipped
+		olc::Pixel::Mode mode = pge_->GetPixelMode();
+		pge_->SetPixelMode(olc::Pixel::MASK);
+		pge_->DrawSprite(pos, entry.upSprite.get());
+		pge_->SetPixelMode(mode);
+		return true;
+	}
+
+	// Rotation key for a rotation in degrees: hundredths of a degree, normalized to [0, 36000)
+	static int rotationKey(float rotation) {
+		int key = (int)std::lround(rotation * 100.0f) % 36000;
+		return key < 0 ? key + 36000 : key;
+	}
+
+	// Number of cached sprites
+	size_t size() const {
+		return entries_.size();
+	}
+
+private:
+	struct AtlasKey {
+		int geometry;      // Prototype id, or another id for shapes without one
+		int rotation;      // Rotation key, see rotationKey()
+		uint32_t fill;     // Fill color
+		uint32_t outline;  // Outline color
+
+		bool operator==(const AtlasKey& other) const {
+			return geometry == other.geometry && rotation == other.rotation &&
+				fill == other.fill && outline == other.outline;
+		}
+	};
+
+	struct AtlasKeyHash {
+		size_t operator()(const AtlasKey& key) const {
+			uint64_t h = ((uint64_t)(uint32_t)key.geometry << 32) | (uint32_t)key.rotation;
+			h ^= ((uint64_t)key.fill << 32 | key.outline) * 0x9E3779B97F4A7C15ull;
+			return std::hash<uint64_t>()(h);
+		}
+	};
+
+	struct AtlasEntry {
+		std::unique_ptr<olc::Sprite> upSprite; // nullptr if the shape is too large to cache
+		olc::vi2d anchor;                      // Position of the shape centroid within the sprite
+		std::list<AtlasKey>::iterator lruPos;  // Position in lru_
+	};
+
+	olc::PixelGameEngine* pge_;
+	float zoom_ = 0.0f;
+	std::unordered_map<AtlasKey, AtlasEntry, AtlasKeyHash> entries_;
+	std::list<AtlasKey> lru_; // Most recently drawn first
+	size_t bytes_ = 0;
+
+	// Bytes an entry accounts for: its pixels plus the bookkeeping around them
+	static size_t entryBytes(const AtlasEntry& entry) {
+		size_t bytes = sizeof(AtlasEntry) + sizeof(AtlasKey) * 2;
+		if (entry.upSprite) {
+			bytes += (size_t)entry.upSprite->width * entry.upSprite->height * sizeof(olc::Pixel);
+		}
+		return bytes;
+	}
+
+	// Drop the least recently drawn sprites until the cache is within budget.
+	// The most recent one is always kept, as the caller is about to draw it.
+	void evict() {
+		while (bytes_ > MAX_BYTES && lru_.size() > 1) {
+			auto it = entries_.find(lru_.back());
+			bytes_ -= entryBytes(it->second);
+			entries_.erase(it);
+			lru_.pop_back();
+		}
+	}
+
+	// Rasterize the polygon, positioned relative to origin, into a new sprite
+	AtlasEntry rasterize(const std::vector<olc::vf2d>& worldPoints, const olc::vf2d& origin, olc::Pixel fill, olc::Pixel outline) {
+		AtlasEntry entry;
+
+		// Polygon outline in screen pixels, relative to the origin
+		std::vector<olc::vf2d> points;
+		points.reserve(worldPoints.size());
+		olc::vf2d vMin = { 0.0f, 0.0f };
+		olc::vf2d vMax = { 0.0f, 0.0f };
+		for (const auto& point : worldPoints) {
+			olc::vf2d local = (point - origin) * zoom_;
+			vMin = vMin.min(local);
+			vMax = vMax.max(local);
+			points.push_back(local);
+		}
+
+		entry.anchor = { -(int32_t)std::floor(vMin.x), -(int32_t)std::floor(vMin.y) };
+		int32_t width = (int32_t)std::ceil(vMax.x) + entry.anchor.x + 2;
+		int32_t height = (int32_t)std::ceil(vMax.y) + entry.anchor.y + 2;
+		if (width > MAX_SPRITE_SIZE || height > MAX_SPRITE_SIZE) {
+			return entry;
+		}
+
+		entry.upSprite = std::make_unique<olc::Sprite>(width, height);
+		olc::vf2d offset = olc::vf2d(entry.anchor);
+
+		pge_->SetDrawTarget(entry.upSprite.get());
+		pge_->Clear(olc::BLANK);
+
+		// Same fan of triangles and outline that TessShape::draw() uses
+		if (fill != olc::BLANK) {
+			for (size_t i = 0; i < points.size() - 1; ++i) {
+				pge_->FillTriangle(olc::vi2d(points[0] + offset), olc::vi2d(points[i] + offset), olc::vi2d(points[i + 1] + offset), fill);
+			}
+		}
+		for (size_t i = 0; i < points.size(); ++i) {
+			pge_->DrawLine(olc::vi2d(points[i] + offset), olc::vi2d(points[(i + 1) % points.size()] + offset), outline);
+		}
+
+		pge_->SetDrawTarget(nullptr);
+		return entry;
+	}
+};
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_substitution.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	An aperiodic substitution tiling engine for the Penrose tilings: P2
+	(kites and darts) and P3 (thin and fat rhombs).
+
+	Both are built from Robinson triangles. Every tile is two mirror image
+	triangles glued along a seam, and every triangle subdivides into smaller
+	triangles scaled down by the golden ratio. Starting from a large wheel of
+	triangles, the tiling is expanded top down every frame, but only inside
+	the visible world rectangle: a supertile that doesn't touch the view is
+	never subdivided. The subdivision depth is chosen from the requested
+	tile size, which the caller bounds by the zoom level, so supertiles are
+	never expanded below a few pixels on screen. The cost of a frame is
+	proportional to what is visible, however deep the zoom.
+
+	Vertices are kept in double precision so the deep levels of the
+	hierarchy stay accurate.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The supported substitution rules
+enum class SubstitutionRule
+{
+	PenroseP2, // Kites and darts
+	PenroseP3, // Thin and fat rhombs
+	Count
+};
+
+class TessSubstitutionTiling {
+public:
+	// Deepest level the hierarchy is ever expanded to
+	static constexpr int MAX_DEPTH = 60;
+
+	// A Robinson triangle. The edges ab and ac are tile edges; bc is the seam
+	// shared with the mirror image triangle that completes the tile.
+	//   P2: type 0 is a half kite, type 1 a half dart (apex at b)
+	//   P3: type 0 is a half thin rhomb, type 1 a half fat rhomb (apex at a)
+	struct Triangle {
+		int type;
+		olc::vd2d a, b, c;
+	};
+
+	static const char* ruleName(SubstitutionRule rule) {
+		static const char* names[] = { "Penrose P2 (kite & dart)", "Penrose P3 (rhombs)" };
+		return names[(int)rule];
+	}
+
+	// Start a tiling with the given rule, from a wheel of ten triangles
+	// around centre. radius bounds the part of the plane that is covered.
+	void setRule(SubstitutionRule rule, const olc::vd2d& centre, double radius) {
+		rule_ = rule;
+		roots_.clear();
+		for (int i = 0; i < 10; ++i) {
+			olc::vd2d p = centre + olc::vd2d(std::cos((2 * i - 1) * M_PI / 10.0), std::sin((2 * i - 1) * M_PI / 10.0)) * radius;
+			olc::vd2d q = centre + olc::vd2d(std::cos((2 * i + 1) * M_PI / 10.0), std::sin((2 * i + 1) * M_PI / 10.0)) * radius;
+			if (rule == SubstitutionRule::PenroseP2) {
+				// Five kites meeting at their tips
+				if (i % 2 == 1) {
+					std::swap(p, q);
+				}
+				roots_.push_back({ 0, p, centre, q });
+			}
+			else {
+				if (i % 2 == 0) {
+					std::swap(p, q);
+				}
+				roots_.push_back({ 0, centre, p, q });
+			}
+		}
+		rootSize_ = radius;
+	}
+
+	void clear() {
+		roots_.clear();
+	}
+
+	bool isActive() const {
+		return !roots_.empty();
+	}
+
+	SubstitutionRule getRule() const {
+		return rule_;
+	}
+
+	// Subdivision depth that brings the long edge of a type 0 triangle down to
+	// at most tileSize
+	int depthFor(double tileSize) const {
+		if (!isActive() || tileSize >= rootSize_) {
+			return 0;
+		}
+		int depth = (int)std::ceil(std::log(rootSize_ / tileSize) / std::log(PHI));
+		return std::min(depth, MAX_DEPTH);
+	}
+
+	// Call fn(const Triangle&) for every triangle of the tiling that may intersect
+	// the world rectangle [worldTL, worldBR]. Triangles are subdivided until their
+	// long edge is at most tileSize, but never below minTileSize (the world size of
+	// the smallest tile worth drawing at the current zoom). Returns the depth used.
+	template <typename Fn>
+	int forEachVisibleTriangle(const olc::vd2d& worldTL, const olc::vd2d& worldBR, double tileSize, double minTileSize, Fn fn) const {
+		int depth = depthFor(std::max(tileSize, minTileSize));
+		for (const Triangle& root : roots_) {
+			expand(root, depth, worldTL, worldBR, fn);
+		}
+		return depth;
+	}
+
+private:
+	static constexpr double PHI = 1.6180339887498948482;
+
+	SubstitutionRule rule_ = SubstitutionRule::PenroseP3;
+	std::vector<Triangle> roots_;   // Top level of the hierarchy
+	double rootSize_ = 0.0;         // Long edge of the root triangles
+
+	static bool intersects(const Triangle& t, const olc::vd2d& vMin, const olc::vd2d& vMax) {
+		olc::vd2d tMin = t.a.min(t.b).min(t.c);
+		olc::vd2d tMax = t.a.max(t.b).max(t.c);
+		return tMax.x >= vMin.x && tMin.x <= vMax.x && tMax.y >= vMin.y && tMin.y <= vMax.y;
+	}
+
+	// Subdivide t depth more times, skipping every supertile outside the view.
+	// Children lie inside their parent, so a parent that misses the view can be
+	// dropped with everything below it.
+	template <typename Fn>
+	void expand(const Triangle& t, int depth, const olc::vd2d& vMin, const olc::vd2d& vMax, Fn& fn) const {
+		if (!intersects(t, vMin, vMax)) {
+			return;
+		}
+		if (depth == 0) {
+			fn(t);
+			return;
+		}
+
+		Triangle children[3];
+		int count = subdivide(t, children);
+		for (int i = 0; i < count; ++i) {
+			expand(children[i], depth - 1, vMin, vMax, fn);
+		}
+	}
+
+	// Robinson triangle decomposition. Returns the number of children.
+	int subdivide(const Triangle& t, Triangle* children) const {
+		if (rule_ == SubstitutionRule::PenroseP2) {
+			if (t.type == 0) {
+				olc::vd2d q = t.a + (t.b - t.a) / PHI;
+				olc::vd2d r = t.b + (t.c - t.b) / PHI;
+				children[0] = { 1, r, q, t.b };
+				children[1] = { 0, q, t.a, r };
+				children[2] = { 0, t.c, t.a, r };
+				return 3;
+			}
+			olc::vd2d p = t.c + (t.a - t.c) / PHI;
+			children[0] = { 1, t.b, p, t.a };
+			children[1] = { 0, p, t.c, t.b };
+			return 2;
+		}
+
+		if (t.type == 0) {
+			olc::vd2d p = t.a + (t.b - t.a) / PHI;
+			children[0] = { 0, t.c, p, t.b };
+			children[1] = { 1, p, t.c, t.a };
+			return 2;
+		}
+		olc::vd2d q = t.b + (t.a - t.b) / PHI;
+		olc::vd2d r = t.b + (t.c - t.b) / PHI;
+		children[0] = { 1, r, t.c, t.a };
+		children[1] = { 1, q, r, t.b };
+		children[2] = { 0, r, q, t.a };
+		return 3;
+	}
+};
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_svg_export.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	Exports the placed shapes as an SVG drawing for printing.
+
+	The drawing has one filled <path> per fill color, holding a subpath for
+	every shape of that color, and a single stroked <path> of the outlines.
+	The outlines come from the topology, so a side shared by two shapes is
+	written once, and sides that follow on from each other are joined into
+	one polyline.
+
+	Nothing is built in memory: each path is written straight to the file
+	through a fixed size buffer as the shapes are walked, one pass for the
+	bounds, one per fill color and one for the outlines. Apart from the list
+	of distinct colors, memory use does not depend on the number of shapes.
+
+	Coordinates are world units, to the hundredth TessShape rounds to.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Appends text to a file through a fixed size buffer
+class TessBufferedWriter {
+public:
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+	bool open(const std::string& path) {
+		out_.open(path, std::ios::binary | std::ios::trunc);
+		used_ = 0;
+		return (bool)out_;
+	}
+
+	// Write out what is buffered and close the file. False if any write failed.
+	bool close() {
+		flush();
+		out_.close();
+		return !out_.fail();
+	}
+
+	void write(const char* pText, size_t size) {
+		if (used_ + size > BUFFER_SIZE) {
+			flush();
+			if (size > BUFFER_SIZE) {
+				out_.write(pText, size);
+				return;
+			}
+		}
+		std::memcpy(buffer_ + used_, pText, size);
+		used_ += size;
+	}
+
+	void write(const char* pText) {
+		write(pText, std::strlen(pText));
+	}
+
+	void write(char c) {
+		if (used_ == BUFFER_SIZE) {
+			flush();
+		}
+		buffer_[used_++] = c;
+	}
+
+	void write(int64_t value) {
+		char text[24];
+		char* pEnd = std::to_chars(text, text + sizeof(text), value).ptr;
+		write(text, pEnd - text);
+	}
+
+	// Write a coordinate to two decimal places, without trailing zeros
+	void writeNumber(float value) {
+		int64_t hundredths = (int64_t)std::llround((double)value * 100.0);
+		if (hundredths < 0) {
+			write('-');
+			hundredths = -hundredths;
+		}
+		write(hundredths / 100);
+		int fraction = (int)(hundredths % 100);
+		if (fraction != 0) {
+			write('.');
+			write((char)('0' + fraction / 10));
+			if (fraction % 10 != 0) {
+				write((char)('0' + fraction % 10));
+			}
+		}
+	}
+
+	void writePoint(const olc::vf2d& point) {
+		writeNumber(point.x);
+		write(' ');
+		writeNumber(point.y);
+	}
+
+private:
+	std::ofstream out_;
+	char buffer_[BUFFER_SIZE];
+	size_t used_ = 0;
+
+	void flush() {
+		out_.write(buffer_, used_);
+		used_ = 0;
+	}
+};
+
+class TessSvgExport {
+public:
+	static constexpr float STROKE_WIDTH = 0.5f;              // World units
+	static constexpr const char* STROKE_COLOR = "#000000";
+
+	// Write the shapes to path as SVG. Every shape must be a face of the
+	// topology. The file is written next to path and renamed over it, so a
+	// failed export leaves the old file intact.
+	static bool write(const std::string& path, const std::vector<std::unique_ptr<TessShape>>& upShapes,
+		const TessTopology& topology, std::string& error) {
+		auto upWriter = std::make_unique<TessBufferedWriter>();
+		TessBufferedWriter& out = *upWriter;
+		std::string tempPath = path + ".tmp";
+		if (!out.open(tempPath)) {
+			error = "Could not create " + tempPath;
+			return false;
+		}
+
+		// Bounds and distinct fill colors
+		olc::vf2d vMin = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		olc::vf2d vMax = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+		std::vector<uint32_t> colors;
+		for (const auto& upShape : upShapes) {
+			for (const auto& point : upShape->getDrawPoints()) {
+				vMin = vMin.min(point);
+				vMax = vMax.max(point);
+			}
+			uint32_t color = upShape->getColor().n;
+			if (color != olc::BLANK.n && std::find(colors.begin(), colors.end(), color) == colors.end()) {
+				colors.push_back(color);
+			}
+		}
+		if (upShapes.empty()) {
+			vMin = vMax = { 0.0f, 0.0f };
+		}
+		vMin -= olc::vf2d(STROKE_WIDTH, STROKE_WIDTH);
+		vMax += olc::vf2d(STROKE_WIDTH, STROKE_WIDTH);
+
+		out.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+		out.write("<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"");
+		out.writePoint(vMin);
+		out.write(' ');
+		out.writePoint(vMax - vMin);
+		out.write("\" width=\"");
+		out.writeNumber(vMax.x - vMin.x);
+		out.write("\" height=\"");
+		out.writeNumber(vMax.y - vMin.y);
+		out.write("\">\n");
+
+		// One path per fill color, with a subpath per shape
+		for (uint32_t color : colors) {
+			writeFillStart(out, olc::Pixel(color));
+			for (const auto& upShape : upShapes) {
+				if (upShape->getColor().n != color) {
+					continue;
+				}
+				int32_t f = topology.findFace(upShape.get());
+				if (f == TessTopology::NONE) {
+					continue;
+				}
+				char command = 'M';
+				topology.forEachFaceEdge(f, [&](int32_t h) {
+					out.write(command);
+					out.writePoint(topology.vertex(topology.halfEdge(h).origin).position);
+					command = command == 'M' ? 'L' : ' ';
+				});
+				out.write('Z');
+			}
+			out.write("\"/>\n");
+		}
+
+		// The outlines. A side is written by the half-edge with the lower
+		// index, and runs of sides are joined into polylines.
+		out.write("<path fill=\"none\" stroke=\"");
+		out.write(STROKE_COLOR);
+		out.write("\" stroke-width=\"");
+		out.writeNumber(STROKE_WIDTH);
+		out.write("\" stroke-linejoin=\"round\" d=\"");
+		for (const auto& upShape : upShapes) {
+			int32_t f = topology.findFace(upShape.get());
+			if (f == TessTopology::NONE) {
+				continue;
+			}
+			int32_t end = TessTopology::NONE; // Vertex the current polyline ends at
+			topology.forEachFaceEdge(f, [&](int32_t h) {
+				const TessTopology::HalfEdge& edge = topology.halfEdge(h);
+				if (edge.twin != TessTopology::NONE && edge.twin < h) {
+					end = TessTopology::NONE;
+					return;
+				}
+				if (edge.origin != end) {
+					out.write('M');
+					out.writePoint(topology.vertex(edge.origin).position);
+					out.write('L');
+				}
+				else {
+					out.write(' ');
+				}
+				end = topology.destination(h);
+				out.writePoint(topology.vertex(end).position);
+			});
+		}
+		out.write("\"/>\n");
+		out.write("</svg>\n");
+
+		if (!out.close()) {
+			error = "Could not write " + tempPath;
+			return false;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			error = "Could not replace " + path + ": " + ec.message();
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static void writeFillStart(TessBufferedWriter& out, const olc::Pixel& color) {
+		static const char HEX[] = "0123456789abcdef";
+		char text[] = "#000000";
+		uint8_t channels[3] = { color.r, color.g, color.b };
+		for (int i = 0; i < 3; ++i) {
+			text[1 + 2 * i] = HEX[channels[i] >> 4];
+			text[2 + 2 * i] = HEX[channels[i] & 15];
+		}
+		out.write("<path fill=\"");
+		out.write(text);
+		if (color.a != 255) {
+			out.write("\" fill-opacity=\"");
+			out.writeNumber(color.a / 255.0f);
+		}
+		out.write("\" d=\"");
+	}
+};
@@ -0,0 +1,509 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_topology.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A half-edge mesh of the placed shapes, kept up to date as shapes are
+	added and removed, so adjacency questions don't need all-pairs tests.
+
+	Every shape is a face with one half-edge per side. Vertices of
+	different shapes that snap to the same point are merged through a hash
+	grid of their positions, with cells several tolerances wide so most
+	lookups probe a single cell. Each vertex links its outgoing
+	half-edges in a list, which gives the vertex star directly and finds the twin of
+	a new half-edge u->v among the edges leaving v. Half-edges without a
+	twin are on the boundary of the tiling.
+
+	Only edges that match end to end are linked; a side that meets part of
+	a longer side (a T-junction) stays a boundary edge. Faces are oriented
+	consistently when added, whatever order the shape lists its vertices.
+
+	Elements are stored in vectors and their slots are reused after
+	removal, so indices stay valid until the element itself is removed.
+
+	A batch of shapes can be added in one call, which orients their corners
+	in parallel and reserves room for the whole batch before merging them
+	in spatial order.
+
+	floodFaces() walks the faces connected to one through shared sides,
+	such as a region of one color for a bucket fill.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_geometry.h"
+#include "tess_flat_map.h"
+#include "tess_parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class TessTopology {
+public:
+	static constexpr int32_t NONE = -1;
+	// Vertices closer than this (in world units) are merged
+	static constexpr float VERTEX_TOLERANCE = 0.05f;
+	static constexpr float VERTEX_CELL_SIZE = 8.0f * VERTEX_TOLERANCE;
+	// World units per side of the cells a batch is ordered by
+	static constexpr float ORDER_CELL_SIZE = 64.0f;
+
+	struct Vertex {
+		olc::vf2d position;
+		int32_t edge = NONE;           // First half-edge starting here, NONE if the slot is free
+		int32_t nextInCell = NONE;     // Next vertex in the same hash grid cell
+	};
+
+	struct HalfEdge {
+		int32_t origin = NONE;
+		int32_t twin = NONE;           // Opposite half-edge of the neighbouring face, NONE on the boundary
+		int32_t next = NONE;           // Next half-edge around the face
+		int32_t prev = NONE;
+		int32_t face = NONE;           // NONE if the slot is free
+		int32_t nextOutgoing = NONE;   // Next half-edge starting at the same vertex
+	};
+
+	struct Face {
+		TessShape* pShape = nullptr;   // nullptr if the slot is free
+		int32_t edge = NONE;           // First half-edge
+	};
+
+	// Add the shape as a face, merging its vertices with existing ones and
+	// linking its edges to their twins
+	void addShape(TessShape& shape) {
+		if (faceMap_.count(&shape)) {
+			return;
+		}
+		const std::vector<olc::vf2d>& points = shape.getDrawPoints();
+		size_t n = points.size();
+		if (n < 3) {
+			return;
+		}
+		bool reversed = isClockwise(points);
+		corners_.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			corners_[i] = findOrAddVertex(points[reversed ? n - 1 - i : i]);
+		}
+		addFace(shape, corners_.data(), n);
+	}
+
+	// Add a batch of shapes as faces, the same as adding them one by one.
+	// The corners are oriented in parallel, and each distinct corner
+	// position is merged with the existing vertices once.
+	void addShapes(const std::vector<std::unique_ptr<TessShape>>& upBatch) {
+		// Offsets of each shape's corners, 0 corners for shapes that are skipped
+		std::vector<size_t> offsets(upBatch.size() + 1, 0);
+		for (size_t i = 0; i < upBatch.size(); ++i) {
+			size_t n = upBatch[i]->getDrawPoints().size();
+			offsets[i + 1] = offsets[i] + (n < 3 || faceMap_.count(upBatch[i].get()) ? 0 : n);
+		}
+		std::vector<olc::vf2d> points(offsets.back());
+		tessParallelFor(upBatch.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				size_t n = offsets[i + 1] - offsets[i];
+				if (n == 0) {
+					continue;
+				}
+				const std::vector<olc::vf2d>& shapePoints = upBatch[i]->getDrawPoints();
+				bool reversed = isClockwise(shapePoints);
+				for (size_t k = 0; k < n; ++k) {
+					points[offsets[i] + k] = shapePoints[reversed ? n - 1 - k : k];
+				}
+			}
+		});
+
+		// Merged and linked in spatial order, so the vertices and edges a
+		// shape shares with its neighbours are still in cache, whatever
+		// order the batch is in
+		std::vector<uint32_t> order = TessSpatialOrder::of(upBatch.size(), ORDER_CELL_SIZE, [&](size_t i) {
+			return offsets[i + 1] > offsets[i] ? points[offsets[i]] : olc::vf2d(0.0f, 0.0f);
+		});
+		reserve(upBatch.size(), points.size());
+		std::vector<int32_t> corners(points.size());
+		for (uint32_t i : order) {
+			for (size_t c = offsets[i]; c < offsets[i + 1]; ++c) {
+				corners[c] = findOrAddVertex(points[c]);
+			}
+		}
+
+		for (uint32_t i : order) {
+			if (offsets[i + 1] > offsets[i]) {
+				addFace(*upBatch[i], corners.data() + offsets[i], offsets[i + 1] - offsets[i]);
+			}
+		}
+	}
+
+	// Remove the shape's face, unlinking its twins and freeing vertices no
+	// other face uses
+	void removeShape(const TessShape* pShape) {
+		auto it = faceMap_.find(pShape);
+		if (it == faceMap_.end()) {
+			return;
+		}
+		int32_t f = it->second;
+		faceMap_.erase(it);
+
+		int32_t first = faces_[f].edge;
+		int32_t h = first;
+		do {
+			HalfEdge& edge = halfEdges_[h];
+			int32_t next = edge.next;
+			if (edge.twin != NONE) {
+				halfEdges_[edge.twin].twin = NONE;
+				boundaryEdges_ += 1; // The neighbour's side is now on the boundary
+			}
+			else {
+				boundaryEdges_ -= 1;
+			}
+
+			Vertex& vertex = vertices_[edge.origin];
+			if (vertex.edge == h) {
+				vertex.edge = edge.nextOutgoing;
+			}
+			else {
+				int32_t prev = vertex.edge;
+				while (halfEdges_[prev].nextOutgoing != h) {
+					prev = halfEdges_[prev].nextOutgoing;
+				}
+				halfEdges_[prev].nextOutgoing = edge.nextOutgoing;
+			}
+			if (vertex.edge == NONE) {
+				removeVertex(edge.origin);
+			}
+
+			edge = HalfEdge();
+			freeHalfEdges_.push_back(h);
+			h = next;
+		} while (h != first);
+
+		faces_[f] = Face();
+		freeFaces_.push_back(f);
+	}
+
+	// Make room for more faces and half-edges, so a large batch of shapes
+	// doesn't rehash and regrow as it is added
+	void reserve(size_t faces, size_t halfEdges) {
+		faces_.reserve(faces_.size() + faces);
+		halfEdges_.reserve(halfEdges_.size() + halfEdges);
+		vertices_.reserve(vertices_.size() + halfEdges);
+		faceMap_.reserve(faceMap_.size() + faces);
+		vertexCells_.reserve(vertexCells_.size() + halfEdges / 2);
+	}
+
+	void clear() {
+		vertices_.clear();
+		halfEdges_.clear();
+		faces_.clear();
+		freeVertices_.clear();
+		freeHalfEdges_.clear();
+		freeFaces_.clear();
+		vertexCells_.clear();
+		vertexCount_ = 0;
+		faceMap_.clear();
+		boundaryEdges_ = 0;
+	}
+
+	// The face of a shape, or NONE
+	int32_t findFace(const TessShape* pShape) const {
+		auto it = faceMap_.find(pShape);
+		return it == faceMap_.end() ? NONE : it->second;
+	}
+
+	// The vertex at position, or NONE. Only the cells within VERTEX_TOLERANCE
+	// of position are probed, its own first, as that is usually enough.
+	int32_t findVertex(const olc::vf2d& position) const {
+		int64_t qx = cellCoord(position.x);
+		int64_t qy = cellCoord(position.y);
+		int32_t v = findInCell(qx, qy, position);
+		if (v != NONE) {
+			return v;
+		}
+		float fx = position.x - (qx - 0.5f) * VERTEX_CELL_SIZE;
+		float fy = position.y - (qy - 0.5f) * VERTEX_CELL_SIZE;
+		int64_t x0 = fx < VERTEX_TOLERANCE ? qx - 1 : qx;
+		int64_t x1 = VERTEX_CELL_SIZE - fx < VERTEX_TOLERANCE ? qx + 1 : qx;
+		int64_t y0 = fy < VERTEX_TOLERANCE ? qy - 1 : qy;
+		int64_t y1 = VERTEX_CELL_SIZE - fy < VERTEX_TOLERANCE ? qy + 1 : qy;
+		for (int64_t x = x0; x <= x1; ++x) {
+			for (int64_t y = y0; y <= y1; ++y) {
+				if (x == qx && y == qy) {
+					continue;
+				}
+				v = findInCell(x, y, position);
+				if (v != NONE) {
+					return v;
+				}
+			}
+		}
+		return NONE;
+	}
+
+	const Vertex& vertex(int32_t v) const { return vertices_[v]; }
+	const HalfEdge& halfEdge(int32_t h) const { return halfEdges_[h]; }
+	const Face& face(int32_t f) const { return faces_[f]; }
+
+	int32_t destination(int32_t h) const {
+		return halfEdges_[halfEdges_[h].next].origin;
+	}
+
+	size_t faceCount() const { return faceMap_.size(); }
+	size_t faceSlotCount() const { return faces_.size(); }  // Bound on face indices
+	size_t vertexCount() const { return vertexCount_; }
+	size_t boundaryEdgeCount() const { return boundaryEdges_; }
+
+	// Call fn(halfEdge) for each side of the face
+	template <typename Fn>
+	void forEachFaceEdge(int32_t f, Fn fn) const {
+		int32_t first = faces_[f].edge;
+		int32_t h = first;
+		do {
+			fn(h);
+			h = halfEdges_[h].next;
+		} while (h != first);
+	}
+
+	// Call fn(neighbourFace, halfEdge) for each face sharing a side with face f
+	template <typename Fn>
+	void forEachNeighbour(int32_t f, Fn fn) const {
+		forEachFaceEdge(f, [&](int32_t h) {
+			int32_t twin = halfEdges_[h].twin;
+			if (twin != NONE) {
+				fn(halfEdges_[twin].face, h);
+			}
+		});
+	}
+
+	// Call fn(halfEdge) for each half-edge leaving vertex v; their faces are the
+	// faces around v
+	template <typename Fn>
+	void forEachVertexEdge(int32_t v, Fn fn) const {
+		for (int32_t h = vertices_[v].edge; h != NONE; h = halfEdges_[h].nextOutgoing) {
+			fn(h);
+		}
+	}
+
+	// The boundary half-edge that follows boundary half-edge h, walking the
+	// boundary loop in the same direction as h
+	int32_t nextBoundaryEdge(int32_t h) const {
+		int32_t v = destination(h);
+		for (int32_t g = vertices_[v].edge; g != NONE; g = halfEdges_[g].nextOutgoing) {
+			if (halfEdges_[g].twin == NONE && halfEdges_[g].face == halfEdges_[h].face) {
+				return g;
+			}
+		}
+		for (int32_t g = vertices_[v].edge; g != NONE; g = halfEdges_[g].nextOutgoing) {
+			if (halfEdges_[g].twin == NONE) {
+				return g;
+			}
+		}
+		return NONE;
+	}
+
+	// The faces reachable from face start through shared sides, crossing
+	// only into faces for which pass(face) is true, in breadth first order
+	// from start. The result and the visit marks are reused from call to
+	// call, so a flood allocates nothing once they have grown to the mesh.
+	template <typename Pass>
+	const std::vector<int32_t>& floodFaces(int32_t start, Pass pass) {
+		if (visitMarks_.size() < faces_.size()) {
+			visitMarks_.resize(faces_.size(), 0);
+		}
+		if (++visitMark_ == 0) {
+			// The marks wrapped around, so old marks could match again
+			std::fill(visitMarks_.begin(), visitMarks_.end(), 0);
+			visitMark_ = 1;
+		}
+
+		// The result is the queue: faces before head have been expanded
+		flood_.clear();
+		flood_.push_back(start);
+		visitMarks_[start] = visitMark_;
+		for (size_t head = 0; head < flood_.size(); ++head) {
+			forEachNeighbour(flood_[head], [&](int32_t g, int32_t) {
+				if (visitMarks_[g] != visitMark_ && pass(g)) {
+					visitMarks_[g] = visitMark_;
+					flood_.push_back(g);
+				}
+			});
+		}
+		return flood_;
+	}
+
+	// Call fn(halfEdge) for every boundary half-edge
+	template <typename Fn>
+	void forEachBoundaryEdge(Fn fn) const {
+		for (int32_t h = 0; h < (int32_t)halfEdges_.size(); ++h) {
+			if (halfEdges_[h].face != NONE && halfEdges_[h].twin == NONE) {
+				fn(h);
+			}
+		}
+	}
+
+private:
+	std::vector<Vertex> vertices_;
+	std::vector<HalfEdge> halfEdges_;
+	std::vector<Face> faces_;
+	std::vector<int32_t> freeVertices_;
+	std::vector<int32_t> freeHalfEdges_;
+	std::vector<int32_t> freeFaces_;
+	TessFlatMap<uint64_t, int32_t> vertexCells_;              // Hash grid cell to its first vertex
+	TessFlatMap<const TessShape*, int32_t> faceMap_;          // Shape to face
+	size_t vertexCount_ = 0;
+	size_t boundaryEdges_ = 0;
+	std::vector<int32_t> corners_;                            // Reused by addShape()
+	std::vector<int32_t> flood_;                              // Reused by floodFaces()
+	std::vector<uint32_t> visitMarks_;                        // Per face, the flood that last reached it
+	uint32_t visitMark_ = 0;
+
+	// Cells are centred on multiples of VERTEX_CELL_SIZE, so vertices on a
+	// round grid sit in the middle of a cell and are found with one probe
+	static int64_t cellCoord(float v) {
+		return (int64_t)std::floor(v / VERTEX_CELL_SIZE + 0.5f);
+	}
+
+	static uint64_t cellKey(int64_t qx, int64_t qy) {
+		return ((uint64_t)(uint32_t)qx << 32) | (uint32_t)qy;
+	}
+
+	// True if the polygon winds clockwise; faces are stored the other way
+	static bool isClockwise(const std::vector<olc::vf2d>& points) {
+		float area = 0.0f;
+		for (size_t i = 0; i < points.size(); ++i) {
+			area += points[i].cross(points[(i + 1) % points.size()]);
+		}
+		return area < 0.0f;
+	}
+
+	// Add the shape as a face with the n vertices at pCorners, in order,
+	// linking its edges to their twins
+	void addFace(TessShape& shape, const int32_t* pCorners, size_t n) {
+		int32_t f = allocate(faces_, freeFaces_);
+		faces_[f].pShape = &shape;
+		faceMap_[&shape] = f;
+
+		int32_t first = NONE;
+		int32_t prev = NONE;
+		for (size_t i = 0; i < n; ++i) {
+			int32_t h = allocate(halfEdges_, freeHalfEdges_);
+			HalfEdge& edge = halfEdges_[h];
+			edge.origin = pCorners[i];
+			edge.face = f;
+			edge.twin = NONE;
+			edge.prev = prev;
+			if (prev != NONE) {
+				halfEdges_[prev].next = h;
+			}
+			else {
+				first = h;
+			}
+			prev = h;
+		}
+		halfEdges_[prev].next = first;
+		halfEdges_[first].prev = prev;
+		faces_[f].edge = first;
+
+		// Link twins: the twin of u->v is an unlinked edge v->u leaving v
+		int32_t h = first;
+		do {
+			int32_t u = halfEdges_[h].origin;
+			int32_t v = destination(h);
+			for (int32_t g = vertices_[v].edge; g != NONE; g = halfEdges_[g].nextOutgoing) {
+				if (halfEdges_[g].twin == NONE && destination(g) == u) {
+					halfEdges_[g].twin = h;
+					halfEdges_[h].twin = g;
+					boundaryEdges_ -= 1;
+					break;
+				}
+			}
+			if (halfEdges_[h].twin == NONE) {
+				boundaryEdges_ += 1;
+			}
+			h = halfEdges_[h].next;
+		} while (h != first);
+
+		h = first;
+		do {
+			Vertex& vertex = vertices_[halfEdges_[h].origin];
+			halfEdges_[h].nextOutgoing = vertex.edge;
+			vertex.edge = h;
+			h = halfEdges_[h].next;
+		} while (h != first);
+	}
+
+	// A vertex of cell (x, y) within VERTEX_TOLERANCE of position, or NONE
+	int32_t findInCell(int64_t x, int64_t y, const olc::vf2d& position) const {
+		auto cell = vertexCells_.find(cellKey(x, y));
+		if (cell == vertexCells_.end()) {
+			return NONE;
+		}
+		for (int32_t v = cell->second; v != NONE; v = vertices_[v].nextInCell) {
+			if ((vertices_[v].position - position).mag() < VERTEX_TOLERANCE) {
+				return v;
+			}
+		}
+		return NONE;
+	}
+
+	int32_t findOrAddVertex(const olc::vf2d& position) {
+		int32_t v = findVertex(position);
+		if (v != NONE) {
+			return v;
+		}
+		v = allocate(vertices_, freeVertices_);
+		uint64_t key = cellKey(cellCoord(position.x), cellCoord(position.y));
+		auto cell = vertexCells_.try_emplace(key, NONE).first;
+		vertices_[v].position = position;
+		vertices_[v].nextInCell = cell->second;
+		cell->second = v;
+		vertexCount_ += 1;
+		return v;
+	}
+
+	// Unlink a vertex with no edges left from its cell and free its slot
+	void removeVertex(int32_t v) {
+		const olc::vf2d& position = vertices_[v].position;
+		auto cell = vertexCells_.find(cellKey(cellCoord(position.x), cellCoord(position.y)));
+		if (cell->second == v) {
+			cell->second = vertices_[v].nextInCell;
+			if (cell->second == NONE) {
+				vertexCells_.erase(cell);
+			}
+		}
+		else {
+			int32_t prev = cell->second;
+			while (vertices_[prev].nextInCell != v) {
+				prev = vertices_[prev].nextInCell;
+			}
+			vertices_[prev].nextInCell = vertices_[v].nextInCell;
+		}
+		vertices_[v].nextInCell = NONE;
+		freeVertices_.push_back(v);
+		vertexCount_ -= 1;
+	}
+
+	// A free slot, reused if there is one
+	template <typename T>
+	static int32_t allocate(std::vector<T>& elements, std::vector<int32_t>& freeSlots) {
+		if (!freeSlots.empty()) {
+			int32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+		elements.emplace_back();
+		return (int32_t)elements.size() - 1;
+	}
+};
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_undo.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	The undo and redo history of edits to the placed shapes. Each step is
+	one compact record of what an edit changed, rather than a copy of the
+	scene:
+
+		Insert     Shapes added at the end of the placed shapes, as a range
+		Recolor    Fill colors changed, as runs of consecutive shapes that
+		           went from one color to another
+		Pose       Shapes moved or turned, as their place and rotation
+		           before and after
+		Erase      Shapes taken from anywhere, each swapped with the last
+		           shape first, kept in the record with where they were
+
+	Steps are undone in the reverse of the order they were made, so the
+	placed shapes are back in the order a step saw them in when it is
+	undone, and a range or index it recorded is still the same shapes. Undoing or redoing a step costs the number of shapes it
+	touched: a fill of 100,000 tiles is one Insert step, undone by taking
+	those shapes back off the end.
+
+	A step undone moves to the redo history, holding whatever it needs to
+	be redone (an undone Insert keeps the shapes it took away). Recording
+	a new step clears the redo history. The oldest steps are dropped past
+	MAX_STEPS.
+
+	TessUndoStack only keeps the records. Applying them to the placed
+	shapes, the spatial index, the topology and the journal is the
+	application's, which knows how all of them are kept in step.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+#include "tess_shape.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class TessUndoStack {
+public:
+	static constexpr size_t MAX_STEPS = 256;
+
+	enum class Kind {
+		Insert,
+		Recolor,
+		Pose,
+		Erase
+	};
+
+	// first .. first + count - 1 all went from color from to color to
+	struct ColorRun {
+		size_t first;
+		uint32_t count;
+		olc::Pixel from;
+		olc::Pixel to;
+	};
+
+	struct PoseChange {
+		size_t index;
+		olc::vf2d fromCentroid;
+		float fromRotation;
+		olc::vf2d toCentroid;
+		float toRotation;
+	};
+
+	struct Step {
+		Kind kind = Kind::Insert;
+		size_t begin = 0;                                 // Insert: first index of the range
+		size_t count = 0;                                 // Insert: shapes in the range
+		std::vector<std::unique_ptr<TessShape>> upShapes; // The range or erased shapes, while they are not placed
+		std::vector<size_t> indices;                      // Erase: where each shape was, in the order erased
+		std::vector<ColorRun> colors;                     // Recolor
+		std::vector<PoseChange> poses;                    // Pose
+	};
+
+	// Shapes begin .. begin + count - 1 were added
+	void recordInsert(size_t begin, size_t count) {
+		if (count == 0) {
+			return;
+		}
+		Step step;
+		step.kind = Kind::Insert;
+		step.begin = begin;
+		step.count = count;
+		push(std::move(step));
+	}
+
+	// The shape at index went from color from to color to
+	void recordColor(size_t index, const olc::Pixel& from, const olc::Pixel& to) {
+		std::vector<ColorRun> runs;
+		addColor(runs, index, from, to);
+		recordColors(std::move(runs));
+	}
+
+	// Several shapes changed color as one edit, the runs built with addColor()
+	void recordColors(std::vector<ColorRun> runs) {
+		if (runs.empty()) {
+			return;
+		}
+		Step step;
+		step.kind = Kind::Recolor;
+		step.colors = std::move(runs);
+		push(std::move(step));
+	}
+
+	// Several shapes moved or turned as one edit
+	void recordPoses(std::vector<PoseChange> poses) {
+		if (poses.empty()) {
+			return;
+		}
+		Step step;
+		step.kind = Kind::Pose;
+		step.poses = std::move(poses);
+		push(std::move(step));
+	}
+
+	// The shapes were erased one after the other, from indices. With join,
+	// they carry on the erase step last recorded (a stroke of the eraser)
+	// if nothing came after it.
+	void recordErase(std::vector<size_t> indices, std::vector<std::unique_ptr<TessShape>> upShapes, bool join) {
+		if (upShapes.empty()) {
+			return;
+		}
+		if (join && !undo_.empty() && undo_.back().kind == Kind::Erase) {
+			redo_.clear();
+			Step& step = undo_.back();
+			step.indices.insert(step.indices.end(), indices.begin(), indices.end());
+			for (auto& upShape : upShapes) {
+				step.upShapes.push_back(std::move(upShape));
+			}
+			return;
+		}
+		Step step;
+		step.kind = Kind::Erase;
+		step.indices = std::move(indices);
+		step.upShapes = std::move(upShapes);
+		push(std::move(step));
+	}
+
+	// Add a color change to runs, extending the last run when it carries on
+	static void addColor(std::vector<ColorRun>& runs, size_t index, const olc::Pixel& from, const olc::Pixel& to) {
+		if (from == to) {
+			return;
+		}
+		if (!runs.empty()) {
+			ColorRun& run = runs.back();
+			if (run.first + run.count == index && run.from == from && run.to == to) {
+				run.count += 1;
+				return;
+			}
+		}
+		runs.push_back({ index, 1, from, to });
+	}
+
+	bool canUndo() const { return !undo_.empty(); }
+	bool canRedo() const { return !redo_.empty(); }
+
+	// Take the last step made, to be undone and then handed to pushRedo()
+	Step takeUndo() {
+		Step step = std::move(undo_.back());
+		undo_.pop_back();
+		return step;
+	}
+
+	void pushRedo(Step step) {
+		redo_.push_back(std::move(step));
+	}
+
+	// Take the last step undone, to be redone and then handed to pushUndo()
+	Step takeRedo() {
+		Step step = std::move(redo_.back());
+		redo_.pop_back();
+		return step;
+	}
+
+	// Put back a step that was redone, leaving the rest of the redo history
+	void pushUndo(Step step) {
+		undo_.push_back(std::move(step));
+	}
+
+	// Forget the history, when the placed shapes are replaced wholesale
+	void clear() {
+		undo_.clear();
+		redo_.clear();
+	}
+
+private:
+	std::deque<Step> undo_;
+	std::vector<Step> redo_;
+
+	void push(Step step) {
+		redo_.clear();
+		undo_.push_back(std::move(step));
+		if (undo_.size() > MAX_STEPS) {
+			undo_.pop_front();
+		}
+	}
+};
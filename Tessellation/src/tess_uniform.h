@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_uniform.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A generator for uniform (Archimedean) tilings from a vertex configuration
+	such as "3.4.6.4", "4.8.8" or "3.3.3.3.6". Every vertex of the tiling is
+	surrounded by the same cyclic sequence of regular polygons.
+
+	The tiling is grown breadth first from a seed vertex. For each frontier
+	vertex the polygons already around it are matched against the rotations
+	and reflection of the configuration; when exactly one completion fits,
+	the missing polygons are placed. Ambiguous vertices are deferred until
+	their neighbours have been filled in. Vertices are deduplicated through a
+	hash map of their quantized positions.
+
+	All edge directions are multiples of 15 degrees, so angles are tracked
+	exactly as integer steps of 15 degrees (24 steps per turn).
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "olcPixelGameEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TessUniformTiling {
+public:
+	// A generated tile: a regular polygon with the given number of sides
+	struct Tile {
+		int sides;
+		olc::vf2d centre;
+		float firstVertexAngle; // Angle of the first vertex as seen from the centre, in degrees
+	};
+
+	// The 11 Archimedean tilings
+	static const std::vector<std::string>& presets() {
+		static const std::vector<std::string> names = {
+			"3.3.3.3.3.3", "4.4.4.4", "6.6.6", "3.6.3.6", "3.3.3.3.6", "3.3.3.4.4",
+			"3.3.4.3.4", "3.4.6.4", "4.8.8", "3.12.12", "4.6.12"
+		};
+		return names;
+	}
+
+	// Parse a vertex configuration such as "3.4.6.4". Returns false if the text is
+	// malformed, uses a polygon that isn't supported, or the angles don't add up to 360.
+	static bool parseConfiguration(const std::string& text, std::vector<int>& config) {
+		config.clear();
+		std::stringstream ss(text);
+		std::string item;
+		int total = 0;
+		while (std::getline(ss, item, '.')) {
+			int sides = std::atoi(item.c_str());
+			if (interiorSteps(sides) == 0) {
+				return false;
+			}
+			config.push_back(sides);
+			total += interiorSteps(sides);
+		}
+		return config.size() >= 3 && total == STEPS;
+	}
+
+	// Grow a patch of up to maxTiles tiles with the given vertex configuration
+	// outward from the seed vertex. The first edge at the seed points along +x.
+	static std::vector<Tile> generate(const std::vector<int>& config, const olc::vf2d& seed, float sideLength, size_t maxTiles) {
+		Generator generator(config, sideLength, maxTiles);
+		generator.run(seed.x, seed.y);
+		return std::move(generator.tiles);
+	}
+
+private:
+	static constexpr int STEPS = 24; // 15 degree steps per turn
+
+	// Interior angle of a regular polygon in 15 degree steps, 0 if it isn't a whole number of steps
+	static int interiorSteps(int sides) {
+		switch (sides)
+		{
+			case 3: return 4;
+			case 4: return 6;
+			case 6: return 8;
+			case 8: return 9;
+			case 12: return 10;
+			default: return 0;
+		}
+	}
+
+	struct Vertex {
+		double x, y;
+		uint32_t mask = 0;      // Bit d set if the sector [d, d + 1) around the vertex is covered
+		uint8_t sides[STEPS];   // Sides of the polygon whose sector starts at direction d, 0 if none
+		bool queued = false;
+	};
+
+	// A polygon around a vertex, starting at direction dir
+	struct Sector {
+		int dir;
+		int sides;
+
+		bool operator==(const Sector& other) const {
+			return dir == other.dir && sides == other.sides;
+		}
+	};
+
+	struct Generator {
+		std::vector<std::vector<int>> sequences;   // Rotations of the configuration and its mirror image
+		double sideLength;
+		double quantum;                            // Grid used to hash vertex positions
+		size_t maxTiles;
+		double dirX[STEPS];
+		double dirY[STEPS];
+
+		std::vector<Vertex> vertices;
+		std::unordered_map<uint64_t, uint32_t> vertexMap;
+		std::deque<uint32_t> frontier;
+		std::vector<Tile> tiles;
+
+		Generator(const std::vector<int>& config, float side, size_t max)
+			: sideLength(side), quantum(side * 1e-3), maxTiles(max)
+		{
+			for (int d = 0; d < STEPS; ++d) {
+				double angle = d * 2.0 * M_PI / STEPS;
+				dirX[d] = std::cos(angle);
+				dirY[d] = std::sin(angle);
+			}
+
+			const std::vector<int> mirrored(config.rbegin(), config.rend());
+			const std::vector<int>* pSequences[2] = { &config, &mirrored };
+			for (const std::vector<int>* pSequence : pSequences) {
+				for (size_t r = 0; r < pSequence->size(); ++r) {
+					std::vector<int> rotated;
+					for (size_t i = 0; i < pSequence->size(); ++i) {
+						rotated.push_back((*pSequence)[(r + i) % pSequence->size()]);
+					}
+					if (std::find(sequences.begin(), sequences.end(), rotated) == sequences.end()) {
+						sequences.push_back(rotated);
+					}
+				}
+			}
+
+			tiles.reserve(maxTiles);
+			vertices.reserve(maxTiles * 2);
+			vertexMap.reserve(maxTiles * 2);
+		}
+
+		uint64_t vertexKey(double x, double y) const {
+			int64_t qx = std::llround(x / quantum);
+			int64_t qy = std::llround(y / quantum);
+			return ((uint64_t)(uint32_t)qx << 32) | (uint32_t)qy;
+		}
+
+		// Find the vertex at (x, y), or -1 if there is none yet
+		int64_t findVertex(double x, double y) const {
+			auto it = vertexMap.find(vertexKey(x, y));
+			return it == vertexMap.end() ? -1 : (int64_t)it->second;
+		}
+
+		uint32_t findOrAddVertex(double x, double y) {
+			auto result = vertexMap.emplace(vertexKey(x, y), (uint32_t)vertices.size());
+			if (result.second) {
+				Vertex v;
+				v.x = x;
+				v.y = y;
+				std::fill(std::begin(v.sides), std::end(v.sides), (uint8_t)0);
+				vertices.push_back(v);
+				enqueue(result.first->second);
+			}
+			return result.first->second;
+		}
+
+		void enqueue(uint32_t id) {
+			if (!vertices[id].queued) {
+				vertices[id].queued = true;
+				frontier.push_back(id);
+			}
+		}
+
+		static uint32_t sectorMask(int dir, int steps) {
+			uint64_t bits = ((1ull << steps) - 1) << dir;
+			return (uint32_t)((bits | (bits >> STEPS)) & ((1u << STEPS) - 1));
+		}
+
+		// Place a polygon with the given sides at vertex id, covering the sector
+		// starting at direction dir. Returns false if it would overlap a polygon
+		// that is already there.
+		bool placePolygon(uint32_t id, int dir, int sides) {
+			int interior = interiorSteps(sides);
+			int exterior = STEPS / 2 - interior;
+
+			// Walk the polygon's vertices, checking the sector each one needs is free
+			double px[12], py[12];
+			int dirs[12];
+			px[0] = vertices[id].x;
+			py[0] = vertices[id].y;
+			for (int k = 0; k < sides; ++k) {
+				dirs[k] = (dir + k * exterior) % STEPS;
+				if (k > 0) {
+					px[k] = px[k - 1] + sideLength * dirX[dirs[k - 1]];
+					py[k] = py[k - 1] + sideLength * dirY[dirs[k - 1]];
+				}
+				int64_t existing = k == 0 ? (int64_t)id : findVertex(px[k], py[k]);
+				if (existing >= 0 && (vertices[(size_t)existing].mask & sectorMask(dirs[k], interior))) {
+					return false;
+				}
+			}
+
+			double cx = 0.0, cy = 0.0;
+			for (int k = 0; k < sides; ++k) {
+				uint32_t vertexId = k == 0 ? id : findOrAddVertex(px[k], py[k]);
+				Vertex& v = vertices[vertexId];
+				v.mask |= sectorMask(dirs[k], interior);
+				v.sides[dirs[k]] = (uint8_t)sides;
+				cx += px[k];
+				cy += py[k];
+			}
+			cx /= sides;
+			cy /= sides;
+
+			tiles.push_back({ sides, olc::vf2d((float)cx, (float)cy),
+				(float)(std::atan2(py[0] - cy, px[0] - cx) * 180.0 / M_PI) });
+			return true;
+		}
+
+		// Every way of completing the polygons around a vertex that is consistent
+		// with the configuration. Each completion lists the missing sectors.
+		std::vector<std::vector<Sector>> completions(const Vertex& v) const {
+			std::vector<std::vector<Sector>> result;
+
+			// Anchor on any polygon already at the vertex
+			int anchor = 0;
+			while (anchor < STEPS && v.sides[anchor] == 0) {
+				++anchor;
+			}
+			if (anchor == STEPS) {
+				return result;
+			}
+
+			for (const auto& sequence : sequences) {
+				if (sequence[0] != v.sides[anchor]) {
+					continue;
+				}
+
+				std::vector<Sector> missing;
+				int dir = anchor;
+				bool fits = true;
+				for (int sides : sequence) {
+					if (v.sides[dir] != sides) {
+						if (v.mask & sectorMask(dir, interiorSteps(sides))) {
+							fits = false;
+							break;
+						}
+						missing.push_back({ dir, sides });
+					}
+					dir = (dir + interiorSteps(sides)) % STEPS;
+				}
+
+				if (fits && std::find(result.begin(), result.end(), missing) == result.end()) {
+					result.push_back(missing);
+				}
+			}
+			return result;
+		}
+
+		void run(double seedX, double seedY) {
+			// Surround the seed vertex with the configuration
+			uint32_t seed = findOrAddVertex(seedX, seedY);
+			int dir = 0;
+			for (int sides : sequences.front()) {
+				placePolygon(seed, dir, sides);
+				dir += interiorSteps(sides);
+			}
+
+			// Complete the frontier vertices breadth first. A vertex that could be
+			// completed in more than one way is deferred; if the whole frontier is
+			// ambiguous the first completion is taken.
+			size_t stalled = 0;
+			while (!frontier.empty() && tiles.size() < maxTiles) {
+				uint32_t id = frontier.front();
+				frontier.pop_front();
+				vertices[id].queued = false;
+				if (vertices[id].mask == (1u << STEPS) - 1) {
+					continue;
+				}
+
+				std::vector<std::vector<Sector>> options = completions(vertices[id]);
+				if (options.empty()) {
+					continue; // Can't be completed, leave it on the boundary
+				}
+				if (options.size() > 1 && stalled <= frontier.size()) {
+					++stalled;
+					enqueue(id);
+					continue;
+				}
+
+				stalled = 0;
+				for (const Sector& sector : options.front()) {
+					if (tiles.size() >= maxTiles) {
+						break;
+					}
+					placePolygon(id, sector.dir, sector.sides);
+				}
+			}
+		}
+	};
+};
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+	tess_wallpaper.h
+
+	What is this?
+	~~~~~~~~~~~~~
+	A wallpaper group generator. The placed shapes form a fundamental domain,
+	and one of the 17 wallpaper groups (p1 ... p6m) turns it into a symmetric
+	tiling of the whole plane.
+
+	The group's point operations (rotations, reflections and glide
+	reflections) are applied once, giving the orbit of each domain shape
+	within one lattice cell. Each orbit image is stored as plain geometry,
+	shared by every lattice cell, so drawing only has to walk the visible
+	cells and offset the images. No TessShape objects are copied.
+
+	License (BSD-3-Clause)
+	~~~~~~~~~~~~~~~~~~~~~~
+
+	Copyright (C) 2024 Brandon Blodget
+
+	This software is provided under the BSD 3-Clause License.
+	For the full license text, see LICENSE.txt.
+
+	This file is part of the Tessellation project.
+*/
+
+#pragma once
+
+#include "tess_shape.h"
+#include "tess_geometry.h"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// The 17 wallpaper groups, in the usual order
+enum class WallpaperGroup
+{
+	P1, P2, PM, PG, CM, PMM, PMG, PGG, CMM,
+	P4, P4M, P4G, P3, P3M1, P31M, P6, P6M,
+	Count
+};
+
+class TessWallpaper {
+public:
+	// Upper bound on the number of lattice cells drawn per frame
+	static constexpr int64_t MAX_VISIBLE_CELLS = 4096;
+	// Sprite atlas geometry id of the first orbit image
+	static constexpr int GEOMETRY_ID_BASE = 1 << 20;
+
+	// One image of a domain shape under a point operation of the group
+	struct Image {
+		std::vector<olc::vf2d> points;
+		olc::vf2d centroid;
+		olc::Pixel color;
+	};
+
+	static const char* groupName(WallpaperGroup group) {
+		static const char* names[] = {
+			"p1", "p2", "pm", "pg", "cm", "pmm", "pmg", "pgg", "cmm",
+			"p4", "p4m", "p4g", "p3", "p3m1", "p31m", "p6", "p6m"
+		};
+		return names[(int)group];
+	}
+
+	// The lattice used by the group for a cell of the given size
+	static TessLattice latticeFor(WallpaperGroup group, float cellSize) {
+		TessLattice lattice;
+		lattice.a = { cellSize, 0.0f };
+		switch (group)
+		{
+			case WallpaperGroup::P1:
+			case WallpaperGroup::P2:
+				// Oblique
+				lattice.b = { cellSize * 0.3f, cellSize * 0.9f };
+				break;
+			case WallpaperGroup::CM:
+			case WallpaperGroup::CMM:
+				// Centred rectangular, as a primitive (rhombic) cell
+				lattice.b = { cellSize * 0.5f, cellSize * 0.75f };
+				break;
+			case WallpaperGroup::P3:
+			case WallpaperGroup::P3M1:
+			case WallpaperGroup::P31M:
+			case WallpaperGroup::P6:
+			case WallpaperGroup::P6M:
+				// Hexagonal
+				lattice.b = { cellSize * 0.5f, cellSize * std::sqrt(3.0f) / 2.0f };
+				break;
+			default:
+				// Rectangular and square
+				lattice.b = { 0.0f, cellSize };
+				break;
+		}
+		return lattice;
+	}
+
+	// Use the given shapes as the fundamental domain of the group, with the
+	// group's rotation centre / mirror intersection at origin.
+	void setDomain(std::vector<std::unique_ptr<TessShape>>&& upDomain, WallpaperGroup group, const olc::vf2d& origin, float cellSize) {
+		clear();
+		if (upDomain.empty()) {
+			return;
+		}
+
+		upDomain_ = std::move(upDomain);
+		group_ = group;
+		lattice_ = latticeFor(group, cellSize);
+
+		// Orbit of every domain shape under the point operations
+		for (const TessTransform& op : pointOperations(group, cellSize)) {
+			TessTransform image = TessTransform::translation(origin) * op * TessTransform::translation(-origin);
+			for (const auto& upShape : upDomain_) {
+				Image img;
+				for (const auto& point : upShape->getDrawPoints()) {
+					img.points.push_back(image.apply(point));
+				}
+				img.centroid = image.apply(upShape->getCentroid());
+				img.color = upShape->getColor();
+				images_.push_back(std::move(img));
+			}
+		}
+
+		// Bounds of one cell's worth of images
+		imagesMin_ = imagesMax_ = images_.front().centroid;
+		for (const auto& img : images_) {
+			for (const auto& point : img.points) {
+				imagesMin_ = imagesMin_.min(point);
+				imagesMax_ = imagesMax_.max(point);
+			}
+		}
+	}
+
+	// Remove the generated tiling, handing the domain shapes back to the caller
+	std::vector<std::unique_ptr<TessShape>> takeDomain() {
+		std::vector<std::unique_ptr<TessShape>> upDomain = std::move(upDomain_);
+		clear();
+		return upDomain;
+	}
+
+	void clear() {
+		upDomain_.clear();
+		images_.clear();
+	}
+
+	bool isActive() const {
+		return !images_.empty();
+	}
+
+	WallpaperGroup getGroup() const {
+		return group_;
+	}
+
+	const TessLattice& getLattice() const {
+		return lattice_;
+	}
+
+	// Call fn(imageIndex, image, offset) for every orbit image in each lattice
+	// cell that may intersect the world rectangle [worldTL, worldBR]
+	template <typename Fn>
+	void forEachVisibleImage(const olc::vf2d& worldTL, const olc::vf2d& worldBR, Fn fn) const {
+		if (!isActive()) {
+			return;
+		}
+
+		TessLattice::CellRange range = lattice_.cellRange(imagesMin_, imagesMax_, worldTL, worldBR, MAX_VISIBLE_CELLS);
+		for (int32_t i = range.iMin; i <= range.iMax; ++i) {
+			for (int32_t j = range.jMin; j <= range.jMax; ++j) {
+				olc::vf2d offset = lattice_.offset(i, j);
+				olc::vf2d vMin = imagesMin_ + offset;
+				olc::vf2d vMax = imagesMax_ + offset;
+				if (vMax.x < worldTL.x || vMin.x > worldBR.x || vMax.y < worldTL.y || vMin.y > worldBR.y) {
+					continue;
+				}
+
+				for (size_t k = 0; k < images_.size(); ++k) {
+					fn(k, images_[k], offset);
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<TessShape>> upDomain_; // Fundamental domain, as placed
+	WallpaperGroup group_ = WallpaperGroup::P1;
+	TessLattice lattice_;
+	std::vector<Image> images_;                         // Orbit images within one lattice cell
+	olc::vf2d imagesMin_;                               // Bounds of the orbit images
+	olc::vf2d imagesMax_;
+
+	static TessTransform linear(float m00, float m01, float m10, float m11, const olc::vf2d& t = { 0.0f, 0.0f }) {
+		TessTransform r;
+		r.m00 = m00; r.m01 = m01;
+		r.m10 = m10; r.m11 = m11;
+		r.t = t;
+		return r;
+	}
+
+	// The point operations of the group (one representative per coset of the
+	// lattice translations), about the origin, for a cell of the given size
+	static std::vector<TessTransform> pointOperations(WallpaperGroup group, float cellSize) {
+		float h = cellSize * 0.5f; // Half cell, for glide reflections
+		std::vector<TessTransform> ops = { TessTransform() };
+
+		auto addRotations = [&](int n) {
+			for (int k = 1; k < n; ++k) {
+				ops.push_back(TessTransform::rotation(360.0f * k / n));
+			}
+		};
+		auto addReflections = [&](std::initializer_list<float> anglesDegrees) {
+			for (float angle : anglesDegrees) {
+				ops.push_back(TessTransform::reflection(angle));
+			}
+		};
+
+		switch (group)
+		{
+			case WallpaperGroup::P1:
+				break;
+			case WallpaperGroup::P2:
+				addRotations(2);
+				break;
+			case WallpaperGroup::PM:
+			case WallpaperGroup::CM:
+				ops.push_back(linear(-1, 0, 0, 1));
+				break;
+			case WallpaperGroup::PG:
+				ops.push_back(linear(-1, 0, 0, 1, { 0.0f, h }));
+				break;
+			case WallpaperGroup::PMM:
+			case WallpaperGroup::CMM:
+				addRotations(2);
+				ops.push_back(linear(-1, 0, 0, 1));
+				ops.push_back(linear(1, 0, 0, -1));
+				break;
+			case WallpaperGroup::PMG:
+				addRotations(2);
+				ops.push_back(linear(-1, 0, 0, 1, { h, 0.0f }));
+				ops.push_back(linear(1, 0, 0, -1, { h, 0.0f }));
+				break;
+			case WallpaperGroup::PGG:
+				addRotations(2);
+				ops.push_back(linear(-1, 0, 0, 1, { h, h }));
+				ops.push_back(linear(1, 0, 0, -1, { h, h }));
+				break;
+			case WallpaperGroup::P4:
+				addRotations(4);
+				break;
+			case WallpaperGroup::P4M:
+				addRotations(4);
+				addReflections({ 0.0f, 45.0f, 90.0f, 135.0f });
+				break;
+			case WallpaperGroup::P4G:
+				addRotations(4);
+				ops.push_back(linear(-1, 0, 0, 1, { h, h }));
+				ops.push_back(linear(1, 0, 0, -1, { h, h }));
+				ops.push_back(linear(0, 1, 1, 0, { h, h }));
+				ops.push_back(linear(0, -1, -1, 0, { h, h }));
+				break;
+			case WallpaperGroup::P3:
+				addRotations(3);
+				break;
+			case WallpaperGroup::P3M1:
+				// Mirrors through every 3-fold centre
+				addRotations(3);
+				addReflections({ 30.0f, 90.0f, 150.0f });
+				break;
+			case WallpaperGroup::P31M:
+				// Mirrors along the lattice vectors, not through every 3-fold centre
+				addRotations(3);
+				addReflections({ 0.0f, 60.0f, 120.0f });
+				break;
+			case WallpaperGroup::P6:
+				addRotations(6);
+				break;
+			case WallpaperGroup::P6M:
+				addRotations(6);
+				addReflections({ 0.0f, 30.0f, 60.0f, 90.0f, 120.0f, 150.0f });
+				break;
+			default:
+				break;
+		}
+		return ops;
+	}
+};